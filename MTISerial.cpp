@@ -1,7 +1,10 @@
 #define SERIAL_HARDWARE_FLOW_CONTROL 0
 #include "MTISerial.h"
 
+#include <string.h>
+
 #ifdef MTI_UNIX
+#include <errno.h>
 #include <poll.h>
 #include <sys/ioctl.h>
 #include <time.h>
@@ -11,12 +14,31 @@
 // MTISerialIO Implementation
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Milliseconds of a monotonic clock, for timeouts measured in wall time
+static unsigned long long MonotonicMs ()
+{
+#ifdef MTI_WINDOWS
+	return ::GetTickCount64();
+#endif
+#ifdef MTI_UNIX
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
 MTISerialIO::MTISerialIO ()
 {
 	m_hFile = 0;
 #ifdef MTI_WINDOWS
 	m_hevtOverlapped = 0;
+	m_hevtReadAvailable = 0;
 #endif
+#ifdef MTI_UNIX
+	m_BlockingMode = MTI_BLOCKING_MODE_ON;
+#endif
+	m_RxStart = m_RxEnd = 0;
+	m_PartialWrites = 0;
 }
 
 MTISerialIO::~MTISerialIO ()
@@ -66,6 +88,13 @@ long MTISerialIO::Open (const char* port, unsigned int baudRate, unsigned int in
 		return MTI_ERR_SERIALCOMM;
 	}
 
+	m_hevtReadAvailable = ::CreateEvent(0,true,false,0);
+	if (m_hevtReadAvailable == 0)
+	{
+		Close();
+		return MTI_ERR_SERIALCOMM;
+	}
+
 	// Setup the COM-port
 	if (inQueue || outQueue)
 	{
@@ -114,6 +143,11 @@ long MTISerialIO::Close (void)
 		::CloseHandle(m_hevtOverlapped);
 		m_hevtOverlapped = 0;
 	}
+	if (m_hevtReadAvailable)
+	{
+		::CloseHandle(m_hevtReadAvailable);
+		m_hevtReadAvailable = 0;
+	}
 	::CloseHandle(m_hFile);
 #endif
 
@@ -122,6 +156,7 @@ long MTISerialIO::Close (void)
 #endif
 
 	m_hFile = 0;
+	m_RxStart = m_RxEnd = 0;
 	return MTI_SUCCESS;
 }
 
@@ -272,23 +307,22 @@ long MTISerialIO::Write (unsigned char* pData, size_t lData, unsigned int* lWrit
 #endif
 
 #ifdef MTI_UNIX
-	write(m_hFile, pData, lData);
+	// Without a timeout, return once queued as before, but never drop what did not fit
+	if (!timeout)
+		return WriteQueued(pData, lData, lWritten, INFINITE);
 
 	// For some channels like Bluetooth, the write immediately returns even though the output buffer
-	// may take some time to clear. We implement a partially blocking write by polling the output buffer
-	// to be sure it has been sent before continuing. A timeout is used in case the output write 
+	// may take some time to clear. We implement a partially blocking write by waiting for the output
+	// buffer to be sent before continuing. The timeout covers both steps, in case the output write
 	// blocks indefinitely.
-	if (!timeout)
-		return MTI_SUCCESS;
-
-	int out_bytes = -1;
-	clock_t start = clock();
-	while (out_bytes != 0) {
-		double elapsed = (double)(clock()-start) / CLOCKS_PER_SEC * 1000; // milliseconds
-		if (timeout != INFINITE && elapsed > timeout)
-			return MTI_ERR_SERIALCOMM;
-		ioctl(m_hFile, TIOCOUTQ, &out_bytes);
-	}
+	unsigned long long start = MonotonicMs();
+	long lastError = WriteQueued(pData, lData, lWritten, timeout);
+	if (lastError != MTI_SUCCESS)
+		return lastError;
+	if (timeout == INFINITE)
+		return Drain(INFINITE);
+	unsigned long long elapsed = MonotonicMs() - start;
+	return Drain(elapsed < timeout ? (unsigned int)(timeout - elapsed) : 0);
 #endif
 
 	return MTI_SUCCESS;
@@ -324,8 +358,11 @@ long MTISerialIO::SetBlockingMode (int blockingMode)
 #endif
 
 #ifdef MTI_UNIX
-	const int flags = fcntl(m_hFile, F_GETFL);
-	fcntl(m_hFile, F_SETFL, blockingMode == MTI_BLOCKING_MODE_ON ? flags & ~O_NONBLOCK : flags | O_NONBLOCK);
+	// The descriptor itself stays non-blocking so that writes can never block past their timeout,
+	// possibly on another thread. Blocking reads wait in poll() instead.
+	if (blockingMode != MTI_BLOCKING_MODE_ON && blockingMode != MTI_BLOCKING_MODE_OFF)
+		return MTI_ERR_SERIALCOMM;
+	m_BlockingMode = blockingMode;
 #endif
 	return MTI_SUCCESS;
 }
@@ -335,6 +372,17 @@ long MTISerialIO::Read (unsigned char* pData, size_t lData, unsigned int* lRead,
 	if (m_hFile == 0)
 		return MTI_ERR_INVALID_HANDLE;
 
+	// Bytes already received by ReadLine/ReadExact come first
+	size_t lBuffered = TakeRxBuffer(pData, lData);
+	if (lBuffered == lData)
+	{
+		if( lRead != 0 )
+			*lRead = (unsigned int)lBuffered;
+		return MTI_SUCCESS;
+	}
+	pData += lBuffered;
+	lData -= lBuffered;
+
 #ifdef MTI_WINDOWS
 	if( blockingMode != MTI_BLOCKING_MODE_ERR )
 		SetBlockingMode( blockingMode );
@@ -386,7 +434,7 @@ long MTISerialIO::Read (unsigned char* pData, size_t lData, unsigned int* lRead,
 	}
 
 	if( lRead != 0 )
-		*lRead = dwRead;
+		*lRead = dwRead + (unsigned int)lBuffered;
 #endif
 
 #ifdef MTI_UNIX
@@ -401,69 +449,353 @@ long MTISerialIO::Read (unsigned char* pData, size_t lData, unsigned int* lRead,
 	{
 		// If a timeout is specified, poll the file descriptor to make sure input is ready.
 		// poll() returns 0 if timeout occurs, -1 if an error occurs.
-		if (timeout != INFINITE)
+		// In blocking mode without a timeout, wait for input indefinitely.
+		if (timeout != INFINITE || m_BlockingMode == MTI_BLOCKING_MODE_ON)
 		{
 			struct pollfd fds[1];
 			fds[0].fd = m_hFile;
 			fds[0].events = POLLIN;
-			int perr = poll(fds, 1, timeout);
+			int perr = poll(fds, 1, timeout != INFINITE ? (int)timeout : -1);
+			if (perr == -1 && errno == EINTR)
+				continue;
 			if (perr == 0)									// timeout
 				return MTI_ERR_SERIALCOMM_READ_TIMEOUT;
 			if (perr == -1 || !(fds[0].revents & POLLIN))	// other error or data not ready
 				return MTI_ERR_SERIALCOMM;
 		}
-		rtot += read(m_hFile, pData + rtot, lData - rtot);
+		ssize_t n = read(m_hFile, pData + rtot, lData - rtot);
+		if (n > 0)
+			rtot += n;
+		else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			return MTI_ERR_SERIALCOMM;
+		else if (m_BlockingMode == MTI_BLOCKING_MODE_OFF && timeout == INFINITE)
+			break;											// non-blocking: return what was available
 	} while (rtot < lData);
 
 	if( lRead != 0 )
-		*lRead = rtot;
+		*lRead = rtot + (unsigned int)lBuffered;
 	
 #endif
 	return MTI_SUCCESS;
 }
 
-long MTISerialIO::Purge()
+long MTISerialIO::GetOutputQueue (unsigned int* lQueued)
 {
 	if (m_hFile == 0)
 		return MTI_ERR_INVALID_HANDLE;
 
 #ifdef MTI_WINDOWS
-	if (!::PurgeComm(m_hFile, PURGE_TXCLEAR | PURGE_RXCLEAR))
+	DWORD dwErrors = 0;
+	COMSTAT comStat;
+	if (!::ClearCommError(m_hFile,&dwErrors,&comStat))
 		return MTI_ERR_SERIALCOMM;
+	*lQueued = comStat.cbOutQue;
 #endif
 
 #ifdef MTI_UNIX
-	tcflush(m_hFile, TCIOFLUSH);
+	int out_bytes = 0;
+	if (ioctl(m_hFile, TIOCOUTQ, &out_bytes) == -1)
+		return MTI_ERR_SERIALCOMM;
+	*lQueued = (unsigned int)out_bytes;
 #endif
-
 	return MTI_SUCCESS;
 }
 
-long MTISerialIO::ReadText (char* text, unsigned char delineationCharacter, unsigned int timeout)
+int MTISerialIO::GetFileDescriptor (void) const
 {
-	bool wait = true;
-	long lastError;
-	unsigned int textLength=0;
-	unsigned char rdata[1];
+#ifdef MTI_UNIX
+	if (m_hFile > 0)
+		return m_hFile;
+#endif
+	return -1;
+}
+
+long MTISerialIO::WriteQueued (unsigned char* pData, size_t lData, unsigned int* lWritten, unsigned int timeout)
+{
+#ifdef MTI_WINDOWS
+	// The overlapped write completes once the driver took the data
+	return Write(pData, lData, lWritten, timeout);
+#endif
 
-	SetBlockingMode( true );
-	while(wait) 
+#ifdef MTI_UNIX
+	if (m_hFile == 0)
+		return MTI_ERR_INVALID_HANDLE;
+
+	unsigned long long start = MonotonicMs();
+	size_t written = 0;
+	long lastError = MTI_SUCCESS;
+	bool bStalled = false;
+	while (written < lData)
 	{
-		lastError = Read( rdata, 1, 0, timeout, MTI_BLOCKING_MODE_ERR );
-		if (lastError != 0) 
+		ssize_t n = write(m_hFile, pData + written, lData - written);
+		if (n > 0)
 		{
-			wait = false;
-			return lastError;
+			written += n;
+			continue;
+		}
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+		{
+			lastError = MTI_ERR_SERIALCOMM;
+			break;
+		}
+
+		// The driver buffer is full: sleep until it has room again
+		bStalled = true;
+		int wait = -1;
+		if (timeout != INFINITE)
+		{
+			unsigned long long elapsed = MonotonicMs() - start;
+			if (elapsed >= timeout)
+			{
+				lastError = MTI_ERR_SERIALCOMM_READ_TIMEOUT;
+				break;
+			}
+			wait = (int)(timeout - elapsed);
 		}
-		if (rdata[0] == delineationCharacter)
-			wait = false;
-		else 
+		struct pollfd pfd;
+		pfd.fd = m_hFile;
+		pfd.events = POLLOUT;
+		pfd.revents = 0;
+		int ret = poll(&pfd, 1, wait);
+		if ((ret < 0 && errno != EINTR) || (ret > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))))
 		{
-			text[textLength++] = (char)rdata[0];
-			text[textLength] = 0;
+			lastError = MTI_ERR_SERIALCOMM;
+			break;
 		}
-		if (textLength >= 80)
-			wait = false;
 	}
+
+	if (bStalled)
+		m_PartialWrites++;
+	if( lWritten != 0 )
+		*lWritten = (unsigned int)written;
+	return lastError;
+#endif
+}
+
+long MTISerialIO::Drain (unsigned int timeout)
+{
+	if (m_hFile == 0)
+		return MTI_ERR_INVALID_HANDLE;
+
+	unsigned long long start = MonotonicMs();
+	unsigned int queued = 0;
+	while (true)
+	{
+		long lastError = GetOutputQueue(&queued);
+		if (lastError != MTI_SUCCESS)
+			return lastError;
+		if (queued == 0)
+			return MTI_SUCCESS;
+		if (timeout != INFINITE && MonotonicMs() - start > timeout)
+			return MTI_ERR_SERIALCOMM;
+		// Sleep instead of spinning, a millisecond is about 90 bytes at 921600 baud
+		Sleep(1);
+	}
+}
+
+long MTISerialIO::ReadAvailable (unsigned char* pData, size_t lData, unsigned int* lRead, unsigned int timeout)
+{
+	if (m_hFile == 0)
+		return MTI_ERR_INVALID_HANDLE;
+
+	// Leftovers of ReadLine/ReadExact are returned before reading from the port again
+	size_t lBuffered = TakeRxBuffer(pData, lData);
+	if (lBuffered > 0)
+	{
+		if( lRead != 0 )
+			*lRead = (unsigned int)lBuffered;
+		return MTI_SUCCESS;
+	}
+	return ReadRaw(pData, lData, lRead, timeout);
+}
+
+size_t MTISerialIO::TakeRxBuffer (unsigned char* pData, size_t lData)
+{
+	size_t lTaken = m_RxEnd - m_RxStart;
+	if (lTaken > lData)
+		lTaken = lData;
+	memcpy(pData, m_RxBuffer + m_RxStart, lTaken);
+	m_RxStart += lTaken;
+	if (m_RxStart == m_RxEnd)
+		m_RxStart = m_RxEnd = 0;
+	return lTaken;
+}
+
+long MTISerialIO::FillRxBuffer (unsigned int timeout)
+{
+	// Move the pending bytes to the front to make room for a bulk read
+	if (m_RxStart > 0)
+	{
+		memmove(m_RxBuffer, m_RxBuffer + m_RxStart, m_RxEnd - m_RxStart);
+		m_RxEnd -= m_RxStart;
+		m_RxStart = 0;
+	}
+	if (m_RxEnd == MTI_SERIAL_RX_BUFFER_SIZE)
+		return MTI_SUCCESS;
+
+	unsigned int lRead = 0;
+	long lastError = ReadRaw(m_RxBuffer + m_RxEnd, MTI_SERIAL_RX_BUFFER_SIZE - m_RxEnd, &lRead, timeout);
+	if (lastError == MTI_SUCCESS)
+		m_RxEnd += lRead;
 	return lastError;
+}
+
+long MTISerialIO::ReadLine (char* text, size_t lText, unsigned char delineationCharacter, unsigned int timeout)
+{
+	if (m_hFile == 0)
+		return MTI_ERR_INVALID_HANDLE;
+	if (lText == 0)
+		return MTI_ERR_SERIALCOMM;
+
+	unsigned long long start = MonotonicMs();
+	text[0] = 0;
+	size_t lScanned = 0;
+	while (true)
+	{
+		// Look for the delimiter only in the bytes not searched before
+		unsigned char* pBegin = m_RxBuffer + m_RxStart;
+		size_t lPending = m_RxEnd - m_RxStart;
+		unsigned char* pEnd = (unsigned char*)memchr(pBegin + lScanned, delineationCharacter, lPending - lScanned);
+		size_t lLine = pEnd ? (size_t)(pEnd - pBegin) : lPending;
+		// Lines that do not fit into text or the internal buffer are split, like ReadText always did
+		bool bSplit = lLine > lText - 1 || (!pEnd && (lLine == lText - 1 || lPending == MTI_SERIAL_RX_BUFFER_SIZE));
+		if (pEnd || bSplit)
+		{
+			if (lLine > lText - 1)
+				lLine = lText - 1;
+			memcpy(text, pBegin, lLine);
+			text[lLine] = 0;
+			m_RxStart += bSplit ? lLine : lLine + 1;
+			if (m_RxStart == m_RxEnd)
+				m_RxStart = m_RxEnd = 0;
+			return MTI_SUCCESS;
+		}
+		lScanned = lPending;
+
+		unsigned int remaining = INFINITE;
+		if (timeout != INFINITE)
+		{
+			unsigned long long elapsed = MonotonicMs() - start;
+			if (elapsed >= timeout)
+				return MTI_ERR_SERIALCOMM_READ_TIMEOUT;
+			remaining = (unsigned int)(timeout - elapsed);
+		}
+		long lastError = FillRxBuffer(remaining);
+		if (lastError != MTI_SUCCESS)
+			return lastError;
+	}
+}
+
+long MTISerialIO::ReadExact (unsigned char* pData, size_t lData, unsigned int timeout)
+{
+	if (m_hFile == 0)
+		return MTI_ERR_INVALID_HANDLE;
+
+	unsigned long long start = MonotonicMs();
+	size_t lTotal = TakeRxBuffer(pData, lData);
+	while (lTotal < lData)
+	{
+		unsigned int remaining = INFINITE;
+		if (timeout != INFINITE)
+		{
+			unsigned long long elapsed = MonotonicMs() - start;
+			if (elapsed >= timeout)
+				return MTI_ERR_SERIALCOMM_READ_TIMEOUT;
+			remaining = (unsigned int)(timeout - elapsed);
+		}
+		long lastError = FillRxBuffer(remaining);
+		if (lastError != MTI_SUCCESS)
+			return lastError;
+		lTotal += TakeRxBuffer(pData + lTotal, lData - lTotal);
+	}
+	return MTI_SUCCESS;
+}
+
+long MTISerialIO::ReadRaw (unsigned char* pData, size_t lData, unsigned int* lRead, unsigned int timeout)
+{
+
+	if( lRead != 0 )
+		*lRead = 0;
+
+#ifdef MTI_WINDOWS
+	// Poll the driver input queue so the read below never waits on the shared comm timeouts.
+	// Sleep(1) lasts up to a scheduler tick (15.6 ms by default), so the wait is timed on the clock.
+	DWORD dwErrors = 0;
+	COMSTAT comStat;
+	unsigned long long start = MonotonicMs();
+	for (;;)
+	{
+		if (!::ClearCommError(m_hFile,&dwErrors,&comStat))
+			return MTI_ERR_SERIALCOMM;
+		if (comStat.cbInQue > 0)
+			break;
+		if (timeout != INFINITE && MonotonicMs() - start >= timeout)
+			return MTI_ERR_SERIALCOMM_READ_TIMEOUT;
+		::Sleep(1);
+	}
+
+	DWORD dwRead = 0;
+	DWORD dwToRead = (DWORD)((comStat.cbInQue < lData) ? comStat.cbInQue : lData);
+	OVERLAPPED ovInternal;
+	memset(&ovInternal,0,sizeof(ovInternal));
+	ovInternal.hEvent = m_hevtReadAvailable;
+	if (!::ReadFile(m_hFile,pData,dwToRead,&dwRead,&ovInternal))
+	{
+		if (::GetLastError() != ERROR_IO_PENDING)
+			return MTI_ERR_SERIALCOMM;
+		// The bytes are already queued, so the request completes without waiting for the line
+		if (!::GetOverlappedResult(m_hFile,&ovInternal,&dwRead,TRUE))
+			return MTI_ERR_SERIALCOMM;
+	}
+
+	if( lRead != 0 )
+		*lRead = dwRead;
+#endif
+
+#ifdef MTI_UNIX
+	struct pollfd fds[1];
+	fds[0].fd = m_hFile;
+	fds[0].events = POLLIN;
+	int perr = poll(fds, 1, (timeout == INFINITE) ? -1 : (int)timeout);
+	if (perr == 0)									// timeout
+		return MTI_ERR_SERIALCOMM_READ_TIMEOUT;
+	if (perr == -1 || !(fds[0].revents & POLLIN))	// other error or data not ready
+		return MTI_ERR_SERIALCOMM;
+
+	// The descriptor may be in blocking mode; poll() guarantees this read does not block
+	ssize_t rnum = read(m_hFile, pData, lData);
+	if (rnum < 0)
+		return MTI_ERR_SERIALCOMM;
+
+	if( lRead != 0 )
+		*lRead = (unsigned int)rnum;
+#endif
+	return MTI_SUCCESS;
+}
+
+long MTISerialIO::Purge()
+{
+	if (m_hFile == 0)
+		return MTI_ERR_INVALID_HANDLE;
+
+	m_RxStart = m_RxEnd = 0;
+
+#ifdef MTI_WINDOWS
+	if (!::PurgeComm(m_hFile, PURGE_TXCLEAR | PURGE_RXCLEAR))
+		return MTI_ERR_SERIALCOMM;
+#endif
+
+#ifdef MTI_UNIX
+	tcflush(m_hFile, TCIOFLUSH);
+#endif
+
+	return MTI_SUCCESS;
+}
+
+long MTISerialIO::ReadText (char* text, unsigned char delineationCharacter, unsigned int timeout)
+{
+	// Historically at most 80 characters are returned per call
+	return ReadLine(text, 81, delineationCharacter, timeout);
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 
 #include "PlayzerX.h"
 
+char scvtext[100];
+
 namespace playzerx
 {
 PlayzerX* PlayzerX::CreateDevice()
@@ -17,16 +19,45 @@ void PlayzerX::DeleteDevice(PlayzerX* device) { SAFE_DELETE(device); }
 
 PlayzerX::PlayzerX()
 {
+	m_SerialDevice = nullptr;
 	m_RGBCapable = false;
-	m_CommandBytes.reserve(kMaxSendBytes);
 	m_SamplesRemaining = 0;
 	m_SampleRate = 10000;
 	m_TimeOut = 1000;
 	m_StreamingSamplesRemaining = false;
+	m_BufferUpdateTimer = 0;
+	m_EstimatorUpdateCount = 0;
+	m_SampleSequence = 0;
+	m_ClearSequence = 0;
+	m_WritesStarted = 0;
+	m_WritesFinished = 0;
+	m_Streaming = false;
+	m_PumpMode = false;
+	m_PumpSamples = 0;
+	m_PumpBatchBytes = 0;
+	m_PumpWritten = 0;
+	m_StreamTargetLevel = 0;
+	m_StreamHold = false;
+	m_StreamPhaseShift = 0;
+	m_StreamPhaseShifted = 0;
+	m_StreamStartSequence = 0;
+	m_StreamMode = PlayzerXStreamMode::QUEUE;
+	m_StreamSamplesRemaining = -1;
+	m_CoalesceMaxSamples = 0;
+	m_CoalesceMaxDelay = 0;
+	m_CoalesceSamples = 0;
+	m_CoalesceDeadline = 0;
+	m_CoalesceError = 0;
+	m_CoalesceRunning = false;
+	m_Telemetry.SetLevelListener(
+		[this](int level, long long timestamp) { OnBufferLevel(level, timestamp); });
 }
 
 PlayzerX::~PlayzerX()
 {
+	StopStreaming();
+	StopCoalescing();
+	m_Telemetry.Stop();
 	if (m_SerialDevice != nullptr)
 	{
 		SAFE_DELETE(m_SerialDevice);
@@ -65,6 +96,10 @@ MTISerialIO* PlayzerX::ConnectDevice(const std::string& portName)
 MTISerialIO* PlayzerX::ConnectDevice(char* portName)
 {
 	// TODO Add check if already connected!
+	// Names taken by the transport factory or "tcp://" names are opened as given
+	MTISerialIO* transport = CreateTransport(portName);
+	if (transport != nullptr) return OpenTransport(transport, portName);
+
 	char* connectPortName = new char[20];
 	int deviceNum;
 	MTISerialIO* socket = new MTISerialIO;
@@ -105,7 +140,12 @@ MTISerialIO* PlayzerX::ConnectDevice(char* portName)
 
 	deviceNum = 0;
 	Sleep(50);
-	long serialError = socket->Open(connectPortName, kBaudRate);
+	return OpenTransport(socket, connectPortName);
+}
+
+MTISerialIO* PlayzerX::OpenTransport(MTISerialIO* socket, const char* portName)
+{
+	long serialError = socket->Open(portName, kBaudRate);
 	if (serialError != 0)
 	{
 		SAFE_DELETE(socket);
@@ -113,6 +153,8 @@ MTISerialIO* PlayzerX::ConnectDevice(char* portName)
 		return m_SerialDevice;
 	}
 	m_SerialDevice = socket;
+	m_Estimator.Reset();
+	m_ClearSequence = m_SampleSequence.load();
 
 	// in case the device is not in PlayzerX mode, skip next commands
 	if (IsDeviceConnected())
@@ -135,6 +177,10 @@ MTISerialIO* PlayzerX::ConnectDevice(char* portName)
 
 void PlayzerX::DisconnectDevice()
 {
+	// The transmit thread must release the port before it is closed
+	StopStreaming();
+	FlushCoalesced();
+
 	// Stop receives buffer remaining samples update
 	SetBufferUpdateTimer(0);
 
@@ -145,17 +191,54 @@ void PlayzerX::DisconnectDevice()
 		// TODO ERROR
 		SAFE_DELETE(m_SerialDevice);
 	}
+	m_Estimator.Reset();
+	m_BufferMonitor.Reset();
+	m_ClearSequence = m_SampleSequence.load();
+	m_ResyncBytes.clear();
 
 	m_LastError = PlayzerXError::SUCCESS;
 }
 
 int PlayzerX::GetSamplesRemaining()
+{
+	// While streaming only the transmit thread talks to the device, report its latest reading
+	if (IsStreaming()) return m_StreamSamplesRemaining.load(std::memory_order_acquire);
+
+	return QuerySamplesRemaining();
+}
+
+int PlayzerX::QuerySamplesRemaining()
 {
 	long lastError;
-	unsigned int pdwRead;
 	unsigned int m_iTimeOut = 250;
-	unsigned char data[MTI_SERIAL_QUEUE_SIZE];
 
+	if (m_Telemetry.IsRunning())
+	{
+		// The reader thread owns the receive path, use its latest record if recent enough
+		int level;
+		long long timestamp;
+		long long maxAge = 2000000LL * (m_BufferUpdateTimer + 25);
+		if (m_Telemetry.GetLatest(level, timestamp) &&
+			(PlayzerXTelemetry::Now() - timestamp) < maxAge)
+			return level;
+
+		// Otherwise ask explicitly, the reply is a "pl-" record parsed by the reader thread
+		unsigned long long updateCount = m_Telemetry.GetUpdateCount();
+		unsigned char sendData[5] = {'p', 'l', 'g', 5, 10};  // Include suffix here!
+		lastError = WriteCommand(sendData, 5);
+		if (lastError != 0) return -1;
+		if (!m_Telemetry.WaitForUpdate(updateCount, m_iTimeOut))
+		{
+			m_Counters.OnSerialError();
+			return -1;
+		}
+		m_Counters.OnRoundTrip();
+		m_Telemetry.GetLatest(level, timestamp);
+		m_SamplesRemaining = level;
+		return level;
+	}
+
+	unsigned char data[MTI_SERIAL_QUEUE_SIZE];
 	if (m_StreamingSamplesRemaining)
 	{
 		// if controller is set to regularly stream SamplesRemaining we assume serial
@@ -163,7 +246,7 @@ int PlayzerX::GetSamplesRemaining()
 		// Clear data previously sent by the controller - except latest 6 bytes (latest value)
 		m_SerialDevice->Read(data, MTI_SERIAL_QUEUE_SIZE - 6, 0, 0, MTI_BLOCKING_MODE_OFF);
 		// now get the latest 6 bytes which represent response to SamplesRemaining
-		lastError = m_SerialDevice->Read(data, 6, &pdwRead, m_iTimeOut);
+		lastError = m_SerialDevice->ReadExact(data, 6, m_iTimeOut);
 	}
 
 	unsigned char sendData[10];
@@ -175,12 +258,16 @@ int PlayzerX::GetSamplesRemaining()
 		sendData[2] = 'g';
 		sendData[3] = 5;
 		sendData[4] = 10;  // Include suffix here!
-		lastError = m_SerialDevice->Write(sendData, 5, 0, 200);
+		lastError = WriteCommand(sendData, 5);
 		// now get the latest 6 bytes which represent response to SamplesRemaining
-		lastError = m_SerialDevice->Read(data, 6, &pdwRead, m_iTimeOut);
+		lastError = m_SerialDevice->ReadExact(data, 6, m_iTimeOut);
 	}
 
-	if (lastError != 0) return -1;  // seems we could not get a good response
+	if (lastError != 0)  // seems we could not get a good response
+	{
+		m_Counters.OnSerialError();
+		return -1;
+	}
 
 	// Got response - enforce byte alignment by sliding until finding the complete preamble
 	unsigned char temp;
@@ -203,6 +290,8 @@ int PlayzerX::GetSamplesRemaining()
 		if (countTries > maxTries) return -1;
 	}
 	m_SamplesRemaining = (data[5] << 16) + (data[4] << 8) + data[3];
+	m_Counters.OnRoundTrip();
+	OnBufferLevel(m_SamplesRemaining, PlayzerXTelemetry::Now());
 
 	return m_SamplesRemaining;
 }
@@ -211,9 +300,51 @@ void PlayzerX::WaitForBufferLevel(int bufferLevel)
 {
 	if (bufferLevel < 0) return;
 
+	// Samples held back count as sent
+	FlushCoalesced();
+
+	long long start = PlayzerXTelemetry::Now();
+	SleepUntilBufferLevel(bufferLevel);
+	m_Counters.OnWait(PlayzerXTelemetry::Now() - start);
+}
+
+void PlayzerX::SleepUntilBufferLevel(int bufferLevel)
+{
+
 	float executionTimeMs;
 	int waitTime;
 
+	if (AnchorEstimator())
+	{
+		// Sleep exactly until the predicted deadline. Buffer level updates correct the model,
+		// so the deadline is re-evaluated at least once per update period.
+		long long updatePeriod = 1000000LL * m_BufferUpdateTimer;
+		while (true)
+		{
+			UpdateEstimator();
+			long long now = PlayzerXTelemetry::Now();
+			long long deadline = m_Estimator.GetDeadline(bufferLevel, GetOutputQueue(), now);
+			if (deadline <= now)
+			{
+				if (m_Telemetry.IsRunning()) break;
+				// Without periodic updates, confirm the prediction with the device
+				int level = GetSamplesRemaining();
+				if (level < 0)
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					continue;
+				}
+				if (level <= bufferLevel) break;
+				now = PlayzerXTelemetry::Now();
+				m_Estimator.OnTelemetry(level, now, GetOutputQueue(), now);
+				continue;
+			}
+			if (m_Telemetry.IsRunning()) deadline = std::min(deadline, now + updatePeriod);
+			PlayzerXTelemetry::SleepUntil(deadline);
+		}
+		return;
+	}
+
 	if (bufferLevel >= 0)
 	{
 		int getAS = GetSamplesRemaining(), getASPrev = 0;
@@ -252,65 +383,34 @@ void PlayzerX::SendDataXYM(float x, float y, unsigned char m, int bufferLevelToS
 		return;
 	}
 
+	if (bufferLevelToSend < 0 && m_CoalesceMaxSamples > 0)
+	{
+		if (!IsSerialAccessible()) return;
+		unsigned char bytes[kBytesPerSampleXYM];
+		EncodeDataXYM(&x, &y, &m, 1, bytes);
+		CoalesceSample(bytes, kBytesPerSampleXYM);
+		return;
+	}
+
 	float xp[1], yp[1];
 	unsigned char mp[1];
 	xp[0] = x;
 	yp[0] = y;
 	mp[0] = m;
 	SendDataXYM(xp, yp, mp, 1, bufferLevelToSend);
-
-	m_LastError = PlayzerXError::SUCCESS;
 }
 
 void PlayzerX::SendDataXYM(float* x, float* y, unsigned char* m, unsigned int numSamples,
 						   int bufferLevelToSend)
 {
-	if (!m_SerialDevice)
-	{
-		m_LastError = PlayzerXError::ERROR_CONNECTION;
-		return;
-	}
-
-	numSamples = std::min(numSamples, kMaxSendSamples);
-
-	unsigned int i;
-	int mBytesPerSample = 9;
-
-	m_CommandBytes.clear();
-	m_CommandBytes.resize(mBytesPerSample * numSamples);
-
-	// Populate buffer starting with closest origin point
-	unsigned int xVal = 0, yVal = 0, mVal = 0;
-	unsigned count = 0;
-	// 12 bit X, 12 bit Y, 8 bit M
-	// BYTES as they arrive to controller: X[7:0] {X[11:8], Y[3:0]} Y[11:4] M[7:0]
-	for (i = 0; i < numSamples; i++)
-	{
-		xVal = (unsigned int)((x[i] + 1.f) * 2047.5f);
-		yVal = (unsigned int)((y[i] + 1.f) * 2047.5f);
-		mVal = m[i];
-		m_CommandBytes[count++] = 'p';
-		m_CommandBytes[count++] = 'l';
-		m_CommandBytes[count++] = 'd';
-		m_CommandBytes[count++] = mBytesPerSample;
-		m_CommandBytes[count++] = (xVal & 0x00FF);
-		m_CommandBytes[count++] = (((xVal & 0x0F00) >> 4) + (yVal & 0x000F));
-		m_CommandBytes[count++] = ((yVal & 0x0FF0) >> 4);
-		m_CommandBytes[count++] = mVal;
-		m_CommandBytes[count++] = 10;  // including suffix here!
-	}
-
-	WaitForBufferLevel(bufferLevelToSend);
-
-	unsigned int numWritten;
-	long serialError = m_SerialDevice->Write(&m_CommandBytes[0], count, &numWritten, 2000);
-#ifdef _DEBUG
-#ifdef MTI_WINDOWS
-	sprintf(scvtext, "\nWrite count = %d bytes | Written = %d bytes | serialError = %d", count,
-			numWritten, serialError);
-	OutputDebugStringA(scvtext);
-#endif
-#endif
+	if (!IsSerialAccessible()) return;
+
+	SendChunks(numSamples, kBytesPerSampleXYM, bufferLevelToSend,
+			   [&](unsigned int first, unsigned int count, unsigned char* buffer)
+			   {
+				   EncodeDataXYM(x + first, y + first, m + first, count, buffer);
+				   return buffer;
+			   });
 }
 
 void PlayzerX::SendDataXYM(std::vector<float>& x, std::vector<float>& y,
@@ -325,8 +425,6 @@ void PlayzerX::SendDataXYM(std::vector<float>& x, std::vector<float>& y,
 	unsigned int length = std::min((unsigned int)x.size(), (unsigned int)y.size());
 	length = std::min(length, (unsigned int)m.size());
 	SendDataXYM(&x[0], &y[0], &m[0], length, bufferLevelToSend);
-
-	m_LastError = PlayzerXError::SUCCESS;
 }
 
 void PlayzerX::SendDataXY(float x, float y, int bufferLevelToSend)
@@ -337,60 +435,31 @@ void PlayzerX::SendDataXY(float x, float y, int bufferLevelToSend)
 		return;
 	}
 
+	if (bufferLevelToSend < 0 && m_CoalesceMaxSamples > 0)
+	{
+		if (!IsSerialAccessible()) return;
+		unsigned char bytes[kBytesPerSampleXY];
+		EncodeDataXY(&x, &y, 1, bytes);
+		CoalesceSample(bytes, kBytesPerSampleXY);
+		return;
+	}
+
 	float xp[1], yp[1];
 	xp[0] = x;
 	yp[0] = y;
 	SendDataXY(xp, yp, 1, bufferLevelToSend);
-
-	m_LastError = PlayzerXError::SUCCESS;
 }
 
 void PlayzerX::SendDataXY(float* x, float* y, unsigned int numSamples, int bufferLevelToSend)
 {
-	if (m_SerialDevice == nullptr)
-	{
-		m_LastError = PlayzerXError::ERROR_CONNECTION;
-		return;
-	}
-
-	numSamples = std::min(numSamples, kMaxSendSamples);
-
-	unsigned int i;
-	int mBytesPerSample = 8;
-
-	m_CommandBytes.clear();
-	m_CommandBytes.resize(mBytesPerSample * numSamples);
-
-	// Populate buffer starting with closest origin point
-	unsigned int xVal = 0, yVal = 0, mVal = 0, rVal = 0, gVal = 0, bVal = 0, rgbVal = 0;
-	unsigned count = 0;
-	// 12 bit X, 12 bit Y
-	// BYTES as they arrive to controller: X[7:0] {X[11:8], Y[3:0]} Y[11:4]
-	for (i = 0; i < numSamples; i++)
-	{
-		xVal = (unsigned int)((x[i] + 1.f) * 2047.5f);
-		yVal = (unsigned int)((y[i] + 1.f) * 2047.5f);
-		m_CommandBytes[count++] = 'p';
-		m_CommandBytes[count++] = 'l';
-		m_CommandBytes[count++] = 'D';
-		m_CommandBytes[count++] = mBytesPerSample;
-		m_CommandBytes[count++] = (xVal & 0x00FF);
-		m_CommandBytes[count++] = (((xVal & 0x0F00) >> 4) + (yVal & 0x000F));
-		m_CommandBytes[count++] = ((yVal & 0x0FF0) >> 4);
-		m_CommandBytes[count++] = 10;  // including suffix here!
-	}
-
-	WaitForBufferLevel(bufferLevelToSend);
-
-	unsigned int numWritten;
-	long serialError = m_SerialDevice->Write(&m_CommandBytes[0], count, &numWritten, 2000);
-#ifdef _DEBUG
-#ifdef MTI_WINDOWS
-	sprintf(scvtext, "\nWrite count = %d bytes | Written = %d bytes | serialError = %d", count,
-			numWritten, serialError);
-	OutputDebugStringA(scvtext);
-#endif
-#endif
+	if (!IsSerialAccessible()) return;
+
+	SendChunks(numSamples, kBytesPerSampleXY, bufferLevelToSend,
+			   [&](unsigned int first, unsigned int count, unsigned char* buffer)
+			   {
+				   EncodeDataXY(x + first, y + first, count, buffer);
+				   return (const unsigned char*)buffer;
+			   });
 }
 
 void PlayzerX::SendDataXY(std::vector<float>& x, std::vector<float>& y, int bufferLevelToSend)
@@ -404,8 +473,6 @@ void PlayzerX::SendDataXY(std::vector<float>& x, std::vector<float>& y, int buff
 	unsigned int length = std::min((unsigned int)x.size(), (unsigned int)y.size());
 	length = std::min(length, (unsigned int)x.size());
 	SendDataXY(&x[0], &y[0], length, bufferLevelToSend);
-
-	m_LastError = PlayzerXError::SUCCESS;
 }
 
 void PlayzerX::SendDataXYRGB(float x, float y, unsigned char r, unsigned char g, unsigned char b,
@@ -417,6 +484,15 @@ void PlayzerX::SendDataXYRGB(float x, float y, unsigned char r, unsigned char g,
 		return;
 	}
 
+	if (bufferLevelToSend < 0 && m_CoalesceMaxSamples > 0)
+	{
+		if (!IsSerialAccessible()) return;
+		unsigned char bytes[kBytesPerSampleXYRGB];
+		EncodeDataXYRGB(&x, &y, &r, &g, &b, 1, bytes);
+		CoalesceSample(bytes, kBytesPerSampleXYRGB);
+		return;
+	}
+
 	float xp[1], yp[1];
 	unsigned char rp[1], gp[1], bp[1];
 	xp[0] = x;
@@ -425,63 +501,20 @@ void PlayzerX::SendDataXYRGB(float x, float y, unsigned char r, unsigned char g,
 	gp[0] = g;
 	bp[0] = b;
 	SendDataXYRGB(xp, yp, rp, gp, bp, 1, bufferLevelToSend);
-
-	m_LastError = PlayzerXError::SUCCESS;
 }
 
 void PlayzerX::SendDataXYRGB(float* x, float* y, unsigned char* r, unsigned char* g,
 							 unsigned char* b, unsigned int numSamples, int bufferLevelToSend)
 {
-	if (!m_SerialDevice)
-	{
-		m_LastError = PlayzerXError::ERROR_CONNECTION;
-		return;
-	}
-
-	numSamples = std::min(numSamples, kMaxSendSamples);
-
-	unsigned int i;
-	int mBytesPerSample = 11;
-
-	m_CommandBytes.clear();
-	m_CommandBytes.resize(mBytesPerSample * numSamples);
-
-	// Populate buffer
-	unsigned int xVal = 0, yVal = 0, rVal = 0, gVal = 0, bVal = 0;
-	unsigned count = 0;
-	// 12 bit X, 12 bit Y, 8 bit R, 8 bit G, 8 bit B
-	// BYTES as they arrive to controller: X[7:0] {X[11:8], Y[3:0]} Y[11:4] R[7:0] G[7:0] B[7:0]
-	for (i = 0; i < numSamples; i++)
-	{
-		xVal = (unsigned int)((x[i] + 1.f) * 2047.5f);
-		yVal = (unsigned int)((y[i] + 1.f) * 2047.5f);
-		rVal = r[i];
-		gVal = g[i];
-		bVal = b[i];
-		m_CommandBytes[count++] = 'p';
-		m_CommandBytes[count++] = 'l';
-		m_CommandBytes[count++] = 'd';
-		m_CommandBytes[count++] = mBytesPerSample;
-		m_CommandBytes[count++] = (xVal & 0x00FF);
-		m_CommandBytes[count++] = (((xVal & 0x0F00) >> 4) + (yVal & 0x000F));
-		m_CommandBytes[count++] = ((yVal & 0x0FF0) >> 4);
-		m_CommandBytes[count++] = rVal;
-		m_CommandBytes[count++] = gVal;
-		m_CommandBytes[count++] = bVal;
-		m_CommandBytes[count++] = 10;  // Include suffix here!
-	}
-
-	WaitForBufferLevel(bufferLevelToSend);
-
-	unsigned int numWritten;
-	long serialError = m_SerialDevice->Write(&m_CommandBytes[0], count, &numWritten, 2000);
-#ifdef _DEBUG
-#ifdef MTI_WINDOWS
-	sprintf(scvtext, "\nWrite count = %d bytes | Written = %d bytes | serialError = %d", count,
-			numWritten, serialError);
-	OutputDebugStringA(scvtext);
-#endif
-#endif
+	if (!IsSerialAccessible()) return;
+
+	SendChunks(numSamples, kBytesPerSampleXYRGB, bufferLevelToSend,
+			   [&](unsigned int first, unsigned int count, unsigned char* buffer)
+			   {
+				   EncodeDataXYRGB(x + first, y + first, r + first, g + first, b + first, count,
+								   buffer);
+				   return (const unsigned char*)buffer;
+			   });
 }
 
 void PlayzerX::SendDataXYRGB(std::vector<float>& x, std::vector<float>& y,
@@ -499,38 +532,312 @@ void PlayzerX::SendDataXYRGB(std::vector<float>& x, std::vector<float>& y,
 	length = std::min(length, (unsigned int)g.size());
 	length = std::min(length, (unsigned int)b.size());
 	SendDataXYRGB(&x[0], &y[0], &r[0], &g[0], &b[0], length, bufferLevelToSend);
+}
 
-	m_LastError = PlayzerXError::SUCCESS;
+void PlayzerX::SendFrame(const EncodedFrame& frame, int bufferLevelToSend)
+{
+	if (!IsSerialAccessible()) return;
+
+	unsigned int bytesPerSample = frame.GetBytesPerSample();
+	SendChunks(frame.GetNumSamples(), bytesPerSample, bufferLevelToSend,
+			   [&](unsigned int first, unsigned int, unsigned char*)
+			   { return frame.GetData() + first * bytesPerSample; });
 }
 
-void PlayzerX::ClearData()
+bool PlayzerX::ScheduleAt(long long time, const EncodedFrame& frame, PlayzerXPadding padding)
 {
-	if (!m_SerialDevice)
+	if (!IsSerialAccessible()) return false;
+	if (frame.GetNumSamples() == 0)
 	{
-		m_LastError = PlayzerXError::ERROR_CONNECTION;
+		m_LastError = PlayzerXError::ERROR_INVALID_PARAM;
+		return false;
+	}
+
+	// The samples held back are queued before the padding
+	if (FlushCoalesced() != 0 || !AnchorEstimator())
+	{
+		m_LastError = PlayzerXError::ERROR_GENERAL;
+		return false;
+	}
+
+	// Find the number of padding samples that brings the first frame sample closest to time.
+	// Emission times grow with the position, but not linearly once the link is the bottleneck.
+	unsigned int outputQueue = GetOutputQueue();
+	long long now = PlayzerXTelemetry::Now();
+	double pending = m_Estimator.GetPendingLevel(outputQueue, now);
+	double byteRate = kBaudRate / 10.0;
+	long long start = m_Estimator.GetEmissionTime(pending, byteRate, outputQueue, now);
+	if (time < start)
+	{
+		m_LastError = PlayzerXError::ERROR_FUNCTION_TIMEOUT;
+		return false;
+	}
+	double rate = m_Estimator.GetSampleRate();
+	unsigned long long low = 0, high = (unsigned long long)((time - now) * 1e-9 * rate) + 1;
+	while (low < high)
+	{
+		unsigned long long middle = (low + high) / 2;
+		if (m_Estimator.GetEmissionTime(pending + middle, byteRate, outputQueue, now) < time)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	unsigned int numPadding = (unsigned int)low;
+	if (numPadding > 0 &&
+		time - m_Estimator.GetEmissionTime(pending + numPadding - 1, byteRate, outputQueue, now) <
+			m_Estimator.GetEmissionTime(pending + numPadding, byteRate, outputQueue, now) - time)
+		numPadding--;
+
+	unsigned int bytesPerSample = frame.GetBytesPerSample();
+	unsigned char pad[kBytesPerSampleXYRGB];
+	std::copy(frame.GetData(), frame.GetData() + bytesPerSample, pad);
+	if (padding == PlayzerXPadding::BLANK)
+		std::fill(pad + 7, pad + bytesPerSample - 1, (unsigned char)0);
+
+	// Padding and frame are one sequence, so the frame starts right behind the padding. A full
+	// device buffer delays the first chunk, which does not move the schedule.
+	int chunkLevel = (int)(m_RGBCapable ? kBufferSizeRGB : kBufferSize) - (int)kSendChunkSamples;
+	SendChunks(numPadding + frame.GetNumSamples(), bytesPerSample, chunkLevel,
+			   [&](unsigned int first, unsigned int count,
+				   unsigned char* buffer) -> const unsigned char*
+			   {
+				   if (first >= numPadding)
+					   return frame.GetData() + (first - numPadding) * bytesPerSample;
+				   unsigned char* bytes = buffer;
+				   for (; first < numPadding && count > 0; first++, count--)
+					   bytes = std::copy(pad, pad + bytesPerSample, bytes);
+				   std::copy(frame.GetData(), frame.GetData() + count * bytesPerSample, bytes);
+				   return (const unsigned char*)buffer;
+			   });
+	return m_LastError == PlayzerXError::SUCCESS;
+}
+
+void PlayzerX::SendChunks(
+	unsigned int numSamples, unsigned int bytesPerSample, int bufferLevelToSend,
+	const std::function<const unsigned char*(unsigned int, unsigned int, unsigned char*)>& encode)
+{
+	// Later chunks wait until the device has room for them, whatever bufferLevelToSend is
+	int chunkLevel = (int)(m_RGBCapable ? kBufferSizeRGB : kBufferSize) - (int)kSendChunkSamples;
+
+	unsigned int count = std::min(numSamples, kSendChunkSamples);
+	m_CommandBytes.resize(count * bytesPerSample);
+	const unsigned char* bytes = (count > 0) ? encode(0, count, &m_CommandBytes[0]) : nullptr;
+
+	long serialError = FlushCoalesced();
+	for (unsigned int first = 0; first < numSamples && serialError == 0;)
+	{
+		// The previous chunk must have left the host before this one is queued
+		if (first > 0) serialError = DrainData();
+		if (serialError != 0) break;
+
+		WaitForBufferLevel(first == 0 ? bufferLevelToSend : chunkLevel);
+
+		serialError = WriteData(bytes, count * bytesPerSample, count);
+		first += count;
+
+		// Encode the next chunk while this one is being transmitted
+		count = std::min(numSamples - first, kSendChunkSamples);
+		if (count > 0 && serialError == 0) bytes = encode(first, count, &m_CommandBytes[0]);
+	}
+
+	// As before, return once the data has been transmitted
+	if (serialError == 0 && numSamples > 0) serialError = DrainData();
+
+	if (serialError == 0)
+		m_LastError = PlayzerXError::SUCCESS;
+	else
+		m_LastError = PlayzerXError::ERROR_GENERAL;
+}
+
+void PlayzerX::Commit(const PlayzerXTransaction& transaction)
+{
+	if (!IsSerialAccessible()) return;
+	if (transaction.IsEmpty())
+	{
+		m_LastError = PlayzerXError::SUCCESS;
 		return;
 	}
 
-	unsigned char sendData[20];
-	sendData[0] = 'p';
-	sendData[1] = 'l';
-	sendData[2] = 'c';
-	sendData[3] = 5;
-	sendData[4] = 10;  // Include suffix here!
-	long serialError = m_SerialDevice->Write(sendData, 5, 0, 200);
+	// As in SetBufferUpdateTimer(), the reader thread must not consume the flush afterwards
+	int bufferUpdateTimer = transaction.GetBufferUpdateTimer();
+	if (bufferUpdateTimer >= 0) m_Telemetry.Stop();
+
+	long serialError = FlushCoalesced();
+	if (serialError == 0)
+		serialError = WriteData(transaction.GetData(), transaction.GetNumBytes(),
+								transaction.GetNumSamples(), false);
+
+	if (serialError == 0)
+	{
+		// Only the samples behind the last clear remain in the device
+		unsigned int outputQueue = GetOutputQueue();
+		long long now = PlayzerXTelemetry::Now();
+		if (transaction.GetSampleRate() >= 0)
+		{
+			m_SampleRate = (unsigned int)transaction.GetSampleRate();
+			m_Estimator.SetSampleRate(m_SampleRate);
+		}
+		if (transaction.HasClear())
+		{
+			m_Estimator.OnClear(outputQueue, now);
+			m_ClearSequence = m_SampleSequence.load() - transaction.GetNumSamplesAfterClear();
+		}
+		m_Estimator.OnWrite(transaction.GetNumSamplesAfterClear(),
+							transaction.GetSampleBytesAfterClear(), outputQueue, now);
+		serialError = DrainData();
+	}
+	if (bufferUpdateTimer >= 0) OnBufferUpdateTimerSent(bufferUpdateTimer, serialError);
+
 	if (serialError == 0)
 		m_LastError = PlayzerXError::SUCCESS;
 	else
 		m_LastError = PlayzerXError::ERROR_GENERAL;
 }
 
-void PlayzerX::SetSampleRate(unsigned int sampleRate)
+void PlayzerX::SetWriteCoalescing(unsigned int maxSamples, unsigned int maxDelayUs)
 {
-	if (!m_SerialDevice)
+	if (maxSamples <= 1)
 	{
-		m_LastError = PlayzerXError::ERROR_CONNECTION;
+		StopCoalescing();
+		m_LastError = PlayzerXError::SUCCESS;
 		return;
 	}
+
+	FlushCoalesced();
+	{
+		std::lock_guard<std::mutex> lock(m_CoalesceMutex);
+		m_CoalesceMaxSamples = maxSamples;
+		m_CoalesceMaxDelay = 1000LL * maxDelayUs;
+		m_CoalesceBytes.reserve(maxSamples * kBytesPerSampleXYRGB);
+		m_LastError = PlayzerXError::SUCCESS;
+		if (m_CoalesceRunning) return;
+		m_CoalesceRunning = true;
+	}
+	m_CoalesceThread = std::thread(&PlayzerX::CoalesceThread, this);
+}
+
+void PlayzerX::FlushCoalescedSamples()
+{
+	if (!IsSerialAccessible()) return;
+
+	long serialError = FlushCoalesced();
+	if (serialError == 0) serialError = m_CoalesceError.exchange(0);
+	if (serialError == 0) serialError = DrainData();
+
+	if (serialError == 0)
+		m_LastError = PlayzerXError::SUCCESS;
+	else
+		m_LastError = PlayzerXError::ERROR_GENERAL;
+}
+
+void PlayzerX::CoalesceSample(const unsigned char* bytes, unsigned int numBytes)
+{
+	bool full;
+	{
+		std::lock_guard<std::mutex> lock(m_CoalesceMutex);
+		if (m_CoalesceSamples == 0)
+		{
+			m_CoalesceDeadline = PlayzerXTelemetry::Now() + m_CoalesceMaxDelay;
+			m_CoalesceCondition.notify_one();
+		}
+		m_CoalesceBytes.insert(m_CoalesceBytes.end(), bytes, bytes + numBytes);
+		full = ++m_CoalesceSamples >= m_CoalesceMaxSamples;
+	}
+
+	long serialError = full ? FlushCoalesced() : 0;
+	if (serialError == 0) serialError = m_CoalesceError.exchange(0);
+
+	if (serialError == 0)
+		m_LastError = PlayzerXError::SUCCESS;
+	else
+		m_LastError = PlayzerXError::ERROR_GENERAL;
+}
+
+long PlayzerX::FlushCoalesced()
+{
+	// Held for the whole write, so that no other write can overtake the samples taken here
+	std::lock_guard<std::mutex> writeLock(m_CoalesceWriteMutex);
+	unsigned int numSamples;
+	{
+		std::lock_guard<std::mutex> lock(m_CoalesceMutex);
+		numSamples = m_CoalesceSamples;
+		if (numSamples == 0) return 0;
+		// New samples can be held back while these are written
+		m_CoalesceWriteBytes.swap(m_CoalesceBytes);
+		m_CoalesceBytes.clear();
+		m_CoalesceSamples = 0;
+	}
+	return WriteData(&m_CoalesceWriteBytes[0], (unsigned int)m_CoalesceWriteBytes.size(),
+					 numSamples);
+}
+
+void PlayzerX::CoalesceThread()
+{
+	std::unique_lock<std::mutex> lock(m_CoalesceMutex);
+	while (m_CoalesceRunning)
+	{
+		if (m_CoalesceSamples == 0)
+		{
+			m_CoalesceCondition.wait(lock);
+			continue;
+		}
+
+		long long deadline = m_CoalesceDeadline;
+		if (PlayzerXTelemetry::Now() < deadline)
+		{
+			m_CoalesceCondition.wait_until(
+				lock, std::chrono::steady_clock::time_point(
+						  std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+							  std::chrono::nanoseconds(deadline))));
+			continue;
+		}
+
+		lock.unlock();
+		long serialError = FlushCoalesced();
+		if (serialError != 0) m_CoalesceError.store(serialError);
+		lock.lock();
+	}
+}
+
+void PlayzerX::StopCoalescing()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_CoalesceMutex);
+		m_CoalesceMaxSamples = 0;
+		m_CoalesceRunning = false;
+	}
+	m_CoalesceCondition.notify_all();
+	if (m_CoalesceThread.joinable()) m_CoalesceThread.join();
+	FlushCoalesced();
+}
+
+void PlayzerX::ClearData()
+{
+	if (!IsSerialAccessible(true)) return;
+
+	// The rest of a sample the engine could not finish goes first and brings the device back in
+	// step; the clear then discards that sample with the others
+	std::vector<unsigned char> sendData(m_ResyncBytes);
+	sendData.push_back('p');
+	sendData.push_back('l');
+	sendData.push_back('c');
+	sendData.push_back(5);
+	sendData.push_back(10);  // Include suffix here!
+	long serialError = WriteCommand(&sendData[0], (unsigned int)sendData.size());
+	if (serialError == 0)
+	{
+		m_ResyncBytes.clear();
+		m_Estimator.OnClear(GetOutputQueue(), PlayzerXTelemetry::Now());
+		m_ClearSequence = m_SampleSequence.load();
+		m_LastError = PlayzerXError::SUCCESS;
+	}
+	else
+		m_LastError = PlayzerXError::ERROR_GENERAL;
+}
+
+void PlayzerX::SetSampleRate(unsigned int sampleRate)
+{
+	if (!IsSerialAccessible()) return;
 	sampleRate = std::min(std::max(sampleRate, 200u), 50000u);
 	unsigned char sendData[20];
 	sendData[0] = 'p';
@@ -541,19 +848,21 @@ void PlayzerX::SetSampleRate(unsigned int sampleRate)
 	sendData[5] = (sampleRate & 0x00FF00) >> 8;
 	sendData[6] = (sampleRate & 0xFF0000) >> 16;
 	sendData[7] = 10;  // Include suffix here!
-	long serialError = m_SerialDevice->Write(sendData, 8, 0, 200);
-	if (serialError == 0) m_SampleRate = sampleRate;
+	long serialError = WriteCommand(sendData, 8);
+	if (serialError == 0)
+	{
+		m_SampleRate = sampleRate;
+		m_Estimator.SetSampleRate(sampleRate);
+	}
 }
 
 void PlayzerX::SetBufferUpdateTimer(unsigned int bufferUpdateTimer)
 {
-	if (!m_SerialDevice)
-	{
-		m_LastError = PlayzerXError::ERROR_CONNECTION;
-		return;
-	}
+	if (!IsSerialAccessible()) return;
+
+	// The reader thread must not consume the flush below
+	m_Telemetry.Stop();
 
-	m_StreamingSamplesRemaining = (bufferUpdateTimer > 0);
 	int updateRateLoops = std::min(std::max(bufferUpdateTimer, 0u), 1000u);
 
 	unsigned char sendData[20];
@@ -564,12 +873,23 @@ void PlayzerX::SetBufferUpdateTimer(unsigned int bufferUpdateTimer)
 	sendData[4] = (updateRateLoops & 0x000000FF);
 	sendData[5] = (updateRateLoops & 0x0000FF00) >> 8;
 	sendData[6] = 10;  // Include suffix here!
-	long serialError = m_SerialDevice->Write(sendData, 7, 0, 200);
+	long serialError = WriteCommand(sendData, 7);
+	OnBufferUpdateTimerSent(updateRateLoops, serialError);
+}
+
+void PlayzerX::OnBufferUpdateTimerSent(unsigned int bufferUpdateTimer, long serialError)
+{
+	m_StreamingSamplesRemaining = (bufferUpdateTimer > 0);
 
 	// If there is a change of this setting we will clear the serial data already sent
 	// clear all data previously sent by the controller to the host
 	unsigned char data[MTI_SERIAL_QUEUE_SIZE];
 	m_SerialDevice->Read(data, MTI_SERIAL_QUEUE_SIZE, 0, 0, MTI_BLOCKING_MODE_OFF);
+
+	// From now on updates are consumed continuously in the background
+	m_BufferUpdateTimer = (serialError == 0) ? bufferUpdateTimer : 0;
+	m_EstimatorUpdateCount = 0;
+	if (m_StreamingSamplesRemaining && serialError == 0) m_Telemetry.Start(m_SerialDevice);
 }
 
 bool PlayzerX::GetDeviceInfo()
@@ -586,22 +906,22 @@ bool PlayzerX::GetDeviceInfo()
 	sendData[2] = 'n';
 	sendData[3] = 5;
 	sendData[4] = 10;  // Include suffix here!
-	long serialError = m_SerialDevice->Write(sendData, 5, 0, 200);
+	long serialError = WriteCommand(sendData, 5);
 	if (serialError != 0) return false;
 
 	char dataconf[128];
 	unsigned char delineationChar = 0x0A;
 	long lastError;
 	// Enforce byte alignment by sliding until finding the complete preamble
-	lastError = m_SerialDevice->ReadText(dataconf, delineationChar, m_TimeOut);
+	lastError = m_SerialDevice->ReadLine(dataconf, sizeof(dataconf), delineationChar, m_TimeOut);
 	if (strcmp(dataconf, "pl-info")) return false;
-	lastError = m_SerialDevice->ReadText(dataconf, delineationChar, m_TimeOut);
+	lastError = m_SerialDevice->ReadLine(dataconf, sizeof(dataconf), delineationChar, m_TimeOut);
 	std::string reply1(dataconf);
 	m_DeviceName = reply1;
-	lastError = m_SerialDevice->ReadText(dataconf, delineationChar, m_TimeOut);
+	lastError = m_SerialDevice->ReadLine(dataconf, sizeof(dataconf), delineationChar, m_TimeOut);
 	std::string reply2(dataconf);
 	m_FirmwareName = reply2;
-	lastError = m_SerialDevice->ReadText(dataconf, delineationChar, m_TimeOut);
+	lastError = m_SerialDevice->ReadLine(dataconf, sizeof(dataconf), delineationChar, m_TimeOut);
 	if (lastError == 0)
 	{
 		std::string reply3(dataconf);
@@ -625,6 +945,10 @@ bool PlayzerX::IsDeviceConnected()
 		return false;
 	}
 
+	// The reply is read directly, pause the telemetry reader for this exchange
+	bool resumeTelemetry = m_Telemetry.IsRunning();
+	m_Telemetry.Stop();
+
 	// let's purge serial buffers before this ping to controller
 	PurgeSerialBuffers();
 
@@ -634,18 +958,22 @@ bool PlayzerX::IsDeviceConnected()
 	sendData[2] = 'p';
 	sendData[3] = 5;
 	sendData[4] = 10;  // Include suffix here!
-	long serialError = m_SerialDevice->Write(sendData, 5, 0, 200);
-	if (serialError != 0) return false;
+	long serialError = WriteCommand(sendData, 5);
 
-	char dataconf[100];
-	unsigned char delineationChar = 0x0A;
-	long lastError;
-	// Enforce byte alignment by sliding until finding the complete preamble
-	lastError = m_SerialDevice->ReadText(dataconf, delineationChar, m_TimeOut);
-	if (strcmp(dataconf, "pl-ok"))
-		return false;
-	else
-		return true;
+	bool connected = false;
+	if (serialError == 0)
+	{
+		char dataconf[100];
+		unsigned char delineationChar = 0x0A;
+		long lastError;
+		// Enforce byte alignment by sliding until finding the complete preamble
+		lastError =
+			m_SerialDevice->ReadLine(dataconf, sizeof(dataconf), delineationChar, m_TimeOut);
+		connected = (lastError == 0) && !strcmp(dataconf, "pl-ok");
+	}
+
+	if (resumeTelemetry) m_Telemetry.Start(m_SerialDevice);
+	return connected;
 }
 
 void PlayzerX::PurgeSerialBuffers()
@@ -662,11 +990,7 @@ void PlayzerX::PurgeSerialBuffers()
 
 void PlayzerX::ResetDevice()
 {
-	if (!m_SerialDevice)
-	{
-		m_LastError = PlayzerXError::ERROR_CONNECTION;
-		return;
-	}
+	if (!IsSerialAccessible()) return;
 	unsigned char sendData[10];
 	sendData[0] = 'p';
 	sendData[1] = 'l';
@@ -674,7 +998,7 @@ void PlayzerX::ResetDevice()
 	sendData[3] = 6;
 	sendData[4] = 0xEE;
 	sendData[5] = 10;  // Include suffix here!
-	long serialError = m_SerialDevice->Write(sendData, 6, 0, 200);
+	long serialError = WriteCommand(sendData, 6);
 	if (serialError == 0)
 		m_LastError = PlayzerXError::SUCCESS;
 	else
@@ -684,6 +1008,8 @@ void PlayzerX::ResetDevice()
 		// we assume that the command was sent and unit reset successfully
 		// then we can assume unit is in default mode not streaming SamplesRemaining
 		m_StreamingSamplesRemaining = false;
+		m_BufferUpdateTimer = 0;
+		m_Telemetry.Stop();
 		// let's pause any execution for 2.5s, for sure unit is not available
 		Sleep(2500);
 	}
@@ -691,11 +1017,7 @@ void PlayzerX::ResetDevice()
 
 void PlayzerX::SwitchPlayzerXMode(bool enableAINMode, bool flashBoot)
 {
-	if (!m_SerialDevice)
-	{
-		m_LastError = PlayzerXError::ERROR_CONNECTION;
-		return;
-	}
+	if (!IsSerialAccessible()) return;
 	unsigned char sendData[10];
 	sendData[0] = 'p';
 	sendData[1] = 'l';
@@ -714,7 +1036,7 @@ void PlayzerX::SwitchPlayzerXMode(bool enableAINMode, bool flashBoot)
 		sendData[6] = 'b';
 	}
 	sendData[7] = 10;  // Include suffix here!
-	long serialError = m_SerialDevice->Write(sendData, 8, 0, 200);
+	long serialError = WriteCommand(sendData, 8);
 	if (serialError == 0)
 		m_LastError = PlayzerXError::SUCCESS;
 	else
@@ -723,77 +1045,122 @@ void PlayzerX::SwitchPlayzerXMode(bool enableAINMode, bool flashBoot)
 
 void PlayzerX::GetAvailableDevices(PlayzerXAvailableDevices& plad)
 {
+	plad.DeviceName.clear();
+	plad.FirmwareName.clear();
+	plad.DataFormat.clear();
+	plad.USARTBaudRate.clear();
+	plad.CommPortNumber.clear();
+	plad.CommPortName.clear();
 	plad.NumDevices = 0;
 
-	// Pasted from GetAvailablePorts
-	unsigned int NumPorts = 0;
-	char portname[32];
-	unsigned int AvailablePortNumbers[MTI_SERIAL_MAXPORTS];
+	// Candidate ports: device path, display name and number
+	std::vector<std::string> portPaths;
+	std::vector<std::string> portNames;
+	std::vector<unsigned int> portNumbers;
 
-#ifdef MTI_WINDOWS
-	CEnumerateSerial::CPortsArray ports;
-	CEnumerateSerial::UsingQueryDosDevice(ports);
-
-	for (int i = 0; i < ports.GetSize(); i++) AvailablePortNumbers[NumPorts++] = ports[i];
-#else
-	for (unsigned int i = 0; i < MTI_SERIAL_MAXPORTS; i++)
+	std::vector<PlayzerXPortInfo> ports;
+	if (EnumerateSerialPorts(ports))
 	{
-		sprintf(portname, MTI_PORT_PREFIX "%d", i);
-		if (MTISerialIO::IsPortAvailable(portname)) AvailablePortNumbers[NumPorts++] = i;
+		// sysfs tells which ports are USB adapters, nothing else needs to be opened
+		for (const PlayzerXPortInfo& port : ports)
+		{
+			if (!IsCandidatePort(port, m_PortFilter)) continue;
+			size_t digits = port.PortName.find_last_not_of("0123456789") + 1;
+			portPaths.push_back(port.DevicePath);
+			portNames.push_back(port.PortName);
+			portNumbers.push_back((unsigned int)atoi(port.PortName.c_str() + digits));
+		}
 	}
+	else
+	{
+		// Pasted from GetAvailablePorts
+		std::vector<unsigned int> AvailablePortNumbers;
+		char portname[32];
+
+#ifdef MTI_WINDOWS
+		CEnumerateSerial::CPortsArray comPorts;
+		CEnumerateSerial::UsingQueryDosDevice(comPorts);
+
+		for (int i = 0; i < comPorts.GetSize(); i++) AvailablePortNumbers.push_back(comPorts[i]);
+#else
+		for (unsigned int i = 0; i < MTI_SERIAL_MAXPORTS; i++)
+		{
+			sprintf(portname, MTI_PORT_PREFIX "%d", i);
+			if (MTISerialIO::IsPortAvailable(portname)) AvailablePortNumbers.push_back(i);
+		}
 #endif
 
-	if (NumPorts == 0) return;
+		for (unsigned int portNumber : AvailablePortNumbers)
+		{
+			sprintf(portname, MTI_PORT_PREFIX "%d", portNumber);
+			portPaths.push_back(portname);
+			portNames.push_back(MTI_PORT_DISPLAY + std::to_string(portNumber));
+			portNumbers.push_back(portNumber);
+		}
+	}
 
-	char s[16];
-	long lastError = 0;
-	unsigned int NumDevices = 0;
+	unsigned int NumPorts = (unsigned int)portPaths.size();
+	if (NumPorts == 0) return;
 
-	m_CommandBytes.clear();
-	m_CommandBytes.resize(5);
+	// Each port gets its own thread and its own temporary device object, so the probes
+	// time out together instead of one after the other
+	std::vector<PlayzerX> probes(NumPorts);
+	for (PlayzerX& probe : probes) probe.m_TransportFactory = m_TransportFactory;
+	std::vector<char> responding(NumPorts, 0);
+	std::vector<std::thread> threads;
+	threads.reserve(NumPorts);
+	for (unsigned int i = 0; i < NumPorts; i++)
+		threads.emplace_back([&probes, &responding, &portPaths, i]()
+							 { responding[i] = probes[i].ProbePort(portPaths[i]); });
+	for (std::thread& thread : threads) thread.join();
 
 	for (unsigned int i = 0; i < NumPorts; i++)
 	{
-		m_SerialDevice = new MTISerialIO;
-		sprintf(s, MTI_PORT_PREFIX "%d", AvailablePortNumbers[i]);
-		lastError = m_SerialDevice->Open(s, kBaudRate);
-		if (lastError == 0)
-		{
-			m_CommandBytes[0] = 0x0A;
-			m_CommandBytes[1] = 0x0A;
-			m_CommandBytes[2] = 0x0C;
-			m_CommandBytes[3] = 0x0A;
-			m_CommandBytes[4] = 0x0A;
-			// Send 5 carriage returns
-			lastError = m_SerialDevice->Write(&m_CommandBytes[0], 5, 0, 200);
-			// Send 5 carriage returns
-			lastError = m_SerialDevice->Write(&m_CommandBytes[0], 5, 0, 200);
-			int keepTimeOut = m_TimeOut;
-			m_TimeOut = 200;
-			// Check if connected and query target information
-			bool isResponding = IsDeviceConnected();
-			if (isResponding)
-			{
-				bool success = GetDeviceInfo();
-				plad.DeviceName[NumDevices] = m_DeviceName;
-				plad.FirmwareName[NumDevices] = m_FirmwareName;
-				plad.USARTBaudRate[NumDevices] = kBaudRate;
-				plad.CommPortNumber[NumDevices] = AvailablePortNumbers[i];
-				plad.CommPortName[NumDevices].assign(MTI_PORT_DISPLAY);
-				plad.CommPortName[NumDevices].append(std::to_string(AvailablePortNumbers[i]));
-				NumDevices++;
-			}
-			DisconnectDevice();
-			m_TimeOut = keepTimeOut;
-		}
-		DisconnectDevice();
-		PurgeSerialBuffers();
-		SAFE_DELETE(m_SerialDevice);
+		if (!responding[i]) continue;
+		plad.DeviceName.push_back(probes[i].m_DeviceName);
+		plad.FirmwareName.push_back(probes[i].m_FirmwareName);
+		plad.DataFormat.push_back(probes[i].m_DataFormat);
+		plad.USARTBaudRate.push_back(kBaudRate);
+		plad.CommPortNumber.push_back(portNumbers[i]);
+		plad.CommPortName.push_back(portNames[i]);
 	}
-	plad.NumDevices = NumDevices;
+	plad.NumDevices = (unsigned int)plad.DeviceName.size();
 	return;
 }
 
+bool PlayzerX::ProbePort(const std::string& portPath)
+{
+	m_SerialDevice = CreateTransport(portPath);
+	if (m_SerialDevice == nullptr) m_SerialDevice = new MTISerialIO;
+	long lastError = m_SerialDevice->Open(portPath.c_str(), kBaudRate);
+	bool isResponding = false;
+	if (lastError == 0)
+	{
+		unsigned char commandBytes[5] = {0x0A, 0x0A, 0x0C, 0x0A, 0x0A};
+		// Send 5 carriage returns
+		lastError = m_SerialDevice->Write(commandBytes, 5, 0, 200);
+		// Send 5 carriage returns
+		lastError = m_SerialDevice->Write(commandBytes, 5, 0, 200);
+		int keepTimeOut = m_TimeOut;
+		m_TimeOut = 200;
+		// Check if connected and query target information
+		isResponding = IsDeviceConnected();
+		if (isResponding) GetDeviceInfo();
+		DisconnectDevice();
+		m_TimeOut = keepTimeOut;
+	}
+	SAFE_DELETE(m_SerialDevice);
+	return isResponding;
+}
+
+MTISerialIO* PlayzerX::CreateTransport(const std::string& portName)
+{
+	MTISerialIO* transport = m_TransportFactory ? m_TransportFactory(portName) : nullptr;
+	if (transport == nullptr && PlayzerXTcpPort::IsTcpPortName(portName))
+		transport = new PlayzerXTcpPort;
+	return transport;
+}
+
 void PlayzerX::ListAvailableDevices(PlayzerXAvailableDevices& plad)
 {
 	printf("\n");
@@ -803,4 +1170,656 @@ void PlayzerX::ListAvailableDevices(PlayzerXAvailableDevices& plad)
 			   plad.DeviceName[i].c_str(), plad.CommPortName[i].c_str());
 }
 
+int PlayzerX::GetEstimatedSamplesRemaining()
+{
+	UpdateEstimator();
+	if (!m_Estimator.IsValid()) return -1;
+	return (int)m_Estimator.GetPendingLevel(GetOutputQueue(), PlayzerXTelemetry::Now());
+}
+
+double PlayzerX::GetClockDrift() { return m_Estimator.GetDriftPpm(); }
+
+long long PlayzerX::GetEstimatedEmissionTime(unsigned long long sampleSequence)
+{
+	UpdateEstimator();
+	if (!m_Estimator.IsValid() || sampleSequence < m_ClearSequence.load()) return -1;
+
+	// The pending samples are the last ones written, position 0 is the next to play
+	unsigned int outputQueue = GetOutputQueue();
+	long long now = PlayzerXTelemetry::Now();
+	double pending = m_Estimator.GetPendingLevel(outputQueue, now);
+	double index = (double)sampleSequence - ((double)m_SampleSequence.load() - pending);
+	return m_Estimator.GetEmissionTime(index, kBaudRate / 10.0, outputQueue, now);
+}
+
+unsigned int PlayzerX::GetOutputQueue()
+{
+	unsigned int outputQueue = 0;
+	if (!m_SerialDevice || m_SerialDevice->GetOutputQueue(&outputQueue) != 0) return 0;
+	return outputQueue;
+}
+
+void PlayzerX::UpdateEstimator()
+{
+	if (!m_Telemetry.IsRunning()) return;
+
+	// Each update is applied once, whichever thread sees it first
+	unsigned long long updateCount = m_Telemetry.GetUpdateCount();
+	unsigned long long applied = m_EstimatorUpdateCount.load(std::memory_order_acquire);
+	if (updateCount == applied ||
+		!m_EstimatorUpdateCount.compare_exchange_strong(applied, updateCount))
+		return;
+
+	int level;
+	long long timestamp;
+	if (m_Telemetry.GetLatest(level, timestamp))
+		m_Estimator.OnTelemetry(level, timestamp, GetOutputQueue(), PlayzerXTelemetry::Now());
+}
+
+bool PlayzerX::AnchorEstimator()
+{
+	UpdateEstimator();
+	if (!m_Estimator.IsValid())
+	{
+		int level = GetSamplesRemaining();
+		long long now = PlayzerXTelemetry::Now();
+		if (level >= 0) m_Estimator.OnTelemetry(level, now, GetOutputQueue(), now);
+	}
+	return m_Estimator.IsValid();
+}
+
+void PlayzerX::OnBufferLevel(int level, long long timestamp)
+{
+	m_Counters.OnBufferLevel(level);
+	m_BufferMonitor.OnBufferLevel(level, timestamp, m_Counters);
+
+	// Samples of a write in progress may have reached the device but are not counted yet
+	unsigned long long finished = m_WritesFinished.load();
+	unsigned long long started = m_WritesStarted.load();
+	if (started != finished) return;
+	unsigned long long written = m_SampleSequence.load();
+	unsigned int outputQueue = GetOutputQueue();
+	if (m_WritesStarted.load() == started)
+		m_Estimator.OnDriftReading(level, timestamp, written, outputQueue);
+}
+
+void PlayzerX::OnDataWritten(unsigned int numSamples, unsigned int numBytes)
+{
+	m_Estimator.OnWrite(numSamples, numBytes, GetOutputQueue(), PlayzerXTelemetry::Now());
+}
+
+long PlayzerX::WriteCommand(unsigned char* command, unsigned int numBytes)
+{
+	long serialError = FlushCoalesced();
+	if (serialError != 0) return serialError;
+
+	long long start = PlayzerXTelemetry::Now();
+	unsigned long partialWrites = m_SerialDevice->GetPartialWrites();
+	serialError = m_SerialDevice->Write(command, numBytes, 0, 200);
+	m_Counters.OnWrite(numBytes, 0, PlayzerXTelemetry::Now() - start,
+					   m_SerialDevice->GetPartialWrites() - partialWrites, serialError != 0);
+	return serialError;
+}
+
+long PlayzerX::WriteData(const unsigned char* bytes, unsigned int numBytes,
+						 unsigned int numSamples, bool updateEstimator)
+{
+	long long start = PlayzerXTelemetry::Now();
+	unsigned long partialWrites = m_SerialDevice->GetPartialWrites();
+	unsigned int numWritten = 0;
+	m_WritesStarted.fetch_add(1);
+	long serialError = m_SerialDevice->WriteQueued(const_cast<unsigned char*>(bytes), numBytes,
+												   &numWritten, 2000);
+	m_Counters.OnWrite(numWritten, (serialError == 0) ? numSamples : 0,
+					   PlayzerXTelemetry::Now() - start,
+					   m_SerialDevice->GetPartialWrites() - partialWrites, serialError != 0);
+	if (serialError == 0) m_SampleSequence.fetch_add(numSamples);
+	m_WritesFinished.fetch_add(1);
+	if (serialError == 0 && updateEstimator) OnDataWritten(numSamples, numBytes);
+	return serialError;
+}
+
+long PlayzerX::DrainData()
+{
+	long long start = PlayzerXTelemetry::Now();
+	long serialError = m_SerialDevice->Drain(2000);
+	m_Counters.OnDrain(PlayzerXTelemetry::Now() - start, serialError != 0);
+	return serialError;
+}
+
+bool PlayzerX::IsSerialAccessible(bool resync)
+{
+	if (!m_SerialDevice)
+	{
+		m_LastError = PlayzerXError::ERROR_CONNECTION;
+		return false;
+	}
+	if (IsStreaming())
+	{
+		m_LastError = PlayzerXError::ERROR_PLAYZERX_RUNNING_STATE;
+		return false;
+	}
+	// The device would read anything else as the rest of the sample cut short
+	if (!resync && !m_ResyncBytes.empty())
+	{
+		m_LastError = PlayzerXError::ERROR_CONNECTION;
+		return false;
+	}
+	return true;
+}
+
+unsigned int PlayzerX::EncodeSamples(const PlayzerXSample* samples, unsigned int numSamples,
+									 unsigned char* bytes)
+{
+	unsigned count = 0;
+	for (unsigned int i = 0; i < numSamples; i++)
+	{
+		const PlayzerXSample& s = samples[i];
+		if (s.format == PlayzerXDataFormat::XY)
+			count += EncodeDataXY(&s.x, &s.y, 1, bytes + count);
+		else if (s.format == PlayzerXDataFormat::XYM)
+			count += EncodeDataXYM(&s.x, &s.y, &s.m, 1, bytes + count);
+		else
+			count += EncodeDataXYRGB(&s.x, &s.y, &s.r, &s.g, &s.b, 1, bytes + count);
+	}
+	return count;
+}
+
+bool PlayzerX::StartStreaming(unsigned int targetBufferLevel, unsigned int ringCapacity)
+{
+	if (!IsSerialAccessible()) return IsStreaming();
+	// With no target level the device buffer is always full enough and nothing is ever sent
+	if (targetBufferLevel == 0 || ringCapacity == 0)
+	{
+		m_LastError = PlayzerXError::ERROR_INVALID_PARAM;
+		return false;
+	}
+
+	m_StreamRing.Resize(ringCapacity);
+	return StartTransmitThread(targetBufferLevel, PlayzerXStreamMode::QUEUE);
+}
+
+bool PlayzerX::StartSteering(unsigned int targetBufferLevel)
+{
+	if (!IsSerialAccessible()) return IsSteering();
+	// About 5 ms of output leaves room for scheduling delays without adding noticeable latency
+	if (targetBufferLevel == 0) targetBufferLevel = std::max(m_SampleRate / 200, 16u);
+
+	m_SteerMailbox.Clear();
+	return StartTransmitThread(targetBufferLevel, PlayzerXStreamMode::STEERING);
+}
+
+bool PlayzerX::StartTransmitThread(unsigned int targetBufferLevel, PlayzerXStreamMode mode)
+{
+	// Pump() cannot wait for query replies, the engine runs on the periodic updates
+	if (m_PumpMode && !m_Telemetry.IsRunning())
+	{
+		m_LastError = PlayzerXError::ERROR_SCAN_NOT_SET;
+		return false;
+	}
+	if (FlushCoalesced() != 0)
+	{
+		m_LastError = PlayzerXError::ERROR_GENERAL;
+		return false;
+	}
+
+	m_StreamBatch.resize(kStreamBatchSamples);
+	m_StreamBytes.resize(kStreamBatchSamples * 11);
+	m_StreamTargetLevel = targetBufferLevel;
+	m_StreamSamplesRemaining = -1;
+	m_StreamMode = mode;
+	m_TransmitFrame.reset();
+	m_TransmitFrameOffset = 0;
+	m_TransmitLastQuery = 0;
+	m_StreamPhaseShift = 0;
+	m_StreamPhaseShifted = 0;
+	m_StreamStartSequence = m_SampleSequence.load();
+
+	m_Streaming.store(true, std::memory_order_release);
+	if (m_PumpMode)
+	{
+		m_Telemetry.Stop();
+		m_Telemetry.Attach(m_SerialDevice);
+		m_EstimatorUpdateCount = 0;
+	}
+	else
+		m_TransmitThread = std::thread(&PlayzerX::TransmitThread, this);
+
+	m_LastError = PlayzerXError::SUCCESS;
+	return true;
+}
+
+void PlayzerX::StopStreaming()
+{
+	if (!IsStreaming()) return;
+
+	m_Streaming.store(false, std::memory_order_release);
+	m_StreamHold.store(false, std::memory_order_release);
+	if (m_TransmitThread.joinable())
+		m_TransmitThread.join();
+	else
+		StopPumping();
+	m_StreamRing.Clear();
+	m_SteerMailbox.Clear();
+	std::atomic_store(&m_LoopFrame, std::shared_ptr<const LoopFrame>());
+	m_TransmitFrame.reset();
+	m_StreamMode = PlayzerXStreamMode::QUEUE;
+}
+
+void PlayzerX::StopPumping()
+{
+	// The device must not be left with part of a sample
+	if (!m_PumpBytes.empty())
+		WritePumped(&m_PumpBytes[0], (unsigned int)m_PumpBytes.size(), 2000);
+	if (!m_PumpBytes.empty())
+	{
+		// The transport failed; the rest of a sample cut short waits for ClearData()
+		if (m_PumpWritten > 0)
+			m_ResyncBytes.assign(m_PumpBytes.begin() + m_PumpWritten,
+								 m_PumpBytes.begin() + m_PumpBytes[3]);
+		m_PumpBytes.clear();
+		m_PumpWritten = 0;
+		m_WritesFinished.fetch_add(1);
+	}
+
+	m_Telemetry.Stop();
+	m_Telemetry.Start(m_SerialDevice);
+	m_EstimatorUpdateCount = 0;
+}
+
+bool PlayzerX::SetPumpMode(bool enable)
+{
+	if (IsStreaming())
+	{
+		m_LastError = PlayzerXError::ERROR_PLAYZERX_RUNNING_STATE;
+		return false;
+	}
+#ifdef MTI_WINDOWS
+	// Overlapped writes that time out are cancelled without reporting the bytes already sent, so
+	// a write Pump() retries would repeat them
+	if (enable)
+	{
+		m_LastError = PlayzerXError::ERROR_CONNECTION;
+		return false;
+	}
+#endif
+	m_PumpMode = enable;
+	m_LastError = PlayzerXError::SUCCESS;
+	return true;
+}
+
+long long PlayzerX::Pump()
+{
+	if (!m_PumpMode || !IsStreaming()) return -1;
+
+	// Retry interval for a pending write, for transports without a descriptor to wait on
+	const long long kPendingWriteRetry = 1000000LL;
+
+	m_Telemetry.Poll();
+	if (!m_PumpBytes.empty() &&
+		!WritePumped(&m_PumpBytes[0], (unsigned int)m_PumpBytes.size(), 0))
+		return PlayzerXTelemetry::Now() + kPendingWriteRetry;
+
+	// Passes that wrote samples are followed by another, until a wait is due
+	long long wakeUp;
+	do
+	{
+		wakeUp = TransmitStep();
+		if (HasPendingWrite()) return PlayzerXTelemetry::Now() + kPendingWriteRetry;
+	} while (wakeUp <= PlayzerXTelemetry::Now());
+	return wakeUp;
+}
+
+void PlayzerX::ShiftStreamPhase(int samples)
+{
+	m_StreamPhaseShift.fetch_add(samples);
+	m_StreamPhaseShifted.fetch_add(samples);
+}
+
+double PlayzerX::GetStreamPhase()
+{
+	if (!IsStreaming()) return -1;
+	UpdateEstimator();
+	if (!m_Estimator.IsValid()) return -1;
+
+	// Samples written since the start, less those still pending in the device and transport
+	double pending = m_Estimator.GetPendingLevel(GetOutputQueue(), PlayzerXTelemetry::Now());
+	double written = (double)(m_SampleSequence.load() - m_StreamStartSequence.load());
+	return written - pending - (double)m_StreamPhaseShifted.load();
+}
+
+bool PlayzerX::SetLoopFrame(const EncodedFrame& frame, unsigned int targetBufferLevel)
+{
+	if (IsStreaming() && m_StreamMode != PlayzerXStreamMode::LOOP)
+	{
+		m_LastError = PlayzerXError::ERROR_PLAYZERX_RUNNING_STATE;
+		return false;
+	}
+	if (!IsStreaming() && !IsSerialAccessible()) return false;
+	if (!IsStreaming() && targetBufferLevel == 0)
+	{
+		m_LastError = PlayzerXError::ERROR_INVALID_PARAM;
+		return false;
+	}
+
+	// Short frames are repeated up front, a frame boundary of the copy is one of the original
+	std::shared_ptr<LoopFrame> loopFrame = std::make_shared<LoopFrame>();
+	loopFrame->bytesPerSample = frame.GetBytesPerSample();
+	loopFrame->numSamples = frame.GetNumSamples();
+	if (loopFrame->numSamples > 0)
+	{
+		unsigned int numSamples = loopFrame->numSamples;
+		unsigned int repeats = (kMinLoopSamples + numSamples - 1) / numSamples;
+		loopFrame->bytes.reserve(repeats * frame.GetNumBytes());
+		for (unsigned int i = 0; i < repeats; i++)
+			loopFrame->bytes.insert(loopFrame->bytes.end(), frame.GetData(),
+									frame.GetData() + frame.GetNumBytes());
+		loopFrame->numSamples *= repeats;
+	}
+	std::atomic_store(&m_LoopFrame, std::shared_ptr<const LoopFrame>(loopFrame));
+
+	if (IsStreaming())
+	{
+		m_LastError = PlayzerXError::SUCCESS;
+		return true;
+	}
+	return StartTransmitThread(targetBufferLevel, PlayzerXStreamMode::LOOP);
+}
+
+void PlayzerX::PostTargetXYM(float x, float y, unsigned char m)
+{
+	unsigned char bytes[kBytesPerSampleXYM];
+	EncodeDataXYM(&x, &y, &m, 1, bytes);
+	m_SteerMailbox.Post(PlayzerXDataFormat::XYM, bytes);
+}
+
+void PlayzerX::PostTargetXY(float x, float y)
+{
+	unsigned char bytes[kBytesPerSampleXY];
+	EncodeDataXY(&x, &y, 1, bytes);
+	m_SteerMailbox.Post(PlayzerXDataFormat::XY, bytes);
+}
+
+void PlayzerX::PostTargetXYRGB(float x, float y, unsigned char r, unsigned char g,
+							   unsigned char b)
+{
+	unsigned char bytes[kBytesPerSampleXYRGB];
+	EncodeDataXYRGB(&x, &y, &r, &g, &b, 1, bytes);
+	m_SteerMailbox.Post(PlayzerXDataFormat::XYRGB, bytes);
+}
+
+unsigned int PlayzerX::PushSamples(const PlayzerXSample* samples, unsigned int numSamples)
+{
+	if (!IsStreaming() || m_StreamMode != PlayzerXStreamMode::QUEUE) return 0;
+	return (unsigned int)m_StreamRing.Push(samples, numSamples);
+}
+
+unsigned int PlayzerX::PushDataXYM(const float* x, const float* y, const unsigned char* m,
+								   unsigned int numSamples)
+{
+	PlayzerXSample block[256];
+	unsigned int pushed = 0;
+	while (pushed < numSamples)
+	{
+		unsigned int n = std::min(numSamples - pushed, 256u);
+		for (unsigned int i = 0; i < n; i++)
+		{
+			block[i].x = x[pushed + i];
+			block[i].y = y[pushed + i];
+			block[i].m = m[pushed + i];
+			block[i].format = PlayzerXDataFormat::XYM;
+		}
+		unsigned int accepted = PushSamples(block, n);
+		pushed += accepted;
+		if (accepted < n) break;  // ring is full
+	}
+	return pushed;
+}
+
+unsigned int PlayzerX::PushDataXY(const float* x, const float* y, unsigned int numSamples)
+{
+	PlayzerXSample block[256];
+	unsigned int pushed = 0;
+	while (pushed < numSamples)
+	{
+		unsigned int n = std::min(numSamples - pushed, 256u);
+		for (unsigned int i = 0; i < n; i++)
+		{
+			block[i].x = x[pushed + i];
+			block[i].y = y[pushed + i];
+			block[i].format = PlayzerXDataFormat::XY;
+		}
+		unsigned int accepted = PushSamples(block, n);
+		pushed += accepted;
+		if (accepted < n) break;  // ring is full
+	}
+	return pushed;
+}
+
+unsigned int PlayzerX::PushDataXYRGB(const float* x, const float* y, const unsigned char* r,
+									 const unsigned char* g, const unsigned char* b,
+									 unsigned int numSamples)
+{
+	PlayzerXSample block[256];
+	unsigned int pushed = 0;
+	while (pushed < numSamples)
+	{
+		unsigned int n = std::min(numSamples - pushed, 256u);
+		for (unsigned int i = 0; i < n; i++)
+		{
+			block[i].x = x[pushed + i];
+			block[i].y = y[pushed + i];
+			block[i].r = r[pushed + i];
+			block[i].g = g[pushed + i];
+			block[i].b = b[pushed + i];
+			block[i].format = PlayzerXDataFormat::XYRGB;
+		}
+		unsigned int accepted = PushSamples(block, n);
+		pushed += accepted;
+		if (accepted < n) break;  // ring is full
+	}
+	return pushed;
+}
+
+void PlayzerX::TransmitThread()
+{
+	// Longest single sleep, keeps StopStreaming() responsive
+	const long long kMaxSleep = 20000000LL;
+
+	while (m_Streaming.load(std::memory_order_acquire))
+	{
+		long long wakeUp = TransmitStep();
+		long long now = PlayzerXTelemetry::Now();
+		if (wakeUp > now) PlayzerXTelemetry::SleepUntil(std::min(wakeUp, now + kMaxSleep));
+	}
+}
+
+long long PlayzerX::TransmitStep()
+{
+	// Longest wait between passes; Pump() callers are woken earlier by the updates
+	const long long kMaxSleep = 20000000LL;
+	// Without periodic updates, the model is corrected by a device query this often
+	const long long kQueryPeriod = 100000000LL;
+	// Pause after a failed query or write
+	const long long kRetryDelay = 1000000LL;
+	bool steering = (m_StreamMode == PlayzerXStreamMode::STEERING);
+	bool looping = (m_StreamMode == PlayzerXStreamMode::LOOP);
+	long long now = PlayzerXTelemetry::Now();
+
+	// A new loop frame only takes over once the current one has been sent completely
+	std::shared_ptr<const LoopFrame>& frame = m_TransmitFrame;
+	unsigned int& frameOffset = m_TransmitFrameOffset;
+	if (looping && (!frame || frameOffset == frame->numSamples))
+	{
+		frame = std::atomic_load(&m_LoopFrame);
+		frameOffset = 0;
+	}
+
+	bool idle = looping	   ? (!frame || frame->numSamples == 0)
+				: steering ? m_SteerMailbox.IsEmpty()
+						   : m_StreamRing.Size() == 0;
+	// The thread checks for new samples often; Pump() is called again after a push
+	if (idle) return now + (m_PumpMode ? kMaxSleep : 500000LL);
+
+	UpdateEstimator();
+	now = PlayzerXTelemetry::Now();
+	if (!m_Estimator.IsValid() ||
+		(!m_Telemetry.IsRunning() && now - m_TransmitLastQuery > kQueryPeriod))
+	{
+		// Pump() must not block on a query, the next update anchors the model instead
+		if (m_PumpMode) return now + kMaxSleep;
+		int level = QuerySamplesRemaining();
+		if (level < 0) return now + kRetryDelay;
+		now = m_TransmitLastQuery = PlayzerXTelemetry::Now();
+		m_Estimator.OnTelemetry(level, now, GetOutputQueue(), now);
+	}
+
+	// A held engine keeps the model current but sends nothing until SetStreamHold(false)
+	if (m_StreamHold.load(std::memory_order_acquire))
+		return now + (m_PumpMode ? kMaxSleep : 500000LL);
+
+	unsigned int outputQueue = GetOutputQueue();
+	double pending = m_Estimator.GetPendingLevel(outputQueue, now);
+	m_StreamSamplesRemaining.store((int)m_Estimator.GetDeviceLevel(outputQueue, now),
+								   std::memory_order_release);
+
+	// Steering lets the buffer run down to half the target, so that writes are not tiny
+	double watermark =
+		steering ? std::max(1.0, 0.5 * m_StreamTargetLevel) : (double)m_StreamTargetLevel;
+	if (pending >= watermark)
+	{
+		// Wait until the device has played out the samples above the watermark
+		long long deadline = m_Estimator.GetDeadline(watermark - 1.0, outputQueue, now);
+		return std::min(deadline, now + kMaxSleep);
+	}
+
+	unsigned int room = m_StreamTargetLevel - (unsigned int)pending, sent = 0, n;
+	if (steering)
+	{
+		// Copies of the newest target; targets posted in between have been dropped
+		n = std::min(room, kStreamBatchSamples);
+		unsigned int size = m_SteerMailbox.Read(&m_StreamBytes[0]);
+		for (unsigned int i = 1; i < n; i++)
+			std::copy(&m_StreamBytes[0], &m_StreamBytes[size], &m_StreamBytes[i * size]);
+		return WriteStream(&m_StreamBytes[0], n * size, n) ? now : now + kRetryDelay;
+	}
+
+	if (looping)
+	{
+		// Straight from the frame bytes, restarting at the frame boundary
+		while (room > sent && frame->numSamples > 0)
+		{
+			if (frameOffset == frame->numSamples)
+			{
+				frame = std::atomic_load(&m_LoopFrame);
+				frameOffset = 0;
+				if (!frame) break;
+				continue;
+			}
+			n = std::min(std::min(room - sent, frame->numSamples - frameOffset),
+						 kStreamBatchSamples);
+			unsigned int first = frameOffset;
+			frameOffset += n;
+			sent += n;
+			if (!WriteStream(&frame->bytes[first * frame->bytesPerSample],
+							 n * frame->bytesPerSample, n))
+				return now + kRetryDelay;
+		}
+		return now;
+	}
+
+	// One sample of each batch is left free for a repeat of ShiftStreamPhase()
+	while (room > sent &&
+		   (n = (unsigned int)m_StreamRing.Pop(
+				&m_StreamBatch[0], std::min(room - sent, kStreamBatchSamples - 1))) > 0)
+	{
+		int shift = m_StreamPhaseShift.load(std::memory_order_acquire);
+		if (shift > 0)
+		{
+			m_StreamBatch[n] = m_StreamBatch[n - 1];
+			n++;
+			m_StreamPhaseShift.fetch_sub(1);
+		}
+		else if (shift < 0 && n > 1)
+		{
+			n--;
+			m_StreamPhaseShift.fetch_add(1);
+		}
+		unsigned int count = EncodeSamples(&m_StreamBatch[0], n, &m_StreamBytes[0]);
+		sent += n;
+		// Queued bytes are part of the model, no need to wait for the transmission
+		if (!WriteStream(&m_StreamBytes[0], count, n)) return now + kRetryDelay;
+	}
+	return now;
+}
+
+bool PlayzerX::WriteStream(const unsigned char* bytes, unsigned int numBytes,
+						   unsigned int numSamples)
+{
+	if (!m_PumpMode) return WriteData(bytes, numBytes, numSamples) == 0;
+
+	// Counts as in progress until the last byte is out, see OnBufferLevel()
+	m_WritesStarted.fetch_add(1);
+	m_PumpSamples = numSamples;
+	m_PumpBatchBytes = numBytes;
+	m_PumpWritten = 0;
+	return WritePumped(bytes, numBytes, 0);
+}
+
+bool PlayzerX::WritePumped(const unsigned char* bytes, unsigned int numBytes, unsigned int timeout)
+{
+	long long start = PlayzerXTelemetry::Now();
+	unsigned long partialWrites = m_SerialDevice->GetPartialWrites();
+	unsigned int numWritten = 0;
+	long serialError =
+		m_SerialDevice->WriteQueued(const_cast<unsigned char*>(bytes) + m_PumpWritten,
+									numBytes - m_PumpWritten, &numWritten, timeout);
+	bool blocked = (timeout == 0 && serialError == MTI_ERR_SERIALCOMM_READ_TIMEOUT);
+	unsigned int written = m_PumpWritten + numWritten;
+
+	// Samples that are out count even if the write failed; every sample is a "pl" command with
+	// its length in the fourth byte
+	unsigned int numSamples = m_PumpSamples, sampleBytes = numBytes;
+	if (serialError != 0)
+	{
+		numSamples = sampleBytes = 0;
+		while (sampleBytes < written && sampleBytes + bytes[sampleBytes + 3] <= written)
+		{
+			sampleBytes += bytes[sampleBytes + 3];
+			numSamples++;
+		}
+	}
+	m_Counters.OnWrite(numWritten, blocked ? 0 : numSamples, PlayzerXTelemetry::Now() - start,
+					   m_SerialDevice->GetPartialWrites() - partialWrites,
+					   serialError != 0 && !blocked);
+	if (blocked)
+	{
+		// The rest goes out first on the next call
+		if (bytes != m_PumpBytes.data()) m_PumpBytes.assign(bytes, bytes + numBytes);
+		m_PumpWritten = written;
+		return false;
+	}
+
+	m_SampleSequence.fetch_add(numSamples);
+	if (numSamples > 0) OnDataWritten(numSamples, sampleBytes);
+	if (serialError == 0)
+	{
+		m_PumpBytes.clear();
+		m_PumpWritten = 0;
+		m_WritesFinished.fetch_add(1);
+		return true;
+	}
+
+	// Nothing is dropped: the rest stays pending, starting with the sample cut short if any, so
+	// that the device stays in step once the transport takes it again
+	if (bytes == m_PumpBytes.data())
+		m_PumpBytes.erase(m_PumpBytes.begin(), m_PumpBytes.begin() + sampleBytes);
+	else
+		m_PumpBytes.assign(bytes + sampleBytes, bytes + numBytes);
+	m_PumpWritten = written - sampleBytes;
+	m_PumpSamples -= numSamples;
+	m_PumpBatchBytes = numBytes - sampleBytes;
+	return false;
+}
+
 }  // namespace playzerx
\ No newline at end of file
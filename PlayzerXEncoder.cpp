@@ -0,0 +1,559 @@
+//////////////////////////////////////////////////////////////////////
+// PlayzerXEncoder.cpp
+// Version: 2.1.0.0
+//////////////////////////////////////////////////////////////////////
+
+#include "PlayzerXEncoder.h"
+
+#include <atomic>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PLAYZERX_ENCODER_X86
+#define PLAYZERX_TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define PLAYZERX_ENCODER_X86
+#define PLAYZERX_TARGET(isa)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace playzerx
+{
+namespace
+{
+// Command headers 'p' 'l' 'D'/'d' len as little endian words
+const unsigned int kHeaderXY = 0x08446C70;
+const unsigned int kHeaderXYM = 0x09646C70;
+const unsigned int kHeaderXYRGB = 0x0B646C70;
+
+// Quantizes a normalized coordinate to 12 bits. The clamping follows the semantics of the SIMD
+// max/min instructions (NaN yields the second operand) so that all kernels agree bit for bit.
+inline unsigned int Quantize(float v)
+{
+	float t = (v + 1.f) * 2047.5f;
+	t = (t > 0.f) ? t : 0.f;
+	t = (t < 4095.f) ? t : 4095.f;
+	return (unsigned int)t;
+}
+
+unsigned int ScalarXY(const float* x, const float* y, unsigned int numSamples,
+					  unsigned char* bytes)
+{
+	unsigned int xVal, yVal;
+	unsigned count = 0;
+	// 12 bit X, 12 bit Y
+	// BYTES as they arrive to controller: X[7:0] {X[11:8], Y[3:0]} Y[11:4]
+	for (unsigned int i = 0; i < numSamples; i++)
+	{
+		xVal = Quantize(x[i]);
+		yVal = Quantize(y[i]);
+		bytes[count++] = 'p';
+		bytes[count++] = 'l';
+		bytes[count++] = 'D';
+		bytes[count++] = kBytesPerSampleXY;
+		bytes[count++] = (xVal & 0x00FF);
+		bytes[count++] = (((xVal & 0x0F00) >> 4) + (yVal & 0x000F));
+		bytes[count++] = ((yVal & 0x0FF0) >> 4);
+		bytes[count++] = 10;  // including suffix here!
+	}
+	return count;
+}
+
+unsigned int ScalarXYM(const float* x, const float* y, const unsigned char* m,
+					   unsigned int numSamples, unsigned char* bytes)
+{
+	unsigned int xVal, yVal;
+	unsigned count = 0;
+	// 12 bit X, 12 bit Y, 8 bit M
+	// BYTES as they arrive to controller: X[7:0] {X[11:8], Y[3:0]} Y[11:4] M[7:0]
+	for (unsigned int i = 0; i < numSamples; i++)
+	{
+		xVal = Quantize(x[i]);
+		yVal = Quantize(y[i]);
+		bytes[count++] = 'p';
+		bytes[count++] = 'l';
+		bytes[count++] = 'd';
+		bytes[count++] = kBytesPerSampleXYM;
+		bytes[count++] = (xVal & 0x00FF);
+		bytes[count++] = (((xVal & 0x0F00) >> 4) + (yVal & 0x000F));
+		bytes[count++] = ((yVal & 0x0FF0) >> 4);
+		bytes[count++] = m[i];
+		bytes[count++] = 10;  // including suffix here!
+	}
+	return count;
+}
+
+unsigned int ScalarXYRGB(const float* x, const float* y, const unsigned char* r,
+						 const unsigned char* g, const unsigned char* b, unsigned int numSamples,
+						 unsigned char* bytes)
+{
+	unsigned int xVal, yVal;
+	unsigned count = 0;
+	// 12 bit X, 12 bit Y, 8 bit R, 8 bit G, 8 bit B
+	// BYTES as they arrive to controller: X[7:0] {X[11:8], Y[3:0]} Y[11:4] R[7:0] G[7:0] B[7:0]
+	for (unsigned int i = 0; i < numSamples; i++)
+	{
+		xVal = Quantize(x[i]);
+		yVal = Quantize(y[i]);
+		bytes[count++] = 'p';
+		bytes[count++] = 'l';
+		bytes[count++] = 'd';
+		bytes[count++] = kBytesPerSampleXYRGB;
+		bytes[count++] = (xVal & 0x00FF);
+		bytes[count++] = (((xVal & 0x0F00) >> 4) + (yVal & 0x000F));
+		bytes[count++] = ((yVal & 0x0FF0) >> 4);
+		bytes[count++] = r[i];
+		bytes[count++] = g[i];
+		bytes[count++] = b[i];
+		bytes[count++] = 10;  // Include suffix here!
+	}
+	return count;
+}
+
+#ifdef PLAYZERX_ENCODER_X86
+// The vector kernels compute, per sample, the little endian word
+//   X[7:0] | {X[11:8], Y[3:0]} << 8 | Y[11:4] << 16 | M or R << 24
+// and for XYRGB a second word G | B << 8 | '\n' << 16. The records are then assembled from the
+// header and these words with 32 bit unpacks. XYM and XYRGB records are 9 and 11 bytes long and
+// are written with overlapping 16 byte stores in ascending order: the bytes past the end of a
+// record are overwritten by the next one, and the last few samples are left to the scalar loop.
+
+PLAYZERX_TARGET("sse2") inline __m128i QuantizeSSE2(const float* v)
+{
+	__m128 t = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(v), _mm_set1_ps(1.f)), _mm_set1_ps(2047.5f));
+	t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(4095.f));
+	return _mm_cvttps_epi32(t);
+}
+
+PLAYZERX_TARGET("sse2") inline __m128i PackSSE2(__m128i x, __m128i y)
+{
+	__m128i lo = _mm_or_si128(_mm_and_si128(x, _mm_set1_epi32(0x00FF)),
+							  _mm_slli_epi32(_mm_and_si128(x, _mm_set1_epi32(0x0F00)), 4));
+	__m128i hi = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(y, _mm_set1_epi32(0x000F)), 8),
+							  _mm_slli_epi32(_mm_and_si128(y, _mm_set1_epi32(0x0FF0)), 12));
+	return _mm_or_si128(lo, hi);
+}
+
+// Zero extends 4 bytes to 32 bit lanes
+PLAYZERX_TARGET("sse2") inline __m128i LoadBytesSSE2(const unsigned char* v)
+{
+	int word;
+	memcpy(&word, v, sizeof(word));
+	__m128i zero = _mm_setzero_si128();
+	return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(word), zero), zero);
+}
+
+// Writes 4 records made of the header, a word of w and a word of q, at a stride of 9 or 11 bytes
+PLAYZERX_TARGET("sse2")
+inline void StoreRecordsSSE2(unsigned char* bytes, unsigned int stride, __m128i header, __m128i w,
+							 __m128i q)
+{
+	__m128i lo = _mm_unpacklo_epi32(w, q);
+	__m128i hi = _mm_unpackhi_epi32(w, q);
+	_mm_storeu_si128((__m128i*)(bytes), _mm_or_si128(_mm_slli_si128(lo, 4), header));
+	_mm_storeu_si128((__m128i*)(bytes + stride),
+					 _mm_or_si128(_mm_slli_si128(_mm_unpackhi_epi64(lo, lo), 4), header));
+	_mm_storeu_si128((__m128i*)(bytes + 2 * stride), _mm_or_si128(_mm_slli_si128(hi, 4), header));
+	_mm_storeu_si128((__m128i*)(bytes + 3 * stride),
+					 _mm_or_si128(_mm_slli_si128(_mm_unpackhi_epi64(hi, hi), 4), header));
+}
+
+PLAYZERX_TARGET("sse2")
+unsigned int SSE2XY(const float* x, const float* y, unsigned int numSamples, unsigned char* bytes)
+{
+	const __m128i header = _mm_set1_epi32((int)kHeaderXY);
+	const __m128i suffix = _mm_set1_epi32(10 << 24);
+	unsigned int i = 0;
+	for (; i + 4 <= numSamples; i += 4)
+	{
+		__m128i w = _mm_or_si128(PackSSE2(QuantizeSSE2(x + i), QuantizeSSE2(y + i)), suffix);
+		_mm_storeu_si128((__m128i*)(bytes + 8 * i), _mm_unpacklo_epi32(header, w));
+		_mm_storeu_si128((__m128i*)(bytes + 8 * i + 16), _mm_unpackhi_epi32(header, w));
+	}
+	return 8 * i + ScalarXY(x + i, y + i, numSamples - i, bytes + 8 * i);
+}
+
+PLAYZERX_TARGET("sse2")
+unsigned int SSE2XYM(const float* x, const float* y, const unsigned char* m,
+					 unsigned int numSamples, unsigned char* bytes)
+{
+	const __m128i header = _mm_cvtsi32_si128((int)kHeaderXYM);
+	const __m128i suffix = _mm_set1_epi32(10);
+	unsigned int i = 0;
+	for (; i + 5 <= numSamples; i += 4)
+	{
+		__m128i w = PackSSE2(QuantizeSSE2(x + i), QuantizeSSE2(y + i));
+		w = _mm_or_si128(w, _mm_slli_epi32(LoadBytesSSE2(m + i), 24));
+		StoreRecordsSSE2(bytes + 9 * i, 9, header, w, suffix);
+	}
+	return 9 * i + ScalarXYM(x + i, y + i, m + i, numSamples - i, bytes + 9 * i);
+}
+
+PLAYZERX_TARGET("sse2")
+unsigned int SSE2XYRGB(const float* x, const float* y, const unsigned char* r,
+					   const unsigned char* g, const unsigned char* b, unsigned int numSamples,
+					   unsigned char* bytes)
+{
+	const __m128i header = _mm_cvtsi32_si128((int)kHeaderXYRGB);
+	const __m128i suffix = _mm_set1_epi32(10 << 16);
+	unsigned int i = 0;
+	for (; i + 5 <= numSamples; i += 4)
+	{
+		__m128i w = PackSSE2(QuantizeSSE2(x + i), QuantizeSSE2(y + i));
+		w = _mm_or_si128(w, _mm_slli_epi32(LoadBytesSSE2(r + i), 24));
+		__m128i q = _mm_or_si128(LoadBytesSSE2(g + i), _mm_slli_epi32(LoadBytesSSE2(b + i), 8));
+		StoreRecordsSSE2(bytes + 11 * i, 11, header, w, _mm_or_si128(q, suffix));
+	}
+	return 11 * i + ScalarXYRGB(x + i, y + i, r + i, g + i, b + i, numSamples - i, bytes + 11 * i);
+}
+
+PLAYZERX_TARGET("avx2") inline __m256i QuantizeAVX2(const float* v)
+{
+	__m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(v), _mm256_set1_ps(1.f)),
+							 _mm256_set1_ps(2047.5f));
+	t = _mm256_min_ps(_mm256_max_ps(t, _mm256_setzero_ps()), _mm256_set1_ps(4095.f));
+	return _mm256_cvttps_epi32(t);
+}
+
+PLAYZERX_TARGET("avx2") inline __m256i PackAVX2(__m256i x, __m256i y)
+{
+	__m256i x0 = _mm256_and_si256(x, _mm256_set1_epi32(0x00FF));
+	__m256i x1 = _mm256_slli_epi32(_mm256_and_si256(x, _mm256_set1_epi32(0x0F00)), 4);
+	__m256i y0 = _mm256_slli_epi32(_mm256_and_si256(y, _mm256_set1_epi32(0x000F)), 8);
+	__m256i y1 = _mm256_slli_epi32(_mm256_and_si256(y, _mm256_set1_epi32(0x0FF0)), 12);
+	return _mm256_or_si256(_mm256_or_si256(x0, x1), _mm256_or_si256(y0, y1));
+}
+
+// Zero extends 8 bytes to 32 bit lanes
+PLAYZERX_TARGET("avx2") inline __m256i LoadBytesAVX2(const unsigned char* v)
+{
+	return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)v));
+}
+
+PLAYZERX_TARGET("avx2")
+inline void StoreRecordsAVX2(unsigned char* bytes, unsigned int stride, __m128i header, __m256i w,
+							 __m256i q)
+{
+	StoreRecordsSSE2(bytes, stride, header, _mm256_castsi256_si128(w), _mm256_castsi256_si128(q));
+	StoreRecordsSSE2(bytes + 4 * stride, stride, header, _mm256_extracti128_si256(w, 1),
+					 _mm256_extracti128_si256(q, 1));
+}
+
+PLAYZERX_TARGET("avx2")
+unsigned int AVX2XY(const float* x, const float* y, unsigned int numSamples, unsigned char* bytes)
+{
+	const __m256i header = _mm256_set1_epi32((int)kHeaderXY);
+	const __m256i suffix = _mm256_set1_epi32(10 << 24);
+	unsigned int i = 0;
+	for (; i + 8 <= numSamples; i += 8)
+	{
+		__m256i w = _mm256_or_si256(PackAVX2(QuantizeAVX2(x + i), QuantizeAVX2(y + i)), suffix);
+		// Unpacks work per 128 bit lane: lo holds samples 0, 1, 4, 5 and hi 2, 3, 6, 7
+		__m256i lo = _mm256_unpacklo_epi32(header, w);
+		__m256i hi = _mm256_unpackhi_epi32(header, w);
+		_mm256_storeu_si256((__m256i*)(bytes + 8 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i*)(bytes + 8 * i + 32),
+							_mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+	return 8 * i + SSE2XY(x + i, y + i, numSamples - i, bytes + 8 * i);
+}
+
+PLAYZERX_TARGET("avx2")
+unsigned int AVX2XYM(const float* x, const float* y, const unsigned char* m,
+					 unsigned int numSamples, unsigned char* bytes)
+{
+	const __m128i header = _mm_cvtsi32_si128((int)kHeaderXYM);
+	const __m256i suffix = _mm256_set1_epi32(10);
+	unsigned int i = 0;
+	for (; i + 9 <= numSamples; i += 8)
+	{
+		__m256i w = PackAVX2(QuantizeAVX2(x + i), QuantizeAVX2(y + i));
+		w = _mm256_or_si256(w, _mm256_slli_epi32(LoadBytesAVX2(m + i), 24));
+		StoreRecordsAVX2(bytes + 9 * i, 9, header, w, suffix);
+	}
+	return 9 * i + SSE2XYM(x + i, y + i, m + i, numSamples - i, bytes + 9 * i);
+}
+
+PLAYZERX_TARGET("avx2")
+unsigned int AVX2XYRGB(const float* x, const float* y, const unsigned char* r,
+					   const unsigned char* g, const unsigned char* b, unsigned int numSamples,
+					   unsigned char* bytes)
+{
+	const __m128i header = _mm_cvtsi32_si128((int)kHeaderXYRGB);
+	const __m256i suffix = _mm256_set1_epi32(10 << 16);
+	unsigned int i = 0;
+	for (; i + 9 <= numSamples; i += 8)
+	{
+		__m256i w = PackAVX2(QuantizeAVX2(x + i), QuantizeAVX2(y + i));
+		w = _mm256_or_si256(w, _mm256_slli_epi32(LoadBytesAVX2(r + i), 24));
+		__m256i q =
+			_mm256_or_si256(LoadBytesAVX2(g + i), _mm256_slli_epi32(LoadBytesAVX2(b + i), 8));
+		StoreRecordsAVX2(bytes + 11 * i, 11, header, w, _mm256_or_si256(q, suffix));
+	}
+	return 11 * i + SSE2XYRGB(x + i, y + i, r + i, g + i, b + i, numSamples - i, bytes + 11 * i);
+}
+
+PLAYZERX_TARGET("avx512f") inline __m512i QuantizeAVX512(const float* v)
+{
+	__m512 t = _mm512_mul_ps(_mm512_add_ps(_mm512_loadu_ps(v), _mm512_set1_ps(1.f)),
+							 _mm512_set1_ps(2047.5f));
+	t = _mm512_min_ps(_mm512_max_ps(t, _mm512_setzero_ps()), _mm512_set1_ps(4095.f));
+	return _mm512_cvttps_epi32(t);
+}
+
+PLAYZERX_TARGET("avx512f") inline __m512i PackAVX512(__m512i x, __m512i y)
+{
+	__m512i x0 = _mm512_and_si512(x, _mm512_set1_epi32(0x00FF));
+	__m512i x1 = _mm512_slli_epi32(_mm512_and_si512(x, _mm512_set1_epi32(0x0F00)), 4);
+	__m512i y0 = _mm512_slli_epi32(_mm512_and_si512(y, _mm512_set1_epi32(0x000F)), 8);
+	__m512i y1 = _mm512_slli_epi32(_mm512_and_si512(y, _mm512_set1_epi32(0x0FF0)), 12);
+	return _mm512_or_si512(_mm512_or_si512(x0, x1), _mm512_or_si512(y0, y1));
+}
+
+// Zero extends 16 bytes to 32 bit lanes
+PLAYZERX_TARGET("avx512f") inline __m512i LoadBytesAVX512(const unsigned char* v)
+{
+	return _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)v));
+}
+
+PLAYZERX_TARGET("avx512f")
+inline void StoreRecordsAVX512(unsigned char* bytes, unsigned int stride, __m128i header,
+							   __m512i w, __m512i q)
+{
+	StoreRecordsSSE2(bytes, stride, header, _mm512_castsi512_si128(w), _mm512_castsi512_si128(q));
+	StoreRecordsSSE2(bytes + 4 * stride, stride, header, _mm512_extracti32x4_epi32(w, 1),
+					 _mm512_extracti32x4_epi32(q, 1));
+	StoreRecordsSSE2(bytes + 8 * stride, stride, header, _mm512_extracti32x4_epi32(w, 2),
+					 _mm512_extracti32x4_epi32(q, 2));
+	StoreRecordsSSE2(bytes + 12 * stride, stride, header, _mm512_extracti32x4_epi32(w, 3),
+					 _mm512_extracti32x4_epi32(q, 3));
+}
+
+PLAYZERX_TARGET("avx512f")
+unsigned int AVX512XY(const float* x, const float* y, unsigned int numSamples,
+					  unsigned char* bytes)
+{
+	const __m512i header = _mm512_set1_epi32((int)kHeaderXY);
+	const __m512i suffix = _mm512_set1_epi32(10 << 24);
+	// 64 bit records of lo (samples 0, 1, 4, 5, ...) and hi (2, 3, 6, 7, ...) in output order
+	const __m512i first = _mm512_set_epi64(11, 10, 3, 2, 9, 8, 1, 0);
+	const __m512i second = _mm512_set_epi64(15, 14, 7, 6, 13, 12, 5, 4);
+	unsigned int i = 0;
+	for (; i + 16 <= numSamples; i += 16)
+	{
+		__m512i w =
+			_mm512_or_si512(PackAVX512(QuantizeAVX512(x + i), QuantizeAVX512(y + i)), suffix);
+		__m512i lo = _mm512_unpacklo_epi32(header, w);
+		__m512i hi = _mm512_unpackhi_epi32(header, w);
+		_mm512_storeu_si512(bytes + 8 * i, _mm512_permutex2var_epi64(lo, first, hi));
+		_mm512_storeu_si512(bytes + 8 * i + 64, _mm512_permutex2var_epi64(lo, second, hi));
+	}
+	return 8 * i + SSE2XY(x + i, y + i, numSamples - i, bytes + 8 * i);
+}
+
+PLAYZERX_TARGET("avx512f")
+unsigned int AVX512XYM(const float* x, const float* y, const unsigned char* m,
+					   unsigned int numSamples, unsigned char* bytes)
+{
+	const __m128i header = _mm_cvtsi32_si128((int)kHeaderXYM);
+	const __m512i suffix = _mm512_set1_epi32(10);
+	unsigned int i = 0;
+	for (; i + 17 <= numSamples; i += 16)
+	{
+		__m512i w = PackAVX512(QuantizeAVX512(x + i), QuantizeAVX512(y + i));
+		w = _mm512_or_si512(w, _mm512_slli_epi32(LoadBytesAVX512(m + i), 24));
+		StoreRecordsAVX512(bytes + 9 * i, 9, header, w, suffix);
+	}
+	return 9 * i + SSE2XYM(x + i, y + i, m + i, numSamples - i, bytes + 9 * i);
+}
+
+PLAYZERX_TARGET("avx512f")
+unsigned int AVX512XYRGB(const float* x, const float* y, const unsigned char* r,
+						 const unsigned char* g, const unsigned char* b, unsigned int numSamples,
+						 unsigned char* bytes)
+{
+	const __m128i header = _mm_cvtsi32_si128((int)kHeaderXYRGB);
+	const __m512i suffix = _mm512_set1_epi32(10 << 16);
+	unsigned int i = 0;
+	for (; i + 17 <= numSamples; i += 16)
+	{
+		__m512i w = PackAVX512(QuantizeAVX512(x + i), QuantizeAVX512(y + i));
+		w = _mm512_or_si512(w, _mm512_slli_epi32(LoadBytesAVX512(r + i), 24));
+		__m512i q =
+			_mm512_or_si512(LoadBytesAVX512(g + i), _mm512_slli_epi32(LoadBytesAVX512(b + i), 8));
+		StoreRecordsAVX512(bytes + 11 * i, 11, header, w, _mm512_or_si512(q, suffix));
+	}
+	return 11 * i + SSE2XYRGB(x + i, y + i, r + i, g + i, b + i, numSamples - i, bytes + 11 * i);
+}
+#endif  // PLAYZERX_ENCODER_X86
+
+struct EncoderKernels
+{
+	unsigned int (*xy)(const float*, const float*, unsigned int, unsigned char*);
+	unsigned int (*xym)(const float*, const float*, const unsigned char*, unsigned int,
+						unsigned char*);
+	unsigned int (*xyrgb)(const float*, const float*, const unsigned char*, const unsigned char*,
+						  const unsigned char*, unsigned int, unsigned char*);
+};
+
+// Indexed by PlayzerXEncoderKernel
+const EncoderKernels kEncoderKernels[] = {
+	{ScalarXY, ScalarXYM, ScalarXYRGB},
+#ifdef PLAYZERX_ENCODER_X86
+	{SSE2XY, SSE2XYM, SSE2XYRGB},
+	{AVX2XY, AVX2XYM, AVX2XYRGB},
+	{AVX512XY, AVX512XYM, AVX512XYRGB},
+#endif
+};
+
+// Selected kernel, -1 until the first use
+std::atomic<int> g_EncoderKernel(-1);
+
+const EncoderKernels& GetKernels()
+{
+	int kernel = g_EncoderKernel.load(std::memory_order_acquire);
+	if (kernel < 0)
+	{
+		PlayzerXEncoderKernel best = PlayzerXEncoderKernel::SCALAR;
+		if (IsEncoderKernelSupported(PlayzerXEncoderKernel::AVX512))
+			best = PlayzerXEncoderKernel::AVX512;
+		else if (IsEncoderKernelSupported(PlayzerXEncoderKernel::AVX2))
+			best = PlayzerXEncoderKernel::AVX2;
+		else if (IsEncoderKernelSupported(PlayzerXEncoderKernel::SSE2))
+			best = PlayzerXEncoderKernel::SSE2;
+		// A concurrent first use detects the same kernel, unless one was forced meanwhile
+		int expected = -1;
+		g_EncoderKernel.compare_exchange_strong(expected, (int)best);
+		kernel = g_EncoderKernel.load(std::memory_order_acquire);
+	}
+	return kEncoderKernels[kernel];
+}
+
+}  // namespace
+
+bool IsEncoderKernelSupported(PlayzerXEncoderKernel kernel)
+{
+	if (kernel == PlayzerXEncoderKernel::SCALAR) return true;
+#if defined(PLAYZERX_ENCODER_X86) && defined(__GNUC__)
+	// Also checks that the operating system saves the AVX registers
+	__builtin_cpu_init();
+	switch (kernel)
+	{
+	case PlayzerXEncoderKernel::SSE2: return __builtin_cpu_supports("sse2") != 0;
+	case PlayzerXEncoderKernel::AVX2: return __builtin_cpu_supports("avx2") != 0;
+	case PlayzerXEncoderKernel::AVX512: return __builtin_cpu_supports("avx512f") != 0;
+	default: return false;
+	}
+#elif defined(PLAYZERX_ENCODER_X86)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	bool sse2 = (info[3] & (1 << 26)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+	bool avx2 = false, avx512 = false;
+	if (maxLeaf >= 7)
+	{
+		__cpuidex(info, 7, 0);
+		avx2 = avx && (xcr0 & 0x06) == 0x06 && (info[1] & (1 << 5)) != 0;
+		avx512 = avx2 && (xcr0 & 0xE6) == 0xE6 && (info[1] & (1 << 16)) != 0;
+	}
+	switch (kernel)
+	{
+	case PlayzerXEncoderKernel::SSE2: return sse2;
+	case PlayzerXEncoderKernel::AVX2: return avx2;
+	case PlayzerXEncoderKernel::AVX512: return avx512;
+	default: return false;
+	}
+#else
+	return false;
+#endif
+}
+
+PlayzerXEncoderKernel GetEncoderKernel()
+{
+	return (PlayzerXEncoderKernel)(&GetKernels() - kEncoderKernels);
+}
+
+bool SetEncoderKernel(PlayzerXEncoderKernel kernel)
+{
+	if (!IsEncoderKernelSupported(kernel)) return false;
+	g_EncoderKernel.store((int)kernel, std::memory_order_release);
+	return true;
+}
+
+unsigned int EncodeDataXY(const float* x, const float* y, unsigned int numSamples,
+						  unsigned char* bytes)
+{
+	return GetKernels().xy(x, y, numSamples, bytes);
+}
+
+unsigned int EncodeDataXYM(const float* x, const float* y, const unsigned char* m,
+						   unsigned int numSamples, unsigned char* bytes)
+{
+	return GetKernels().xym(x, y, m, numSamples, bytes);
+}
+
+unsigned int EncodeDataXYRGB(const float* x, const float* y, const unsigned char* r,
+							 const unsigned char* g, const unsigned char* b,
+							 unsigned int numSamples, unsigned char* bytes)
+{
+	return GetKernels().xyrgb(x, y, r, g, b, numSamples, bytes);
+}
+
+EncodedFrame::EncodedFrame()
+{
+	m_Format = PlayzerXDataFormat::XYM;
+	m_NumSamples = 0;
+}
+
+EncodedFrame::EncodedFrame(const float* x, const float* y, unsigned int numSamples)
+{
+	SetDataXY(x, y, numSamples);
+}
+
+EncodedFrame::EncodedFrame(const float* x, const float* y, const unsigned char* m,
+						   unsigned int numSamples)
+{
+	SetDataXYM(x, y, m, numSamples);
+}
+
+EncodedFrame::EncodedFrame(const float* x, const float* y, const unsigned char* r,
+						   const unsigned char* g, const unsigned char* b, unsigned int numSamples)
+{
+	SetDataXYRGB(x, y, r, g, b, numSamples);
+}
+
+unsigned char* EncodedFrame::Allocate(PlayzerXDataFormat format, unsigned int numSamples)
+{
+	m_Format = format;
+	m_NumSamples = numSamples;
+	m_Bytes.resize((size_t)numSamples * playzerx::GetBytesPerSample(format));
+	return m_Bytes.empty() ? nullptr : &m_Bytes[0];
+}
+
+void EncodedFrame::SetDataXY(const float* x, const float* y, unsigned int numSamples)
+{
+	EncodeDataXY(x, y, numSamples, Allocate(PlayzerXDataFormat::XY, numSamples));
+}
+
+void EncodedFrame::SetDataXYM(const float* x, const float* y, const unsigned char* m,
+							  unsigned int numSamples)
+{
+	EncodeDataXYM(x, y, m, numSamples, Allocate(PlayzerXDataFormat::XYM, numSamples));
+}
+
+void EncodedFrame::SetDataXYRGB(const float* x, const float* y, const unsigned char* r,
+								const unsigned char* g, const unsigned char* b,
+								unsigned int numSamples)
+{
+	EncodeDataXYRGB(x, y, r, g, b, numSamples, Allocate(PlayzerXDataFormat::XYRGB, numSamples));
+}
+
+void EncodedFrame::Clear() { Allocate(m_Format, 0); }
+
+}  // namespace playzerx
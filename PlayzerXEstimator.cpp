@@ -0,0 +1,262 @@
+//////////////////////////////////////////////////////////////////////
+// PlayzerXEstimator.cpp
+// Version: 2.1.0.0
+//////////////////////////////////////////////////////////////////////
+
+#include "PlayzerXEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace playzerx
+{
+void PlayzerXDriftEstimator::Reset()
+{
+	m_Segment = false;
+	m_Settled = false;
+	m_Origin = -1;
+	m_IntervalStart = 0;
+	m_Interval.clear();
+	m_LastTime = 0;
+	m_Weight = 0;
+	m_MeanTime = 0;
+	m_MeanPlayed = 0;
+	m_Covariance = 0;
+	m_Variance = 0;
+	m_Duration = 0;
+}
+
+void PlayzerXDriftEstimator::Break()
+{
+	Flush();
+	m_Segment = false;
+	m_Settled = false;
+}
+
+void PlayzerXDriftEstimator::OnReading(double played, double sampleRate, long long timestamp)
+{
+	// Seconds since the first reading against seconds of nominal playback, so that segments
+	// at different sample rates share the slope
+	if (m_Origin < 0) m_Origin = timestamp;
+	double time = 1e-9 * (double)(timestamp - m_Origin);
+	double position = played / sampleRate;
+
+	if (!m_Interval.empty() && time - m_IntervalStart >= kInterval) Flush();
+	if (m_Interval.empty()) m_IntervalStart = time;
+	m_Interval.push_back(std::make_pair(position - time, time));
+}
+
+void PlayzerXDriftEstimator::Flush()
+{
+	if (m_Interval.empty()) return;
+
+	// Rank the readings against the nominal rate; over one interval the drift barely matters
+	size_t rank = m_Interval.size() / 10;
+	std::nth_element(m_Interval.begin(), m_Interval.begin() + rank, m_Interval.end());
+	double time = m_Interval[rank].second;
+	double position = m_Interval[rank].first + time;
+	m_Interval.clear();
+
+	// Host and device buffers are still filling during the first interval of a segment
+	if (!m_Settled)
+	{
+		m_Settled = true;
+		return;
+	}
+
+	double decay = std::exp(-std::max(0.0, time - m_LastTime) / kTimeConstant);
+	m_Covariance *= decay;
+	m_Variance *= decay;
+	m_Duration *= decay;
+	if (!m_Segment)
+	{
+		m_Segment = true;
+		m_LastTime = time;
+		m_Weight = 1;
+		m_MeanTime = time;
+		m_MeanPlayed = position;
+		return;
+	}
+	m_Duration += std::max(0.0, time - m_LastTime);
+	m_LastTime = time;
+
+	// Exponentially weighted Welford update around the segment means
+	m_Weight = m_Weight * decay + 1;
+	double deltaTime = time - m_MeanTime;
+	m_MeanTime += deltaTime / m_Weight;
+	m_MeanPlayed += (position - m_MeanPlayed) / m_Weight;
+	m_Covariance += deltaTime * (position - m_MeanPlayed);
+	m_Variance += deltaTime * (time - m_MeanTime);
+}
+
+double PlayzerXDriftEstimator::GetPpm() const
+{
+	if (!IsValid() || m_Variance <= 0) return 0;
+	double ppm = 1e6 * (m_Covariance / m_Variance - 1);
+	return std::min(std::max(ppm, -kMaxPpm), kMaxPpm);
+}
+
+PlayzerXFifoEstimator::PlayzerXFifoEstimator()
+{
+	m_SampleRate = 10000;
+	m_BytesPerSample = 9;
+	Reset();
+}
+
+void PlayzerXFifoEstimator::Reset()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Valid = false;
+	m_AnchorTime = 0;
+	m_AnchorLevel = 0;
+	m_AnchorQueue = 0;
+	m_Drift.Reset();
+}
+
+void PlayzerXFifoEstimator::SetSampleRate(double sampleRate)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (sampleRate <= 0 || sampleRate == m_SampleRate) return;
+	m_SampleRate = sampleRate;
+	m_Drift.Break();
+}
+
+double PlayzerXFifoEstimator::GetSampleRate() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return GetDrainRate();
+}
+
+void PlayzerXFifoEstimator::OnDriftReading(int level, long long timestamp,
+										   unsigned long long written, unsigned int outputQueue)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	// The device stopped playing for an unknown time when its buffer ran empty
+	if (level <= 0)
+	{
+		m_Drift.Break();
+		return;
+	}
+	double played = (double)written - outputQueue / m_BytesPerSample - level;
+	m_Drift.OnReading(played, m_SampleRate, timestamp);
+}
+
+double PlayzerXFifoEstimator::GetDriftPpm() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Drift.GetPpm();
+}
+
+bool PlayzerXFifoEstimator::IsValid() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Valid;
+}
+
+double PlayzerXFifoEstimator::Advance(unsigned int outputQueue, long long now) const
+{
+	// Samples that left the kernel since the anchor have reached the controller FIFO
+	double queue = outputQueue / m_BytesPerSample;
+	double arrived = std::max(0.0, m_AnchorQueue - queue);
+	double drained = GetDrainRate() * 1e-9 * (double)std::max(0LL, now - m_AnchorTime);
+	return std::max(0.0, m_AnchorLevel + arrived - drained);
+}
+
+void PlayzerXFifoEstimator::Anchor(double deviceLevel, unsigned int outputQueue, long long now)
+{
+	m_AnchorLevel = deviceLevel;
+	m_AnchorQueue = outputQueue / m_BytesPerSample;
+	m_AnchorTime = now;
+}
+
+void PlayzerXFifoEstimator::OnWrite(unsigned int numSamples, unsigned int numBytes,
+									unsigned int outputQueue, long long now)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (numSamples == 0) return;
+
+	// Whatever of the new samples is no longer queued in the kernel already arrived
+	double queueBefore = m_AnchorQueue + numSamples;
+	m_BytesPerSample = (double)numBytes / numSamples;
+	double queue = outputQueue / m_BytesPerSample;
+	double arrived = std::max(0.0, queueBefore - queue);
+	double level = arrived;
+	if (m_Valid)
+	{
+		double drained = GetDrainRate() * 1e-9 * (double)std::max(0LL, now - m_AnchorTime);
+		level += std::max(0.0, m_AnchorLevel - drained);
+	}
+
+	Anchor(level, outputQueue, now);
+}
+
+void PlayzerXFifoEstimator::OnClear(unsigned int outputQueue, long long now)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Anchor(0, outputQueue, now);
+	m_AnchorQueue = 0;  // Anything still queued is flushed by the clear command itself
+	m_Drift.Break();
+	m_Valid = true;
+}
+
+void PlayzerXFifoEstimator::OnTelemetry(int level, long long timestamp, unsigned int outputQueue,
+										long long now)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (level < 0) return;
+
+	// Age the observation to now; it cannot account for samples that arrived since
+	double observed =
+		std::max(0.0, level - GetDrainRate() * 1e-9 * (double)std::max(0LL, now - timestamp));
+	double predicted = m_Valid ? Advance(outputQueue, now) : observed;
+	double corrected = predicted + (m_Valid ? kCorrectionGain : 1.0) * (observed - predicted);
+
+	Anchor(corrected, outputQueue, now);
+	m_Valid = true;
+}
+
+double PlayzerXFifoEstimator::GetDeviceLevel(unsigned int outputQueue, long long now) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return Advance(outputQueue, now);
+}
+
+double PlayzerXFifoEstimator::GetPendingLevel(unsigned int outputQueue, long long now) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return Advance(outputQueue, now) + outputQueue / m_BytesPerSample;
+}
+
+long long PlayzerXFifoEstimator::GetDeadline(double level, unsigned int outputQueue,
+											 long long now) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	double pending = Advance(outputQueue, now) + outputQueue / m_BytesPerSample;
+	if (pending <= level) return now;
+
+	// While the FIFO is not empty, the pending level falls at exactly the sample rate
+	return now + (long long)(1e9 * (pending - level) / GetDrainRate());
+}
+
+long long PlayzerXFifoEstimator::GetEmissionTime(double index, double byteRate,
+												 unsigned int outputQueue, long long now) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	double deviceLevel = Advance(outputQueue, now);
+	double samplePeriod = 1e9 / GetDrainRate();
+	double emission = index * samplePeriod;
+
+	if (index >= deviceLevel && byteRate > 0)
+	{
+		// Either the samples play without interruption, or the device waits for the first
+		// queued sample and then plays on, or the link is slower and it waits for this one
+		double linkPeriod = 1e9 * m_BytesPerSample / byteRate;
+		double queued = index - deviceLevel;
+		emission = std::max(emission, std::max(linkPeriod + queued * samplePeriod,
+											   (queued + 1) * linkPeriod));
+	}
+	return now + (long long)emission;
+}
+
+}  // namespace playzerx
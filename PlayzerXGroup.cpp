@@ -0,0 +1,279 @@
+//////////////////////////////////////////////////////////////////////
+// PlayzerXGroup.cpp
+// Version: 2.1.0.0
+//////////////////////////////////////////////////////////////////////
+
+#include "PlayzerXGroup.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef MTI_UNIX
+#include <poll.h>
+#include <time.h>
+#endif
+
+namespace playzerx
+{
+PlayzerXGroup::PlayzerXGroup()
+{
+	m_TargetLevel = 0;
+	m_ReleaseLevel = 0;
+	m_SteadyComparisons = 0;
+	m_Running = false;
+	m_Released = false;
+	m_Correcting = true;
+	m_LastError = PlayzerXError::SUCCESS;
+}
+
+PlayzerXGroup::~PlayzerXGroup() { Stop(); }
+
+bool PlayzerXGroup::AddDevice(PlayzerX* device)
+{
+	if (IsRunning())
+	{
+		m_LastError = PlayzerXError::ERROR_PLAYZERX_RUNNING_STATE;
+		return false;
+	}
+	if (device == nullptr ||
+		std::find(m_Devices.begin(), m_Devices.end(), device) != m_Devices.end())
+	{
+		m_LastError = PlayzerXError::ERROR_INVALID_PARAM;
+		return false;
+	}
+	m_Devices.push_back(device);
+	m_LastError = PlayzerXError::SUCCESS;
+	return true;
+}
+
+PlayzerX* PlayzerXGroup::GetDevice(unsigned int index)
+{
+	return (index < m_Devices.size()) ? m_Devices[index] : nullptr;
+}
+
+bool PlayzerXGroup::Start(unsigned int targetBufferLevel, unsigned int ringCapacity)
+{
+	if (IsRunning())
+	{
+		m_LastError = PlayzerXError::ERROR_PLAYZERX_RUNNING_STATE;
+		return false;
+	}
+	if (m_Devices.empty() || ringCapacity == 0)
+	{
+		m_LastError = PlayzerXError::ERROR_INVALID_PARAM;
+		return false;
+	}
+	for (PlayzerX* device : m_Devices)
+	{
+		if (!device->IsDeviceConnected())
+		{
+			m_LastError = PlayzerXError::ERROR_CONNECTION;
+			StopDevices();
+			return false;
+		}
+		if (!device->SetPumpMode(true))
+		{
+			m_LastError = device->GetLastError();
+			StopDevices();
+			return false;
+		}
+	}
+
+	// Empty buffers everywhere, then engines that wait for the release by the I/O thread
+	for (PlayzerX* device : m_Devices)
+	{
+		device->ClearData();
+		if (device->HasError())
+		{
+			m_LastError = device->GetLastError();
+			StopDevices();
+			return false;
+		}
+	}
+	for (PlayzerX* device : m_Devices)
+	{
+		device->SetStreamHold(true);
+		if (!device->StartStreaming(targetBufferLevel, ringCapacity))
+		{
+			m_LastError = device->GetLastError();
+			StopDevices();
+			return false;
+		}
+	}
+
+	m_PhaseErrors.assign(m_Devices.size(), 0.0);
+	m_PhaseCorrections.assign(m_Devices.size(), 0);
+	m_HungUp.assign(m_Devices.size(), 0);
+	m_TargetLevel = targetBufferLevel;
+	m_ReleaseLevel = std::max(std::min(targetBufferLevel, ringCapacity), 1u);
+	m_SteadyComparisons = 0;
+	m_Released = false;
+	m_Running.store(true, std::memory_order_release);
+	m_Thread = std::thread(&PlayzerXGroup::IoThread, this);
+	m_LastError = PlayzerXError::SUCCESS;
+	return true;
+}
+
+void PlayzerXGroup::Stop()
+{
+	if (!IsRunning()) return;
+
+	m_Running.store(false, std::memory_order_release);
+	if (m_Thread.joinable()) m_Thread.join();
+	StopDevices();
+	m_Released = false;
+}
+
+void PlayzerXGroup::StopDevices()
+{
+	for (PlayzerX* device : m_Devices)
+	{
+		device->StopStreaming();
+		device->SetStreamHold(false);
+		device->SetPumpMode(false);
+	}
+}
+
+double PlayzerXGroup::GetPhaseError(unsigned int index)
+{
+	std::lock_guard<std::mutex> lock(m_PhaseMutex);
+	return (index < m_PhaseErrors.size()) ? m_PhaseErrors[index] : 0.0;
+}
+
+long long PlayzerXGroup::GetPhaseCorrection(unsigned int index)
+{
+	std::lock_guard<std::mutex> lock(m_PhaseMutex);
+	return (index < m_PhaseCorrections.size()) ? m_PhaseCorrections[index] : 0;
+}
+
+void PlayzerXGroup::IoThread()
+{
+	long long nextComparison = 0;
+	while (m_Running.load(std::memory_order_acquire))
+	{
+		if (!IsReleased() && TryRelease())
+			nextComparison = PlayzerXTelemetry::Now() + kPhasePeriod;
+
+		// Until the release the queues are checked often, the engines have nothing to do
+		long long now = PlayzerXTelemetry::Now();
+		long long wakeUp = now + (IsReleased() ? kMaxWait : kReleaseCheck);
+		for (PlayzerX* device : m_Devices)
+		{
+			long long deviceWakeUp = device->Pump();
+			if (deviceWakeUp >= 0) wakeUp = std::min(wakeUp, deviceWakeUp);
+		}
+
+		if (IsReleased())
+		{
+			now = PlayzerXTelemetry::Now();
+			if (now >= nextComparison)
+			{
+				CorrectPhase();
+				nextComparison = now + kPhasePeriod;
+			}
+			wakeUp = std::min(wakeUp, nextComparison);
+		}
+		Wait(wakeUp);
+	}
+}
+
+bool PlayzerXGroup::TryRelease()
+{
+	for (PlayzerX* device : m_Devices)
+	{
+		device->Pump();
+		if (device->GetEstimatedSamplesRemaining() < 0 ||
+			device->GetStreamQueuedSamples() < m_ReleaseLevel)
+			return false;
+	}
+
+	// The first writes of all devices leave right after each other, each in as few calls as
+	// the transport allows; the devices start playing when their first sample arrives
+	for (PlayzerX* device : m_Devices) device->SetStreamHold(false);
+	for (PlayzerX* device : m_Devices) device->Pump();
+	m_Released.store(true, std::memory_order_release);
+	return true;
+}
+
+void PlayzerXGroup::CorrectPhase()
+{
+	// A batch half written is missing from the positions, and the buffer models take about a
+	// second to settle once the wire was busy, e.g. while the buffers fill after the release
+	for (PlayzerX* device : m_Devices)
+	{
+		if (device->HasPendingWrite() ||
+			device->GetSamplesRemaining() < (int)(m_TargetLevel - m_TargetLevel / 10))
+		{
+			m_SteadyComparisons = 0;
+			return;
+		}
+	}
+	if (++m_SteadyComparisons < kSettleComparisons) return;
+
+	std::vector<double> phases(m_Devices.size());
+	double mean = 0.0;
+	for (size_t i = 0; i < m_Devices.size(); i++)
+	{
+		phases[i] = m_Devices[i]->GetStreamPhase();
+		if (phases[i] < 0) return;
+		mean += phases[i] / m_Devices.size();
+	}
+
+	bool correcting = m_Correcting.load();
+	std::lock_guard<std::mutex> lock(m_PhaseMutex);
+	for (size_t i = 0; i < m_Devices.size(); i++)
+	{
+		double& error = m_PhaseErrors[i];
+		error += kPhaseSmoothing * ((phases[i] - mean) - error);
+		if (!correcting || std::fabs(error) <= kPhaseTolerance) continue;
+
+		// Devices ahead repeat samples, those behind drop some; the position moves at once
+		int shift = (int)std::lround(error);
+		shift = std::max(-kMaxPhaseStep, std::min(kMaxPhaseStep, shift));
+		m_Devices[i]->ShiftStreamPhase(shift);
+		m_PhaseCorrections[i] += shift;
+		error -= shift;
+	}
+}
+
+void PlayzerXGroup::Wait(long long wakeUp)
+{
+	long long now = PlayzerXTelemetry::Now();
+	if (wakeUp <= now) return;
+
+#ifdef MTI_UNIX
+	// Level updates and room for pending writes wake the thread early. A closed connection stays
+	// readable, so a device that hung up is left to the timed wake-ups from then on.
+	std::vector<struct pollfd> fds;
+	std::vector<size_t> indices;
+	for (size_t i = 0; i < m_Devices.size(); i++)
+	{
+		int fd = m_Devices[i]->GetFileDescriptor();
+		if (fd < 0 || m_HungUp[i]) continue;
+		short events = POLLIN | (m_Devices[i]->HasPendingWrite() ? POLLOUT : 0);
+#ifdef POLLRDHUP
+		events |= POLLRDHUP;
+#endif
+		struct pollfd pfd = {fd, events, 0};
+		fds.push_back(pfd);
+		indices.push_back(i);
+	}
+	if (!fds.empty())
+	{
+		long long wait = wakeUp - now;
+		struct timespec timeout = {(time_t)(wait / 1000000000LL), (long)(wait % 1000000000LL)};
+		if (ppoll(&fds[0], fds.size(), &timeout, nullptr) <= 0) return;
+
+		short hangUp = POLLERR | POLLHUP | POLLNVAL;
+#ifdef POLLRDHUP
+		hangUp |= POLLRDHUP;
+#endif
+		for (size_t j = 0; j < fds.size(); j++)
+			if (fds[j].revents & hangUp) m_HungUp[indices[j]] = 1;
+		return;
+	}
+#endif
+	PlayzerXTelemetry::SleepUntil(wakeUp);
+}
+
+}  // namespace playzerx
@@ -0,0 +1,132 @@
+//////////////////////////////////////////////////////////////////////
+// PlayzerXPorts.cpp
+// Version: 2.1.0.0
+//////////////////////////////////////////////////////////////////////
+
+#include "PlayzerXPorts.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+
+#ifdef MTI_UNIX
+#include <dirent.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace playzerx
+{
+#ifdef MTI_UNIX
+namespace
+{
+/** \brief Reads the first line of a sysfs attribute, empty if it does not exist. */
+std::string ReadAttribute(const std::string& path)
+{
+	std::ifstream file(path.c_str());
+	std::string value;
+	if (file) std::getline(file, value);
+	return value;
+}
+
+/** \brief Resolves symbolic links, empty if \p path does not exist. */
+std::string ResolvePath(const std::string& path)
+{
+	char resolved[PATH_MAX];
+	if (realpath(path.c_str(), resolved) == nullptr) return std::string();
+	return std::string(resolved);
+}
+
+bool FileExists(const std::string& path)
+{
+	struct stat st;
+	return stat(path.c_str(), &st) == 0;
+}
+
+/** \brief Reads the sysfs attributes of one tty, \c false if it has no hardware behind it. */
+bool ReadPortInfo(const std::string& sysfsRoot, const std::string& classDir,
+				  const std::string& name, PlayzerXPortInfo& port)
+{
+	// Virtual terminals and pseudo terminals have no device link
+	std::string device = ResolvePath(classDir + "/" + name + "/device");
+	if (device.empty()) return false;
+
+	port.PortName = name;
+	port.IsUSB = false;
+	port.VendorId = 0;
+	port.ProductId = 0;
+
+	std::string driver = ResolvePath(device + "/driver");
+	port.Driver = driver.substr(driver.find_last_of('/') + 1);
+
+	// Legacy UARTs are listed even when no hardware is present, they report port type 0
+	if (ReadAttribute(classDir + "/" + name + "/type") == "0") return false;
+
+	// The USB device is the first ancestor with a vendor ID: the interface of cdc_acm ports or
+	// the usb-serial port of ftdi_sio, cp210x, ... sit below it
+	std::string root = ResolvePath(sysfsRoot);
+	std::string dir = device;
+	for (; dir.size() > root.size() && dir.compare(0, root.size(), root) == 0;
+		 dir.erase(dir.find_last_of('/')))
+	{
+		if (!FileExists(dir + "/idVendor")) continue;
+		port.IsUSB = true;
+		port.VendorId = (unsigned short)strtoul(ReadAttribute(dir + "/idVendor").c_str(), 0, 16);
+		port.ProductId = (unsigned short)strtoul(ReadAttribute(dir + "/idProduct").c_str(), 0, 16);
+		port.SerialNumber = ReadAttribute(dir + "/serial");
+		port.Manufacturer = ReadAttribute(dir + "/manufacturer");
+		port.Product = ReadAttribute(dir + "/product");
+		break;
+	}
+	return true;
+}
+}  // namespace
+#endif
+
+bool EnumerateSerialPorts(std::vector<PlayzerXPortInfo>& ports, const std::string& sysfsRoot,
+						  const std::string& devRoot)
+{
+	ports.clear();
+#ifdef MTI_UNIX
+	std::string classDir = sysfsRoot + "/class/tty";
+	DIR* dir = opendir(classDir.c_str());
+	if (dir == nullptr) return false;
+
+	for (struct dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+	{
+		if (entry->d_name[0] == '.') continue;
+		PlayzerXPortInfo port;
+		if (!ReadPortInfo(sysfsRoot, classDir, entry->d_name, port)) continue;
+		port.DevicePath = devRoot + "/" + port.PortName;
+		ports.push_back(port);
+	}
+	closedir(dir);
+
+	// Shorter names first so that ttyUSB2 comes before ttyUSB10
+	std::sort(ports.begin(), ports.end(),
+			  [](const PlayzerXPortInfo& a, const PlayzerXPortInfo& b)
+			  {
+				  if (a.PortName.size() != b.PortName.size())
+					  return a.PortName.size() < b.PortName.size();
+				  return a.PortName < b.PortName;
+			  });
+	return true;
+#else
+	(void)sysfsRoot;
+	(void)devRoot;
+	return false;
+#endif
+}
+
+bool IsCandidatePort(const PlayzerXPortInfo& port, const std::vector<PlayzerXUsbId>& filter)
+{
+	if (!port.IsUSB) return false;
+	if (filter.empty()) return true;
+	for (const PlayzerXUsbId& id : filter)
+		if (id.VendorId == port.VendorId && (id.ProductId == 0 || id.ProductId == port.ProductId))
+			return true;
+	return false;
+}
+
+}  // namespace playzerx
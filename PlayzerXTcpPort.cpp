@@ -0,0 +1,256 @@
+//////////////////////////////////////////////////////////////////////
+// PlayzerXTcpPort.cpp
+// Version: 2.1.0.0
+//////////////////////////////////////////////////////////////////////
+
+#include "PlayzerXTcpPort.h"
+
+#include <chrono>
+#include <cstdlib>
+
+#ifdef MTI_UNIX
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#endif
+
+namespace playzerx
+{
+namespace
+{
+const char kTcpPrefix[] = "tcp://";
+
+/** \brief Splits "tcp://host:port" into host and port, \c false if it is malformed. */
+bool ParseTcpPortName(const std::string& portName, std::string& host, std::string& port)
+{
+	if (portName.compare(0, sizeof(kTcpPrefix) - 1, kTcpPrefix) != 0) return false;
+	std::string address = portName.substr(sizeof(kTcpPrefix) - 1);
+	size_t colon = address.rfind(':');
+	if (colon == std::string::npos || colon + 1 == address.size()) return false;
+	host = address.substr(0, colon);
+	port = address.substr(colon + 1);
+	if (host.size() >= 2 && host[0] == '[' && host[host.size() - 1] == ']')
+		host = host.substr(1, host.size() - 2);
+	return !host.empty() && port.find_first_not_of("0123456789") == std::string::npos;
+}
+
+/** \brief Milliseconds of a monotonic clock, for timeouts measured in wall time. */
+unsigned long long MonotonicMs()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+			   std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+}  // namespace
+
+bool PlayzerXTcpPort::IsTcpPortName(const std::string& portName)
+{
+	return portName.compare(0, sizeof(kTcpPrefix) - 1, kTcpPrefix) == 0;
+}
+
+long PlayzerXTcpPort::Open(const char* port, unsigned int baudRate, unsigned int inQueue,
+						   unsigned int outQueue)
+{
+	// The bridge sets the line; the socket buffers have fixed sizes, see kSendBuffer
+	(void)baudRate;
+	(void)inQueue;
+	(void)outQueue;
+	if (m_hFile) return MTI_ERR_SERIALCOMM;
+	std::string host, service;
+	if (!ParseTcpPortName(port, host, service)) return MTI_ERR_INVALID_DEVICEID;
+
+#ifdef MTI_UNIX
+	struct addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	struct addrinfo* addresses = nullptr;
+	if (getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses) != 0)
+		return MTI_ERR_INVALID_DEVICEID;
+
+	// Try the addresses in order, each with its own timeout
+	int socketFd = -1;
+	for (struct addrinfo* address = addresses; address != nullptr && socketFd < 0;
+		 address = address->ai_next)
+	{
+		socketFd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+						  address->ai_protocol);
+		if (socketFd < 0) continue;
+
+		// Buffer sizes have to be set before connecting to take effect on the window
+		int value = 1;
+		setsockopt(socketFd, IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+		setsockopt(socketFd, SOL_SOCKET, SO_SNDBUF, &kSendBuffer, sizeof(kSendBuffer));
+		setsockopt(socketFd, SOL_SOCKET, SO_RCVBUF, &kReceiveBuffer, sizeof(kReceiveBuffer));
+
+		bool connected = connect(socketFd, address->ai_addr, address->ai_addrlen) == 0;
+		if (!connected && errno == EINPROGRESS)
+		{
+			struct pollfd pfd = {socketFd, POLLOUT, 0};
+			int error = 0;
+			socklen_t length = sizeof(error);
+			connected = poll(&pfd, 1, kConnectTimeout) == 1 &&
+						getsockopt(socketFd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 &&
+						error == 0;
+		}
+		if (!connected)
+		{
+			close(socketFd);
+			socketFd = -1;
+		}
+	}
+	freeaddrinfo(addresses);
+	if (socketFd < 0) return MTI_ERR_INVALID_DEVICEID;
+
+	// The socket takes the place of the serial descriptor, the base class reads and writes it
+	m_hFile = socketFd;
+	m_RxStart = m_RxEnd = 0;
+	SetBlockingMode();
+	return MTI_SUCCESS;
+#else
+	return MTI_ERR_INVALID_DEVICEID;
+#endif
+}
+
+long PlayzerXTcpPort::Purge()
+{
+	if (m_hFile == 0) return MTI_ERR_INVALID_HANDLE;
+	m_RxStart = m_RxEnd = 0;
+
+#ifdef MTI_UNIX
+	unsigned char discard[4096];
+	while (recv(m_hFile, discard, sizeof(discard), MSG_DONTWAIT) > 0)
+	{
+	}
+#endif
+	return MTI_SUCCESS;
+}
+
+long PlayzerXTcpPort::SetSerialParams(unsigned int baudRate)
+{
+	(void)baudRate;
+	return (m_hFile == 0) ? MTI_ERR_INVALID_HANDLE : MTI_SUCCESS;
+}
+
+long PlayzerXTcpPort::Read(unsigned char* pData, size_t lData, unsigned int* lRead,
+						   unsigned int timeout, int blockingMode)
+{
+	if (m_hFile == 0) return MTI_ERR_INVALID_HANDLE;
+	if (blockingMode != MTI_BLOCKING_MODE_ERR) SetBlockingMode(blockingMode);
+
+	// Same as the serial port: buffered bytes first, then until lData bytes or the timeout
+	unsigned long long start = MonotonicMs();
+	size_t total = TakeRxBuffer(pData, lData);
+	long lastError = MTI_SUCCESS;
+	while (total < lData)
+	{
+		unsigned int remaining = INFINITE;
+		if (timeout != INFINITE)
+		{
+			unsigned long long elapsed = MonotonicMs() - start;
+			remaining = (elapsed < timeout) ? (unsigned int)(timeout - elapsed) : 0;
+		}
+#ifdef MTI_UNIX
+		else if (m_BlockingMode == MTI_BLOCKING_MODE_OFF)
+			remaining = 0;
+#endif
+
+		unsigned int numRead = 0;
+		lastError = ReadRaw(pData + total, lData - total, &numRead, remaining);
+		total += numRead;
+		if (lastError != MTI_SUCCESS) break;
+	}
+	if (lRead != 0) *lRead = (unsigned int)total;
+	// Non-blocking reads without timeout return what was available
+	if (lastError == MTI_ERR_SERIALCOMM_READ_TIMEOUT && timeout == INFINITE) return MTI_SUCCESS;
+	return lastError;
+}
+
+long PlayzerXTcpPort::WriteQueued(unsigned char* pData, size_t lData, unsigned int* lWritten,
+								  unsigned int timeout)
+{
+	if (lWritten != 0) *lWritten = 0;
+	if (m_hFile == 0) return MTI_ERR_INVALID_HANDLE;
+
+#ifdef MTI_UNIX
+	unsigned long long start = MonotonicMs();
+	size_t written = 0;
+	long lastError = MTI_SUCCESS;
+	bool stalled = false;
+	while (written < lData)
+	{
+		// MSG_NOSIGNAL: a connection closed by the bridge must not kill the process with SIGPIPE
+		ssize_t n = send(m_hFile, pData + written, lData - written, MSG_NOSIGNAL);
+		if (n > 0)
+		{
+			written += n;
+			continue;
+		}
+		if (n < 0 && errno == EINTR) continue;
+		if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+		{
+			lastError = MTI_ERR_SERIALCOMM;  // EPIPE, ECONNRESET, ...
+			break;
+		}
+
+		// The send buffer is full: wait until the bridge acknowledged some of it
+		stalled = true;
+		int wait = -1;
+		if (timeout != INFINITE)
+		{
+			unsigned long long elapsed = MonotonicMs() - start;
+			if (elapsed >= timeout)
+			{
+				lastError = MTI_ERR_SERIALCOMM_READ_TIMEOUT;
+				break;
+			}
+			wait = (int)(timeout - elapsed);
+		}
+		struct pollfd pfd = {m_hFile, POLLOUT, 0};
+		int ret = poll(&pfd, 1, wait);
+		if ((ret < 0 && errno != EINTR) ||
+			(ret > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))))
+		{
+			lastError = MTI_ERR_SERIALCOMM;
+			break;
+		}
+	}
+
+	if (stalled) m_PartialWrites++;
+	if (lWritten != 0) *lWritten = (unsigned int)written;
+	return lastError;
+#else
+	return MTI_ERR_SERIALCOMM;
+#endif
+}
+
+long PlayzerXTcpPort::ReadRaw(unsigned char* pData, size_t lData, unsigned int* lRead,
+							  unsigned int timeout)
+{
+	if (lRead != 0) *lRead = 0;
+
+#ifdef MTI_UNIX
+	struct pollfd pfd = {m_hFile, POLLIN, 0};
+	int ret = poll(&pfd, 1, (timeout == INFINITE) ? -1 : (int)timeout);
+	if (ret == 0) return MTI_ERR_SERIALCOMM_READ_TIMEOUT;
+	if (ret < 0) return (errno == EINTR) ? MTI_SUCCESS : MTI_ERR_SERIALCOMM;
+	// Bytes received before a hang-up are still delivered, POLLIN is set for them
+	if (!(pfd.revents & POLLIN)) return MTI_ERR_SERIALCOMM;
+
+	// A closed connection is readable with 0 bytes; that is the end of the stream, not data
+	ssize_t n = recv(m_hFile, pData, lData, MSG_DONTWAIT);
+	if (n > 0)
+	{
+		if (lRead != 0) *lRead = (unsigned int)n;
+		return MTI_SUCCESS;
+	}
+	if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return MTI_SUCCESS;
+	return MTI_ERR_SERIALCOMM;  // 0 (closed), ECONNRESET, ...
+#else
+	return MTI_ERR_SERIALCOMM;
+#endif
+}
+
+}  // namespace playzerx
@@ -0,0 +1,151 @@
+//////////////////////////////////////////////////////////////////////
+// PlayzerXTelemetry.cpp
+// Version: 2.1.0.0
+//////////////////////////////////////////////////////////////////////
+
+#include "PlayzerXTelemetry.h"
+
+namespace playzerx
+{
+PlayzerXTelemetry::PlayzerXTelemetry()
+{
+	m_Serial = nullptr;
+	m_Running = false;
+	m_Generation = 0;
+	m_Level = -1;
+	m_Timestamp = 0;
+}
+
+PlayzerXTelemetry::~PlayzerXTelemetry() { Stop(); }
+
+bool PlayzerXTelemetry::Start(MTISerialIO* serial)
+{
+	if (IsRunning()) return true;
+	if (serial == nullptr) return false;
+
+	m_Serial = serial;
+	m_Parser.Reset();
+	m_Generation.store(0, std::memory_order_release);
+	m_Running.store(true, std::memory_order_release);
+	m_Thread = std::thread(&PlayzerXTelemetry::ReaderThread, this);
+	return true;
+}
+
+bool PlayzerXTelemetry::Attach(MTISerialIO* serial)
+{
+	if (IsRunning()) return !m_Thread.joinable();
+	if (serial == nullptr) return false;
+
+	m_Serial = serial;
+	m_Parser.Reset();
+	m_Generation.store(0, std::memory_order_release);
+	m_Running.store(true, std::memory_order_release);
+	return true;
+}
+
+bool PlayzerXTelemetry::Poll()
+{
+	if (!IsRunning() || m_Thread.joinable()) return false;
+
+	unsigned char data[256];
+	unsigned int numRead;
+	bool updated = false;
+	// Everything received so far, a full buffer is likely followed by more
+	do
+	{
+		if (m_Serial->ReadAvailable(data, sizeof(data), &numRead, 0) != MTI_SUCCESS) break;
+		updated |= Consume(data, numRead, Now());
+	} while (numRead == sizeof(data));
+	return updated;
+}
+
+void PlayzerXTelemetry::Stop()
+{
+	if (!IsRunning()) return;
+
+	m_Running.store(false, std::memory_order_release);
+	if (m_Thread.joinable()) m_Thread.join();
+	m_Serial = nullptr;
+	// Release anyone blocked in WaitForUpdate()
+	m_WaitCondition.notify_all();
+}
+
+bool PlayzerXTelemetry::GetLatest(int& level, long long& timestamp) const
+{
+	unsigned long long before, after;
+	do
+	{
+		before = m_Generation.load(std::memory_order_acquire);
+		level = m_Level.load(std::memory_order_relaxed);
+		timestamp = m_Timestamp.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		after = m_Generation.load(std::memory_order_relaxed);
+	} while ((before & 1) || before != after);
+
+	return before > 0;
+}
+
+bool PlayzerXTelemetry::WaitForUpdate(unsigned long long count, unsigned int timeout)
+{
+	std::unique_lock<std::mutex> lock(m_WaitMutex);
+	return m_WaitCondition.wait_for(lock, std::chrono::milliseconds(timeout), [&] {
+		return !IsRunning() || GetUpdateCount() > count;
+	}) && GetUpdateCount() > count;
+}
+
+void PlayzerXTelemetry::Publish(int level, long long timestamp)
+{
+	unsigned long long generation = m_Generation.load(std::memory_order_relaxed);
+	m_Generation.store(generation + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_Level.store(level, std::memory_order_relaxed);
+	m_Timestamp.store(timestamp, std::memory_order_relaxed);
+	m_Generation.store(generation + 2, std::memory_order_release);
+
+	// Taking the lock orders the update against a waiter checking its predicate
+	{
+		std::lock_guard<std::mutex> lock(m_WaitMutex);
+	}
+	m_WaitCondition.notify_all();
+}
+
+bool PlayzerXTelemetry::Consume(const unsigned char* data, unsigned int numRead,
+								long long timestamp)
+{
+	int level, latest;
+	bool updated = false;
+	for (unsigned int i = 0; i < numRead; i++)
+	{
+		if (m_Parser.Feed(data[i], level))
+		{
+			if (m_LevelListener) m_LevelListener(level, timestamp);
+			latest = level;
+			updated = true;
+		}
+	}
+	// Only the newest of several records read at once is of interest
+	if (updated) Publish(latest, timestamp);
+	return updated;
+}
+
+void PlayzerXTelemetry::ReaderThread()
+{
+	unsigned char data[256];
+	unsigned int numRead;
+
+	while (IsRunning())
+	{
+		// Short timeout keeps Stop() responsive when the controller is silent
+		long lastError = m_Serial->ReadAvailable(data, sizeof(data), &numRead, 20);
+		if (lastError == MTI_ERR_SERIALCOMM_READ_TIMEOUT) continue;
+		if (lastError != MTI_SUCCESS)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		Consume(data, numRead, Now());
+	}
+}
+
+}  // namespace playzerx
@@ -0,0 +1,122 @@
+//////////////////////////////////////////////////////////////////////
+// PlayzerXTransaction.cpp
+// Version: 2.1.0.0
+//////////////////////////////////////////////////////////////////////
+
+#include "PlayzerXTransaction.h"
+
+#include <algorithm>
+
+namespace playzerx
+{
+PlayzerXTransaction::PlayzerXTransaction() { Clear(); }
+
+PlayzerXTransaction& PlayzerXTransaction::ClearData()
+{
+	unsigned char sendData[5];
+	sendData[0] = 'p';
+	sendData[1] = 'l';
+	sendData[2] = 'c';
+	sendData[3] = 5;
+	sendData[4] = 10;  // Include suffix here!
+	m_Bytes.insert(m_Bytes.end(), sendData, sendData + 5);
+
+	// Samples added before are dropped by the device
+	m_HasClear = true;
+	m_SamplesAfterClear = 0;
+	m_SampleBytesAfterClear = 0;
+	return *this;
+}
+
+PlayzerXTransaction& PlayzerXTransaction::SetSampleRate(unsigned int sampleRate)
+{
+	sampleRate = std::min(std::max(sampleRate, 200u), 50000u);
+	unsigned char sendData[8];
+	sendData[0] = 'p';
+	sendData[1] = 'l';
+	sendData[2] = 'r';
+	sendData[3] = 8;
+	sendData[4] = (sampleRate & 0x0000FF);
+	sendData[5] = (sampleRate & 0x00FF00) >> 8;
+	sendData[6] = (sampleRate & 0xFF0000) >> 16;
+	sendData[7] = 10;  // Include suffix here!
+	m_Bytes.insert(m_Bytes.end(), sendData, sendData + 8);
+	m_SampleRate = (int)sampleRate;
+	return *this;
+}
+
+PlayzerXTransaction& PlayzerXTransaction::SetBufferUpdateTimer(unsigned int bufferUpdateTimer)
+{
+	unsigned int updateRateLoops = std::min(bufferUpdateTimer, 1000u);
+	unsigned char sendData[7];
+	sendData[0] = 'p';
+	sendData[1] = 'l';
+	sendData[2] = 'u';
+	sendData[3] = 7;
+	sendData[4] = (updateRateLoops & 0x000000FF);
+	sendData[5] = (updateRateLoops & 0x0000FF00) >> 8;
+	sendData[6] = 10;  // Include suffix here!
+	m_Bytes.insert(m_Bytes.end(), sendData, sendData + 7);
+	m_BufferUpdateTimer = (int)updateRateLoops;
+	return *this;
+}
+
+PlayzerXTransaction& PlayzerXTransaction::SendDataXYM(const float* x, const float* y,
+													  const unsigned char* m,
+													  unsigned int numSamples)
+{
+	if (numSamples > 0)
+		EncodeDataXYM(x, y, m, numSamples, AddSamples(numSamples, kBytesPerSampleXYM));
+	return *this;
+}
+
+PlayzerXTransaction& PlayzerXTransaction::SendDataXY(const float* x, const float* y,
+													 unsigned int numSamples)
+{
+	if (numSamples > 0) EncodeDataXY(x, y, numSamples, AddSamples(numSamples, kBytesPerSampleXY));
+	return *this;
+}
+
+PlayzerXTransaction& PlayzerXTransaction::SendDataXYRGB(const float* x, const float* y,
+														const unsigned char* r,
+														const unsigned char* g,
+														const unsigned char* b,
+														unsigned int numSamples)
+{
+	if (numSamples > 0)
+		EncodeDataXYRGB(x, y, r, g, b, numSamples,
+						AddSamples(numSamples, kBytesPerSampleXYRGB));
+	return *this;
+}
+
+PlayzerXTransaction& PlayzerXTransaction::SendFrame(const EncodedFrame& frame)
+{
+	if (frame.GetNumSamples() > 0)
+		std::copy(frame.GetData(), frame.GetData() + frame.GetNumBytes(),
+				  AddSamples(frame.GetNumSamples(), frame.GetBytesPerSample()));
+	return *this;
+}
+
+void PlayzerXTransaction::Clear()
+{
+	m_Bytes.clear();
+	m_NumSamples = 0;
+	m_HasClear = false;
+	m_SamplesAfterClear = 0;
+	m_SampleBytesAfterClear = 0;
+	m_SampleRate = -1;
+	m_BufferUpdateTimer = -1;
+}
+
+unsigned char* PlayzerXTransaction::AddSamples(unsigned int numSamples,
+											   unsigned int bytesPerSample)
+{
+	size_t offset = m_Bytes.size();
+	m_Bytes.resize(offset + (size_t)numSamples * bytesPerSample);
+	m_NumSamples += numSamples;
+	m_SamplesAfterClear += numSamples;
+	m_SampleBytesAfterClear += numSamples * bytesPerSample;
+	return &m_Bytes[offset];
+}
+
+}  // namespace playzerx
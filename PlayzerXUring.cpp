@@ -0,0 +1,599 @@
+//////////////////////////////////////////////////////////////////////
+// PlayzerXUring.cpp
+// Version: 2.1.0.0
+//////////////////////////////////////////////////////////////////////
+
+#include "PlayzerXUring.h"
+
+#ifdef PLAYZERX_IO_URING
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "PlayzerXTcpPort.h"
+#include "PlayzerXTelemetry.h"
+#endif
+
+namespace playzerx
+{
+#ifdef PLAYZERX_IO_URING
+namespace
+{
+/** \brief Request kinds, in the low bits of the user data next to the port index. */
+enum RequestKind
+{
+	kReadRequest = 0,
+	kWriteRequest = 1,
+	kCancelRequest = 2,
+	kWakeUpRequest = 3,
+};
+
+unsigned long long UserData(int index, RequestKind kind)
+{
+	return ((unsigned long long)index << 2) | kind;
+}
+}  // namespace
+
+/**
+ * \class PlayzerXUringPort
+ * \brief MTISerialIO whose reads and writes are requests on a PlayzerXUring.
+ *
+ * Opens and configures the port like the serial port. WriteQueued() copies into the registered
+ * write buffer of the port, which is written by one request at a time; the output queue is that
+ * buffer plus the driver queue. Received bytes are collected by the completion thread and
+ * handed out by ReadRaw(); reading pauses while kReceiveLimit bytes are unread.
+ */
+class PlayzerXUringPort : public MTISerialIO
+{
+   public:
+	explicit PlayzerXUringPort(PlayzerXUring& uring) : m_Uring(uring), m_Index(-1) {}
+	~PlayzerXUringPort() { Close(); }
+
+	long Open(const char* port, unsigned int baudRate = MTI_BAUDRATE_DEFAULT,
+			  unsigned int inQueue = MTI_SERIAL_QUEUE_SIZE,
+			  unsigned int outQueue = MTI_SERIAL_QUEUE_SIZE) override;
+	long Close() override;
+	long Purge() override;
+	long Read(unsigned char* pData, size_t lData, unsigned int* lRead = 0,
+			  unsigned int timeout = INFINITE, int blockingMode = MTI_BLOCKING_MODE_ON) override;
+	long GetOutputQueue(unsigned int* lQueued) override;
+	long WriteQueued(unsigned char* pData, size_t lData, unsigned int* lWritten = 0,
+					 unsigned int timeout = INFINITE) override;
+	/** \brief None, the descriptor is only ever ready for the ring. */
+	int GetFileDescriptor() const override { return -1; }
+
+   protected:
+	long ReadRaw(unsigned char* pData, size_t lData, unsigned int* lRead,
+				 unsigned int timeout) override;
+
+   private:
+	friend class PlayzerXUring;
+
+	/** \brief Unread bytes at which reading pauses, the size of a serial driver buffer. */
+	const size_t kReceiveLimit = 64 * 1024;
+
+	PlayzerXUring& m_Uring;
+	/** \brief Slot in the ring, -1 while closed. This and the members below are guarded by the
+	 * ring mutex. */
+	int m_Index;
+	unsigned char* m_WriteBuffer;
+	unsigned char* m_ReadBuffer;
+	/** \brief Circular write buffer: m_WriteQueued bytes from m_WriteStart, of which the first
+	 * m_WriteInFlight are being written. */
+	size_t m_WriteStart;
+	size_t m_WriteQueued;
+	size_t m_WriteInFlight;
+	bool m_ReadPending;
+	std::vector<unsigned char> m_Received;
+	size_t m_ReceivedStart;
+	/** \brief Requests not completed yet. */
+	int m_Pending;
+	bool m_Closing;
+	bool m_Failed;
+	/** \brief Notified when bytes were received, and at close. */
+	std::condition_variable m_ReadReady;
+	/** \brief Notified when a write or, while closing, any other request completed. */
+	std::condition_variable m_WriteReady;
+};
+
+long PlayzerXUringPort::Open(const char* port, unsigned int baudRate, unsigned int inQueue,
+							 unsigned int outQueue)
+{
+	long lastError = MTISerialIO::Open(port, baudRate, inQueue, outQueue);
+	if (lastError != MTI_SUCCESS) return lastError;
+	if (!m_Uring.Attach(this))
+	{
+		MTISerialIO::Close();
+		return MTI_ERR_SERIALCOMM;
+	}
+	return MTI_SUCCESS;
+}
+
+long PlayzerXUringPort::Close()
+{
+	if (m_hFile == 0) return MTI_SUCCESS;
+	m_Uring.Detach(this);
+	return MTISerialIO::Close();
+}
+
+long PlayzerXUringPort::Purge()
+{
+	std::unique_lock<std::mutex> lock(m_Uring.m_Mutex);
+	if (m_Index < 0) return MTI_ERR_INVALID_HANDLE;
+	m_RxStart = m_RxEnd = 0;
+	m_Received.clear();
+	m_ReceivedStart = 0;
+	// Bytes in a write request cannot be recalled
+	m_WriteQueued = m_WriteInFlight;
+	tcflush(m_hFile, TCIOFLUSH);
+	m_Uring.StartRead(this);
+	m_Uring.Submit(lock);
+	return MTI_SUCCESS;
+}
+
+long PlayzerXUringPort::Read(unsigned char* pData, size_t lData, unsigned int* lRead,
+							 unsigned int timeout, int blockingMode)
+{
+	if (lRead != 0) *lRead = 0;
+	if (m_hFile == 0) return MTI_ERR_INVALID_HANDLE;
+	if (blockingMode != MTI_BLOCKING_MODE_ERR) SetBlockingMode(blockingMode);
+
+	// Same rules as the serial port: non-blocking reads without a timeout return what is there
+	unsigned int wait = timeout;
+	if (m_BlockingMode == MTI_BLOCKING_MODE_OFF && timeout == INFINITE) wait = 0;
+	size_t lTotal = TakeRxBuffer(pData, lData);
+	while (lTotal < lData)
+	{
+		unsigned int lChunk = 0;
+		long lastError = ReadRaw(pData + lTotal, lData - lTotal, &lChunk, wait);
+		if (lastError == MTI_ERR_SERIALCOMM_READ_TIMEOUT && wait != timeout) break;
+		if (lastError != MTI_SUCCESS) return lastError;
+		lTotal += lChunk;
+	}
+	if (lRead != 0) *lRead = (unsigned int)lTotal;
+	return MTI_SUCCESS;
+}
+
+long PlayzerXUringPort::GetOutputQueue(unsigned int* lQueued)
+{
+	size_t queued;
+	{
+		std::lock_guard<std::mutex> lock(m_Uring.m_Mutex);
+		if (m_Index < 0) return MTI_ERR_INVALID_HANDLE;
+		queued = m_WriteQueued;
+	}
+	unsigned int driverQueued = 0;
+	long lastError = MTISerialIO::GetOutputQueue(&driverQueued);
+	if (lastError != MTI_SUCCESS) return lastError;
+	*lQueued = (unsigned int)queued + driverQueued;
+	return MTI_SUCCESS;
+}
+
+long PlayzerXUringPort::WriteQueued(unsigned char* pData, size_t lData, unsigned int* lWritten,
+									unsigned int timeout)
+{
+	if (lWritten != 0) *lWritten = 0;
+	std::unique_lock<std::mutex> lock(m_Uring.m_Mutex);
+	if (m_Index < 0) return MTI_ERR_INVALID_HANDLE;
+
+	const size_t size = m_Uring.kWriteBufferSize;
+	std::chrono::steady_clock::time_point deadline =
+		std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+	size_t written = 0;
+	long lastError = MTI_SUCCESS;
+	bool stalled = false;
+	while (true)
+	{
+		if (m_Index < 0 || m_Failed)
+		{
+			lastError = MTI_ERR_SERIALCOMM;
+			break;
+		}
+
+		// Fill the free part of the circular buffer, it may wrap around once
+		while (written < lData && m_WriteQueued < size)
+		{
+			size_t end = (m_WriteStart + m_WriteQueued) % size;
+			size_t n = lData - written;
+			if (n > size - m_WriteQueued) n = size - m_WriteQueued;
+			if (n > size - end) n = size - end;
+			memcpy(m_WriteBuffer + end, pData + written, n);
+			m_WriteQueued += n;
+			written += n;
+		}
+		m_Uring.StartWrite(this);
+		if (written == lData) break;
+
+		// The buffer is full: wait for the request in flight to complete
+		stalled = true;
+		if (timeout != INFINITE && std::chrono::steady_clock::now() >= deadline)
+		{
+			lastError = MTI_ERR_SERIALCOMM_READ_TIMEOUT;
+			break;
+		}
+		m_Uring.Submit(lock);
+		if (timeout == INFINITE)
+			m_WriteReady.wait(lock);
+		else
+			m_WriteReady.wait_until(lock, deadline);
+	}
+	m_Uring.SubmitLater(lock);
+
+	if (stalled) m_PartialWrites++;
+	if (lWritten != 0) *lWritten = (unsigned int)written;
+	return lastError;
+}
+
+long PlayzerXUringPort::ReadRaw(unsigned char* pData, size_t lData, unsigned int* lRead,
+								unsigned int timeout)
+{
+	if (lRead != 0) *lRead = 0;
+	std::unique_lock<std::mutex> lock(m_Uring.m_Mutex);
+	auto ready = [this]
+	{ return m_Index < 0 || m_Failed || m_ReceivedStart < m_Received.size(); };
+	if (timeout == INFINITE)
+		m_ReadReady.wait(lock, ready);
+	else
+		m_ReadReady.wait_for(lock, std::chrono::milliseconds(timeout), ready);
+
+	if (m_ReceivedStart < m_Received.size())
+	{
+		size_t lTaken = m_Received.size() - m_ReceivedStart;
+		if (lTaken > lData) lTaken = lData;
+		memcpy(pData, &m_Received[m_ReceivedStart], lTaken);
+		m_ReceivedStart += lTaken;
+		if (m_ReceivedStart == m_Received.size())
+		{
+			m_Received.clear();
+			m_ReceivedStart = 0;
+		}
+		if (lRead != 0) *lRead = (unsigned int)lTaken;
+
+		// Resume reading if it paused for the unread bytes
+		if (!m_ReadPending && m_Index >= 0)
+		{
+			m_Uring.StartRead(this);
+			m_Uring.Submit(lock);
+		}
+		return MTI_SUCCESS;
+	}
+	if (m_Index < 0) return MTI_ERR_INVALID_HANDLE;
+	if (m_Failed) return MTI_ERR_SERIALCOMM;
+	return MTI_ERR_SERIALCOMM_READ_TIMEOUT;
+}
+
+PlayzerXUring::PlayzerXUring(unsigned int maxPorts)
+	: m_MaxPorts(maxPorts),
+	  m_RingFd(-1),
+	  m_RingMemory(MAP_FAILED),
+	  m_RingSize(0),
+	  m_EntryMemory(MAP_FAILED),
+	  m_EntrySize(0),
+	  m_TimedWait(false),
+	  m_Sleeping(true),
+	  m_LastWrite(0),
+	  m_Ports(maxPorts, nullptr),
+	  m_Stopping(false),
+	  m_Stats()
+{
+	// A port has at most a read, a write and a cancellation in flight
+	unsigned int entries = 8;
+	while (entries < 4 * maxPorts) entries *= 2;
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if (ringFd < 0) return;
+
+	// Both rings in one mapping (Linux 5.4), which every kernel with IORING_OP_READ has
+	if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+	{
+		close(ringFd);
+		return;
+	}
+	size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	m_RingSize = (sqSize > cqSize) ? sqSize : cqSize;
+	m_RingMemory = mmap(nullptr, m_RingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						ringFd, IORING_OFF_SQ_RING);
+	m_EntrySize = params.sq_entries * sizeof(struct io_uring_sqe);
+	m_EntryMemory = mmap(nullptr, m_EntrySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						 ringFd, IORING_OFF_SQES);
+	if (m_RingMemory == MAP_FAILED || m_EntryMemory == MAP_FAILED)
+	{
+		if (m_RingMemory != MAP_FAILED) munmap(m_RingMemory, m_RingSize);
+		if (m_EntryMemory != MAP_FAILED) munmap(m_EntryMemory, m_EntrySize);
+		m_RingMemory = m_EntryMemory = MAP_FAILED;
+		close(ringFd);
+		return;
+	}
+	unsigned char* ring = (unsigned char*)m_RingMemory;
+	m_SqHead = (unsigned int*)(ring + params.sq_off.head);
+	m_SqTail = (unsigned int*)(ring + params.sq_off.tail);
+	m_SqMask = (unsigned int*)(ring + params.sq_off.ring_mask);
+	m_SqArray = (unsigned int*)(ring + params.sq_off.array);
+	m_CqHead = (unsigned int*)(ring + params.cq_off.head);
+	m_CqTail = (unsigned int*)(ring + params.cq_off.tail);
+	m_CqMask = (unsigned int*)(ring + params.cq_off.ring_mask);
+	m_Completions = ring + params.cq_off.cqes;
+	m_TimedWait = (params.features & IORING_FEAT_EXT_ARG) != 0;
+
+	// One registered buffer per port; without enough locked memory, plain reads and writes
+	size_t portSize = kWriteBufferSize + kReadBufferSize;
+	m_Buffers.resize(portSize * maxPorts);
+	std::vector<struct iovec> buffers(maxPorts);
+	for (unsigned int i = 0; i < maxPorts; i++)
+	{
+		buffers[i].iov_base = &m_Buffers[i * portSize];
+		buffers[i].iov_len = portSize;
+	}
+	m_Stats.RegisteredBuffers = syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS,
+										&buffers[0], maxPorts) == 0;
+
+	m_RingFd = ringFd;
+	m_Thread = std::thread(&PlayzerXUring::CompletionThread, this);
+}
+
+PlayzerXUring::~PlayzerXUring()
+{
+	if (m_RingFd < 0) return;
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Stopping = true;
+		Queue(IORING_OP_NOP, -1, 0, 0, -1, UserData(0, kWakeUpRequest));
+		Submit(lock);
+	}
+	m_Thread.join();
+	munmap(m_EntryMemory, m_EntrySize);
+	munmap(m_RingMemory, m_RingSize);
+	close(m_RingFd);
+}
+
+PlayzerXTransportFactory PlayzerXUring::GetTransportFactory()
+{
+	return [this](const std::string& portName) -> MTISerialIO*
+	{
+		if (!IsAvailable() || PlayzerXTcpPort::IsTcpPortName(portName)) return nullptr;
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (unsigned int i = 0; i < m_MaxPorts; i++)
+			if (m_Ports[i] == nullptr) return new PlayzerXUringPort(*this);
+		return nullptr;
+	};
+}
+
+PlayzerXUringStats PlayzerXUring::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Stats;
+}
+
+bool PlayzerXUring::Attach(PlayzerXUringPort* port)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	unsigned int index = 0;
+	while (index < m_MaxPorts && m_Ports[index] != nullptr) index++;
+	if (index == m_MaxPorts) return false;
+
+	m_Ports[index] = port;
+	port->m_Index = (int)index;
+	port->m_WriteBuffer = &m_Buffers[index * (kWriteBufferSize + kReadBufferSize)];
+	port->m_ReadBuffer = port->m_WriteBuffer + kWriteBufferSize;
+	port->m_WriteStart = port->m_WriteQueued = port->m_WriteInFlight = 0;
+	port->m_ReadPending = false;
+	port->m_Received.clear();
+	port->m_ReceivedStart = 0;
+	port->m_Pending = 0;
+	port->m_Closing = false;
+	port->m_Failed = false;
+	StartRead(port);
+	Submit(lock);
+	return true;
+}
+
+void PlayzerXUring::Detach(PlayzerXUringPort* port)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	if (port->m_Index < 0) return;
+
+	// Let the queued bytes go out, as closing a serial port does, then stop the requests
+	port->m_WriteReady.wait_for(lock, std::chrono::seconds(2),
+						   [port] { return port->m_WriteQueued == 0 || port->m_Failed; });
+	port->m_Closing = true;
+	port->m_WriteQueued = port->m_WriteInFlight;
+	int index = port->m_Index;
+	if (port->m_ReadPending &&
+		Queue(IORING_OP_ASYNC_CANCEL, -1, UserData(index, kReadRequest), 0, -1,
+			  UserData(index, kCancelRequest)))
+		port->m_Pending++;
+	if (port->m_WriteInFlight > 0 &&
+		Queue(IORING_OP_ASYNC_CANCEL, -1, UserData(index, kWriteRequest), 0, -1,
+			  UserData(index, kCancelRequest)))
+		port->m_Pending++;
+	Submit(lock);
+	port->m_WriteReady.wait(lock, [port] { return port->m_Pending == 0; });
+
+	m_Ports[index] = nullptr;
+	port->m_Index = -1;
+	port->m_ReadReady.notify_all();
+	port->m_WriteReady.notify_all();
+}
+
+bool PlayzerXUring::Queue(unsigned char opcode, int fd, unsigned long long address,
+						  unsigned int length, int bufferIndex, unsigned long long userData)
+{
+	// Only filled under the mutex, the kernel moves the head
+	unsigned int tail = *m_SqTail;
+	if (tail - __atomic_load_n(m_SqHead, __ATOMIC_ACQUIRE) > *m_SqMask) return false;
+	unsigned int slot = tail & *m_SqMask;
+	struct io_uring_sqe* entry = (struct io_uring_sqe*)m_EntryMemory + slot;
+	memset(entry, 0, sizeof(*entry));
+	entry->opcode = opcode;
+	entry->fd = fd;
+	entry->addr = address;
+	entry->len = length;
+	// Pipes and terminals have no position, -1 reads and writes at the current one
+	if (opcode != IORING_OP_NOP && opcode != IORING_OP_ASYNC_CANCEL)
+		entry->off = (unsigned long long)-1;
+	if (bufferIndex >= 0) entry->buf_index = (unsigned short)bufferIndex;
+	entry->user_data = userData;
+	m_SqArray[slot] = slot;
+	__atomic_store_n(m_SqTail, tail + 1, __ATOMIC_RELEASE);
+	m_Stats.Submissions++;
+	return true;
+}
+
+void PlayzerXUring::Submit(std::unique_lock<std::mutex>& lock)
+{
+	// The kernel takes what is between head and tail, whoever calls it first submits all of it
+	unsigned int count = *m_SqTail - __atomic_load_n(m_SqHead, __ATOMIC_ACQUIRE);
+	if (count == 0) return;
+	m_Stats.EnterCalls++;
+	lock.unlock();
+	syscall(__NR_io_uring_enter, m_RingFd, count, 0, 0, nullptr, 0);
+	lock.lock();
+}
+
+void PlayzerXUring::SubmitLater(std::unique_lock<std::mutex>& lock)
+{
+	// Batched with the writes of the other ports, unless no batch is due
+	m_LastWrite = PlayzerXTelemetry::Now();
+	if (!m_TimedWait || m_Sleeping) Submit(lock);
+}
+
+void PlayzerXUring::StartRead(PlayzerXUringPort* port)
+{
+	if (port->m_ReadPending || port->m_Closing || port->m_Failed) return;
+	if (port->m_Received.size() - port->m_ReceivedStart >= port->kReceiveLimit) return;
+	bool fixed = m_Stats.RegisteredBuffers;
+	if (Queue(fixed ? IORING_OP_READ_FIXED : IORING_OP_READ, port->m_hFile,
+			  (unsigned long long)port->m_ReadBuffer, kReadBufferSize, fixed ? port->m_Index : -1,
+			  UserData(port->m_Index, kReadRequest)))
+	{
+		port->m_ReadPending = true;
+		port->m_Pending++;
+	}
+}
+
+void PlayzerXUring::StartWrite(PlayzerXUringPort* port)
+{
+	if (port->m_WriteInFlight > 0 || port->m_WriteQueued == 0 || port->m_Closing || port->m_Failed)
+		return;
+	// Up to the end of the buffer, the wrapped part follows with the next request
+	size_t length = std::min(port->m_WriteQueued, kWriteBufferSize - port->m_WriteStart);
+	bool fixed = m_Stats.RegisteredBuffers;
+	if (Queue(fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, port->m_hFile,
+			  (unsigned long long)(port->m_WriteBuffer + port->m_WriteStart), (unsigned int)length,
+			  fixed ? port->m_Index : -1, UserData(port->m_Index, kWriteRequest)))
+	{
+		port->m_WriteInFlight = length;
+		port->m_Pending++;
+	}
+}
+
+void PlayzerXUring::Complete(unsigned long long userData, int result)
+{
+	m_Stats.Completions++;
+	RequestKind kind = (RequestKind)(userData & 3);
+	if (kind == kWakeUpRequest) return;
+	PlayzerXUringPort* port = m_Ports[userData >> 2];
+	port->m_Pending--;
+
+	if (kind == kReadRequest)
+	{
+		port->m_ReadPending = false;
+		if (result > 0)
+		{
+			m_Stats.BytesRead += result;
+			port->m_Received.insert(port->m_Received.end(), port->m_ReadBuffer,
+									port->m_ReadBuffer + result);
+		}
+		else if (result != -EINTR && result != -EAGAIN && result != -ECANCELED)
+			port->m_Failed = true;
+		StartRead(port);
+	}
+	else if (kind == kWriteRequest)
+	{
+		// Writes to a full terminal complete short, the rest goes with the next request
+		if (result > 0)
+		{
+			m_Stats.BytesWritten += result;
+			port->m_WriteStart = (port->m_WriteStart + result) % kWriteBufferSize;
+			port->m_WriteQueued -= result;
+		}
+		else if (result == -ECANCELED)
+			port->m_WriteQueued = 0;
+		else if (result != -EINTR && result != -EAGAIN)
+			port->m_Failed = true;
+		port->m_WriteInFlight = 0;
+		StartWrite(port);
+	}
+
+	// Readers wait for bytes, writers for room and Detach() for all requests
+	if (kind == kReadRequest || port->m_Failed) port->m_ReadReady.notify_all();
+	if (kind != kReadRequest || port->m_Closing || port->m_Failed) port->m_WriteReady.notify_all();
+}
+
+void PlayzerXUring::CompletionThread()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	while (!m_Stopping)
+	{
+		// Queued entries go in with the wait, which times out for the next batch while streaming
+		unsigned int count = *m_SqTail - __atomic_load_n(m_SqHead, __ATOMIC_ACQUIRE);
+		m_Sleeping = !m_TimedWait || PlayzerXTelemetry::Now() - m_LastWrite > kIdleDelay;
+		struct __kernel_timespec timeout = {0, kSubmitPeriod};
+		struct io_uring_getevents_arg arguments;
+		memset(&arguments, 0, sizeof(arguments));
+		arguments.ts = (unsigned long long)&timeout;
+		m_Stats.EnterCalls++;
+		lock.unlock();
+		if (m_Sleeping)
+			syscall(__NR_io_uring_enter, m_RingFd, count, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+		else
+			syscall(__NR_io_uring_enter, m_RingFd, count, 1,
+					IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arguments, sizeof(arguments));
+		lock.lock();
+		m_Sleeping = false;
+
+		unsigned int head = *m_CqHead;
+		unsigned int tail = __atomic_load_n(m_CqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++)
+		{
+			struct io_uring_cqe* completion =
+				(struct io_uring_cqe*)m_Completions + (head & *m_CqMask);
+			Complete(completion->user_data, completion->res);
+		}
+		__atomic_store_n(m_CqHead, head, __ATOMIC_RELEASE);
+	}
+}
+
+#else
+
+PlayzerXUring::PlayzerXUring(unsigned int maxPorts)
+	: m_MaxPorts(maxPorts),
+	  m_RingFd(-1),
+	  m_TimedWait(false),
+	  m_Sleeping(true),
+	  m_LastWrite(0),
+	  m_Stopping(false),
+	  m_Stats()
+{
+}
+
+PlayzerXUring::~PlayzerXUring() {}
+
+PlayzerXTransportFactory PlayzerXUring::GetTransportFactory()
+{
+	return [](const std::string&) -> MTISerialIO* { return nullptr; };
+}
+
+PlayzerXUringStats PlayzerXUring::GetStats() { return m_Stats; }
+
+#endif
+
+}  // namespace playzerx
@@ -0,0 +1,926 @@
+//////////////////////////////////////////////////////////////////////
+// PlayzerX-Bench.cpp
+// Version: 2.1.0.0
+//
+// Repeatable performance suites for the PlayzerX library. Device
+// suites run against the controller emulator on a pseudo terminal
+// or in memory, so no hardware is needed. Results are written as JSON.
+//////////////////////////////////////////////////////////////////////
+
+#include "PlayzerX.h"  // this header should be first, includes a lot of definitions
+
+#include <cmath>
+#include <cstdio>
+#include <dirent.h>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <random>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "PlayzerXGroup.h"
+#include "PlayzerXLoopback.h"
+#include "PlayzerXPorts.h"
+#include "PlayzerXSimulatorPort.h"
+
+using namespace playzerx;
+
+bool quickRun = false;
+bool useLoopback = false;
+unsigned int numDevices = 4;
+
+double NowSeconds() { return PlayzerXSimulatorPort::Now() * 1e-9; }
+
+double Percentile(std::vector<double> values, double fraction)
+{
+	if (values.empty()) return 0;
+	std::sort(values.begin(), values.end());
+	size_t i = (size_t)(fraction * (values.size() - 1) + 0.5);
+	return values[i];
+}
+
+std::string Number(double value)
+{
+	char text[32];
+	snprintf(text, sizeof(text), "%.6g", value);
+	return text;
+}
+
+const char* KernelName(PlayzerXEncoderKernel kernel)
+{
+	switch (kernel)
+	{
+	case PlayzerXEncoderKernel::SSE2: return "SSE2";
+	case PlayzerXEncoderKernel::AVX2: return "AVX2";
+	case PlayzerXEncoderKernel::AVX512: return "AVX512";
+	default: return "SCALAR";
+	}
+}
+
+/**
+ * \brief Emulated device on a pseudo terminal or, with --transport loopback, in memory.
+ *
+ * The loopback has no wire, so the baud rate does not apply to it.
+ */
+class BenchDevice
+{
+   public:
+	bool Start(unsigned int baudRate)
+	{
+		if (!useLoopback) return m_Port.Start(false, baudRate);
+		m_Loopback.Start(false);
+		return true;
+	}
+
+	std::string GetPortName() const
+	{
+		return useLoopback ? m_Loopback.GetPortName() : m_Port.GetPortName();
+	}
+
+	/** \brief Connects \p playzer, through the loopback transport if that is used. */
+	void Connect(PlayzerX& playzer)
+	{
+		if (useLoopback) playzer.SetTransportFactory(m_Loopback.GetTransportFactory());
+		playzer.ConnectDevice(GetPortName());
+	}
+
+	PlayzerXSimulatorStats GetStats()
+	{
+		return useLoopback ? m_Loopback.GetStats() : m_Port.GetStats();
+	}
+
+   private:
+	PlayzerXSimulatorPort m_Port;
+	PlayzerXLoopback m_Loopback;
+};
+
+/** \brief Random coordinates in [-1.2, 1.2] with out of range and special values sprinkled in. */
+void MakeTestData(std::vector<float>& x, std::vector<float>& y, std::vector<unsigned char>& m,
+				  unsigned int numSamples)
+{
+	std::mt19937 random(12345);
+	std::uniform_real_distribution<float> coordinate(-1.2f, 1.2f);
+	const float special[] = {std::numeric_limits<float>::quiet_NaN(),
+							 std::numeric_limits<float>::infinity(),
+							 -std::numeric_limits<float>::infinity(), -1.f, 1.f, 0.f, -0.f};
+	x.resize(numSamples);
+	y.resize(numSamples);
+	m.resize(numSamples);
+	for (unsigned int i = 0; i < numSamples; i++)
+	{
+		x[i] = (i % 13 == 0) ? special[(i / 13) % 7] : coordinate(random);
+		y[i] = (i % 17 == 0) ? special[(i / 17) % 7] : coordinate(random);
+		m[i] = (unsigned char)random();
+	}
+}
+
+unsigned int Encode(PlayzerXDataFormat format, const float* x, const float* y,
+					const unsigned char* m, unsigned int numSamples, unsigned char* bytes)
+{
+	if (format == PlayzerXDataFormat::XY) return EncodeDataXY(x, y, numSamples, bytes);
+	if (format == PlayzerXDataFormat::XYM) return EncodeDataXYM(x, y, m, numSamples, bytes);
+	return EncodeDataXYRGB(x, y, m, m, m, numSamples, bytes);
+}
+
+/** \brief Encoder throughput per kernel and format, and the check that all kernels agree. */
+std::string EncoderSuite(bool& passed)
+{
+	const PlayzerXDataFormat formats[] = {PlayzerXDataFormat::XY, PlayzerXDataFormat::XYM,
+										  PlayzerXDataFormat::XYRGB};
+	const char* formatNames[] = {"XY", "XYM", "XYRGB"};
+	const PlayzerXEncoderKernel kernels[] = {PlayzerXEncoderKernel::SCALAR,
+											 PlayzerXEncoderKernel::SSE2,
+											 PlayzerXEncoderKernel::AVX2,
+											 PlayzerXEncoderKernel::AVX512};
+	PlayzerXEncoderKernel defaultKernel = GetEncoderKernel();
+
+	const unsigned int numSamples = 100000;
+	const int repetitions = quickRun ? 5 : 25;
+	std::vector<float> x, y;
+	std::vector<unsigned char> m;
+	MakeTestData(x, y, m, numSamples);
+	std::vector<unsigned char> bytes(numSamples * kBytesPerSampleXYRGB);
+	std::vector<unsigned char> reference(bytes.size());
+
+	std::ostringstream json;
+	json << "{\"samples\": " << numSamples << ", \"default_kernel\": \""
+		 << KernelName(defaultKernel) << "\", \"results\": [";
+	bool first = true;
+	passed = true;
+	for (PlayzerXEncoderKernel kernel : kernels)
+	{
+		if (!SetEncoderKernel(kernel)) continue;
+		for (int f = 0; f < 3; f++)
+		{
+			// Every sample count up to a few vector widths, at odd offsets, must match the
+			// scalar bytes exactly
+			bool identical = true;
+			for (unsigned int count = 0; count <= 300 && identical; count++)
+			{
+				unsigned int offset = count % 5;
+				SetEncoderKernel(PlayzerXEncoderKernel::SCALAR);
+				unsigned int n = Encode(formats[f], &x[offset], &y[offset], &m[offset], count,
+										&reference[0]);
+				SetEncoderKernel(kernel);
+				identical = Encode(formats[f], &x[offset], &y[offset], &m[offset], count,
+								   &bytes[0]) == n &&
+							!memcmp(&bytes[0], &reference[0], n);
+			}
+			passed = passed && identical;
+
+			std::vector<double> times;
+			for (int r = 0; r < repetitions; r++)
+			{
+				double start = NowSeconds();
+				Encode(formats[f], &x[0], &y[0], &m[0], numSamples, &bytes[0]);
+				times.push_back(NowSeconds() - start);
+			}
+			double median = Percentile(times, 0.5);
+			json << (first ? "" : ", ") << "{\"kernel\": \"" << KernelName(kernel)
+				 << "\", \"format\": \"" << formatNames[f]
+				 << "\", \"samples_per_second\": " << Number(numSamples / median)
+				 << ", \"best_samples_per_second\": " << Number(numSamples / Percentile(times, 0))
+				 << ", \"identical_to_scalar\": " << (identical ? "true" : "false") << "}";
+			first = false;
+		}
+	}
+	SetEncoderKernel(defaultKernel);
+	json << "], \"all_identical\": " << (passed ? "true" : "false") << "}";
+	return json.str();
+}
+
+/** \brief Creates \p path and its missing parents. */
+void MakeDirectories(const std::string& path)
+{
+	for (size_t slash = path.find('/', 1); slash != std::string::npos;
+		 slash = path.find('/', slash + 1))
+		mkdir(path.substr(0, slash).c_str(), 0755);
+	mkdir(path.c_str(), 0755);
+}
+
+/** \brief Writes a sysfs attribute of the fake tree. */
+void WriteAttribute(const std::string& path, const std::string& value)
+{
+	std::ofstream(path.c_str()) << value << "\n";
+}
+
+/** \brief Removes a directory tree without following its links. */
+void RemoveTree(const std::string& path)
+{
+	DIR* dir = opendir(path.c_str());
+	if (dir != nullptr)
+	{
+		for (struct dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+		{
+			std::string name = entry->d_name;
+			if (name == "." || name == "..") continue;
+			struct stat st;
+			std::string child = path + "/" + name;
+			if (lstat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+				RemoveTree(child);
+			else
+				unlink(child.c_str());
+		}
+		closedir(dir);
+	}
+	rmdir(path.c_str());
+}
+
+/**
+ * \brief Runs the serial port enumerator against a fake sysfs tree, checks ports and filter.
+ *
+ * The tree holds a USB serial converter (usb-serial port below the interface, as ftdi_sio
+ * creates it) for each of two products, a CDC ACM port (tty below the interface), a UART with
+ * hardware, a legacy UART reporting type 0 and a pseudo terminal without device link.
+ */
+std::string PortsSuite(bool& passed)
+{
+	char rootTemplate[] = "/tmp/playzerx-sysfs-XXXXXX";
+	if (mkdtemp(rootTemplate) == nullptr) return std::string();
+	const std::string root = rootTemplate;
+	const std::string usb = root + "/devices/pci0000:00/0000:00:14.0/usb1";
+	MakeDirectories(root + "/class/tty");
+	MakeDirectories(root + "/bus/usb-serial/drivers/ftdi_sio");
+	MakeDirectories(root + "/bus/usb/drivers/cdc_acm");
+	MakeDirectories(root + "/bus/pnp/drivers/serial");
+	MakeDirectories(root + "/bus/platform/drivers/serial8250");
+
+	struct FakeUsbSerial
+	{
+		const char* bus;
+		const char* name;
+		const char* vendorId;
+		const char* productId;
+		const char* serial;
+	};
+	const FakeUsbSerial converters[] = {{"1-2", "ttyUSB10", "0403", "6015", "DN04ABCD"},
+										{"1-3", "ttyUSB2", "0403", "6001", "A50285BI"}};
+	for (const FakeUsbSerial& converter : converters)
+	{
+		std::string device = usb + "/" + converter.bus;
+		std::string port = device + "/" + converter.bus + ":1.0/" + converter.name;
+		MakeDirectories(port + "/tty/" + converter.name);
+		WriteAttribute(device + "/idVendor", converter.vendorId);
+		WriteAttribute(device + "/idProduct", converter.productId);
+		WriteAttribute(device + "/serial", converter.serial);
+		WriteAttribute(device + "/manufacturer", "FTDI");
+		WriteAttribute(device + "/product", "FT230X Basic UART");
+		symlink(port.c_str(), (port + "/tty/" + converter.name + "/device").c_str());
+		symlink((root + "/bus/usb-serial/drivers/ftdi_sio").c_str(), (port + "/driver").c_str());
+		symlink((port + "/tty/" + converter.name).c_str(),
+				(root + "/class/tty/" + converter.name).c_str());
+	}
+
+	std::string acmDevice = usb + "/1-4", acmInterface = acmDevice + "/1-4:1.0";
+	MakeDirectories(acmInterface + "/tty/ttyACM0");
+	WriteAttribute(acmDevice + "/idVendor", "2e8a");
+	WriteAttribute(acmDevice + "/idProduct", "000a");
+	WriteAttribute(acmDevice + "/manufacturer", "Mirrorcle");
+	WriteAttribute(acmDevice + "/product", "PlayzerX");
+	symlink(acmInterface.c_str(), (acmInterface + "/tty/ttyACM0/device").c_str());
+	symlink((root + "/bus/usb/drivers/cdc_acm").c_str(), (acmInterface + "/driver").c_str());
+	symlink((acmInterface + "/tty/ttyACM0").c_str(), (root + "/class/tty/ttyACM0").c_str());
+
+	// Name, device, driver and port type of each UART
+	const char* uarts[][4] = {
+		{"ttyS1", "/devices/pnp0/00:05", "/bus/pnp/drivers/serial", "4"},
+		{"ttyS0", "/devices/platform/serial8250", "/bus/platform/drivers/serial8250", "0"}};
+	for (const auto& uart : uarts)
+	{
+		std::string device = root + uart[1], tty = device + "/tty/" + uart[0];
+		MakeDirectories(tty);
+		WriteAttribute(tty + "/type", uart[3]);
+		symlink(device.c_str(), (tty + "/device").c_str());
+		symlink((root + uart[2]).c_str(), (device + "/driver").c_str());
+		symlink(tty.c_str(), (root + "/class/tty/" + uart[0]).c_str());
+	}
+
+	MakeDirectories(root + "/devices/virtual/tty/ptmx");
+	symlink((root + "/devices/virtual/tty/ptmx").c_str(), (root + "/class/tty/ptmx").c_str());
+
+	struct ExpectedPort
+	{
+		const char* name;
+		const char* driver;
+		bool usb;
+		unsigned short vendorId, productId;
+		const char* serial;
+		bool candidate;
+	};
+	// Sorted by length, then name; only the first converter and the ACM port pass the filter
+	const ExpectedPort expected[] = {
+		{"ttyS1", "serial", false, 0, 0, "", false},
+		{"ttyACM0", "cdc_acm", true, 0x2e8a, 0x000a, "", true},
+		{"ttyUSB2", "ftdi_sio", true, 0x0403, 0x6001, "A50285BI", false},
+		{"ttyUSB10", "ftdi_sio", true, 0x0403, 0x6015, "DN04ABCD", true}};
+	const std::vector<PlayzerXUsbId> filter = {{0x0403, 0x6015}, {0x2e8a, 0}};
+
+	std::vector<PlayzerXPortInfo> ports;
+	passed = EnumerateSerialPorts(ports, root, "/fakedev") &&
+			 ports.size() == sizeof(expected) / sizeof(expected[0]);
+	std::ostringstream json;
+	json << "{\"ports\": [";
+	for (size_t i = 0; i < ports.size(); i++)
+	{
+		const PlayzerXPortInfo& port = ports[i];
+		bool candidate = IsCandidatePort(port, filter);
+		if (passed)
+		{
+			const ExpectedPort& e = expected[i];
+			passed = port.PortName == e.name && port.DevicePath == "/fakedev/" + port.PortName &&
+					 port.Driver == e.driver && port.IsUSB == e.usb &&
+					 port.VendorId == e.vendorId && port.ProductId == e.productId &&
+					 port.SerialNumber == e.serial && candidate == e.candidate &&
+					 IsCandidatePort(port, std::vector<PlayzerXUsbId>()) == e.usb;
+		}
+		char ids[16];
+		snprintf(ids, sizeof(ids), "%04x:%04x", port.VendorId, port.ProductId);
+		json << (i ? ", " : "") << "{\"name\": \"" << port.PortName << "\", \"driver\": \""
+			 << port.Driver << "\", \"usb\": " << (port.IsUSB ? "true" : "false")
+			 << ", \"id\": \"" << ids << "\", \"candidate\": " << (candidate ? "true" : "false")
+			 << "}";
+	}
+	json << "], \"as_expected\": " << (passed ? "true" : "false") << "}";
+	RemoveTree(root);
+	return json.str();
+}
+
+/** \brief Time taken by a single sample SendDataXYM(), without and with write coalescing. */
+std::string LatencySuite(PlayzerX& playzer)
+{
+	const int iterations = quickRun ? 200 : 2000;
+	playzer.SetSampleRate(50000);
+	std::ostringstream json;
+	json << "{\"iterations\": " << iterations;
+	// One write per call, then the same calls gathered by write coalescing
+	for (int coalesced = 0; coalesced < 2; coalesced++)
+	{
+		playzer.SetWriteCoalescing(coalesced ? 64 : 0, 1000);
+		std::vector<double> times;
+		for (int i = 0; i < iterations; i++)
+		{
+			float angle = (float)(2 * M_PI * i / 100);
+			double start = NowSeconds();
+			playzer.SendDataXYM(0.5f * cosf(angle), 0.5f * sinf(angle), 255);
+			times.push_back((NowSeconds() - start) * 1e6);
+		}
+		playzer.FlushCoalescedSamples();
+		std::string prefix = coalesced ? "coalesced_" : "";
+		json << ", \"" << prefix << "median_us\": " << Number(Percentile(times, 0.5))
+			 << ", \"" << prefix << "p99_us\": " << Number(Percentile(times, 0.99))
+			 << ", \"" << prefix << "max_us\": " << Number(Percentile(times, 1));
+	}
+	playzer.SetWriteCoalescing(0);
+	json << "}";
+	return json.str();
+}
+
+/** \brief Rate sustained by the streaming engine, as seen by the emulated device. */
+std::string StreamingSuite(PlayzerX& playzer, BenchDevice& port)
+{
+	const unsigned int sampleRate = 10000;
+	const double warmup = 1.0, duration = quickRun ? 2.0 : 10.0;
+	playzer.SetSampleRate(sampleRate);
+	playzer.ClearData();
+
+	const unsigned int blockSize = 1000;
+	std::vector<float> x(blockSize), y(blockSize);
+	std::vector<unsigned char> m(blockSize, 255);
+	for (unsigned int i = 0; i < blockSize; i++)
+	{
+		x[i] = 0.5f * cosf((float)(2 * M_PI * i / blockSize));
+		y[i] = 0.5f * sinf((float)(2 * M_PI * i / blockSize));
+	}
+
+	playzer.StartStreaming(5000);
+	double start = NowSeconds(), measureStart = 0;
+	PlayzerXSimulatorStats before = port.GetStats();
+	bool measuring = false;
+	unsigned int offset = 0;
+	while (NowSeconds() - start < warmup + duration)
+	{
+		// Keep the host queue topped up
+		while (playzer.GetStreamQueuedSamples() < 20000)
+		{
+			unsigned int n = playzer.PushDataXYM(&x[offset], &y[offset], &m[offset],
+												 blockSize - offset);
+			offset = (offset + n) % blockSize;
+			if (n == 0) break;
+		}
+		if (!measuring && NowSeconds() - start >= warmup)
+		{
+			before = port.GetStats();
+			playzer.ResetStats();
+			measureStart = NowSeconds();
+			measuring = true;
+		}
+		Sleep(2);
+	}
+	PlayzerXSimulatorStats after = port.GetStats();
+	PlayzerXStats host = playzer.GetStats();
+	double elapsed = NowSeconds() - measureStart;
+	playzer.StopStreaming();
+
+	std::ostringstream json;
+	json << "{\"sample_rate\": " << sampleRate << ", \"seconds\": " << Number(elapsed)
+		 << ", \"played_per_second\": "
+		 << Number((after.SamplesPlayed - before.SamplesPlayed) / elapsed)
+		 << ", \"received_per_second\": "
+		 << Number((after.SamplesReceived - before.SamplesReceived) / elapsed)
+		 << ", \"underruns\": " << (after.Underruns - before.Underruns)
+		 << ", \"dropped\": " << (after.SamplesDropped - before.SamplesDropped)
+		 << ", \"framing_errors\": " << (after.FramingErrors - before.FramingErrors)
+		 << ", \"host_write_calls\": " << host.WriteCalls
+		 << ", \"host_partial_writes\": " << host.PartialWrites
+		 << ", \"host_write_time_ms\": " << Number(host.WriteTime * 1e-6)
+		 << ", \"host_min_buffer_level\": " << host.MinBufferLevel << "}";
+	return json.str();
+}
+
+/**
+ * \brief How far from the requested level WaitForBufferLevel() returns.
+ *
+ * The error is the requested level minus the device level at return: positive values are
+ * overshoot (returned late, the buffer drained further than needed), negative values are
+ * undershoot (returned early).
+ */
+std::string WaitSuite(PlayzerX& playzer, BenchDevice& port)
+{
+	const unsigned int sampleRate = 50000, fillSamples = 30000;
+	const int targets[] = {20000, 10000, 2000};
+	const int trials = quickRun ? 1 : 5;
+	playzer.SetSampleRate(sampleRate);
+
+	std::vector<float> x(fillSamples, 0.f), y(fillSamples, 0.f);
+	std::vector<unsigned char> m(fillSamples, 255);
+
+	std::ostringstream json;
+	json << "{\"sample_rate\": " << sampleRate << ", \"results\": [";
+	for (int t = 0; t < 3; t++)
+	{
+		std::vector<double> errors;
+		for (int trial = 0; trial < trials; trial++)
+		{
+			playzer.ClearData();
+			playzer.SendDataXYM(&x[0], &y[0], &m[0], fillSamples);
+			playzer.WaitForBufferLevel(targets[t]);
+			int level = (int)port.GetStats().SamplesRemaining;
+			errors.push_back((targets[t] - level) * 1e6 / sampleRate);
+		}
+		json << (t ? ", " : "") << "{\"target\": " << targets[t]
+			 << ", \"median_error_us\": " << Number(Percentile(errors, 0.5))
+			 << ", \"max_overshoot_us\": " << Number(std::max(0.0, Percentile(errors, 1)))
+			 << ", \"max_undershoot_us\": " << Number(std::max(0.0, -Percentile(errors, 0)))
+			 << "}";
+	}
+	json << "]}";
+	return json.str();
+}
+
+/** \brief Time to connect to the emulated device and to search the system for devices. */
+std::string ConnectSuite(BenchDevice& port)
+{
+	const int iterations = quickRun ? 2 : 5;
+	std::vector<double> times;
+	bool connected = true;
+	for (int i = 0; i < iterations; i++)
+	{
+		PlayzerX playzer;
+		double start = NowSeconds();
+		port.Connect(playzer);
+		times.push_back((NowSeconds() - start) * 1e3);
+		connected = connected && !playzer.HasError();
+		playzer.DisconnectDevice();
+	}
+
+	PlayzerX playzer;
+	PlayzerXAvailableDevices table;
+	double start = NowSeconds();
+	playzer.GetAvailableDevices(table);
+	double discovery = (NowSeconds() - start) * 1e3;
+
+	std::ostringstream json;
+	json << "{\"connect_median_ms\": " << Number(Percentile(times, 0.5))
+		 << ", \"connect_max_ms\": " << Number(Percentile(times, 1))
+		 << ", \"connected\": " << (connected ? "true" : "false")
+		 << ", \"discovery_ms\": " << Number(discovery)
+		 << ", \"devices_found\": " << table.NumDevices << "}";
+	return json.str();
+}
+
+/** \brief CPU time of every thread of the process by thread id, in seconds. */
+std::map<int, double> ThreadCpuTimes()
+{
+	std::map<int, double> times;
+	DIR* tasks = opendir("/proc/self/task");
+	if (tasks == nullptr) return times;
+	while (struct dirent* entry = readdir(tasks))
+	{
+		if (entry->d_name[0] == '.') continue;
+		std::ifstream file(std::string("/proc/self/task/") + entry->d_name + "/stat");
+		std::string stat((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		// utime and stime are the 12th and 13th fields after the parenthesized name
+		std::istringstream fields(stat.substr(stat.rfind(')') + 2));
+		std::string field;
+		double ticks = 0;
+		for (int i = 0; i < 13 && fields >> field; i++)
+			if (i >= 11) ticks += atof(field.c_str());
+		times[atoi(entry->d_name)] = ticks / sysconf(_SC_CLK_TCK);
+	}
+	closedir(tasks);
+	return times;
+}
+
+/** \brief CPU time of the process including finished threads, in seconds. */
+double ProcessCpuTime()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+		   (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+/**
+ * \brief Streams to all devices at once, through the built-in transports or \p uring.
+ *
+ * Library CPU is the time of all threads but the emulators and the main thread, which only
+ * pushes samples, in percent of one core.
+ */
+std::string RackRun(std::vector<std::unique_ptr<PlayzerXSimulatorPort>>& devices,
+					const std::map<int, double>& emulatorThreads, PlayzerXUring* uring)
+{
+	const unsigned int sampleRate = 8000;
+	const double warmup = 1.0, duration = quickRun ? 2.0 : 10.0;
+	std::vector<std::unique_ptr<PlayzerX>> playzers;
+	for (auto& device : devices)
+	{
+		playzers.emplace_back(new PlayzerX());
+		PlayzerX& playzer = *playzers.back();
+		if (uring) playzer.SetTransportFactory(uring->GetTransportFactory());
+		playzer.ConnectDevice(device->GetPortName());
+		if (playzer.HasError()) return std::string();
+		playzer.SetSampleRate(sampleRate);
+		playzer.ClearData();
+	}
+
+	const unsigned int blockSize = 1000;
+	std::vector<float> x(blockSize), y(blockSize);
+	std::vector<unsigned char> m(blockSize, 255);
+	for (unsigned int i = 0; i < blockSize; i++)
+	{
+		x[i] = 0.5f * cosf((float)(2 * M_PI * i / blockSize));
+		y[i] = 0.5f * sinf((float)(2 * M_PI * i / blockSize));
+	}
+	std::vector<unsigned int> offsets(devices.size(), 0);
+	for (auto& playzer : playzers) playzer->StartStreaming(5000);
+
+	double start = NowSeconds(), measureStart = 0, cpuBefore = 0;
+	std::vector<PlayzerXSimulatorStats> before(devices.size());
+	std::map<int, double> threadsBefore;
+	PlayzerXUringStats uringBefore = {};
+	bool measuring = false;
+	while (NowSeconds() - start < warmup + duration)
+	{
+		for (size_t d = 0; d < playzers.size(); d++)
+		{
+			while (playzers[d]->GetStreamQueuedSamples() < 20000)
+			{
+				unsigned int& offset = offsets[d];
+				unsigned int n = playzers[d]->PushDataXYM(&x[offset], &y[offset], &m[offset],
+														  blockSize - offset);
+				offset = (offset + n) % blockSize;
+				if (n == 0) break;
+			}
+		}
+		if (!measuring && NowSeconds() - start >= warmup)
+		{
+			for (size_t d = 0; d < devices.size(); d++) before[d] = devices[d]->GetStats();
+			if (uring) uringBefore = uring->GetStats();
+			threadsBefore = ThreadCpuTimes();
+			cpuBefore = ProcessCpuTime();
+			measureStart = NowSeconds();
+			measuring = true;
+		}
+		Sleep(2);
+	}
+	double cpu = ProcessCpuTime() - cpuBefore;
+	std::map<int, double> threadsAfter = ThreadCpuTimes();
+	double elapsed = NowSeconds() - measureStart;
+	PlayzerXUringStats uringAfter = {};
+	if (uring) uringAfter = uring->GetStats();
+	double played = 0;
+	unsigned long long underruns = 0, framingErrors = 0;
+	for (size_t d = 0; d < devices.size(); d++)
+	{
+		PlayzerXSimulatorStats after = devices[d]->GetStats();
+		played += after.SamplesPlayed - before[d].SamplesPlayed;
+		underruns += after.Underruns - before[d].Underruns;
+		framingErrors += after.FramingErrors - before[d].FramingErrors;
+	}
+	for (auto& playzer : playzers)
+	{
+		playzer->StopStreaming();
+		playzer->DisconnectDevice();
+	}
+
+	// Emulator and main threads live through the whole run
+	for (const auto& thread : emulatorThreads)
+		if (threadsAfter.count(thread.first) && threadsBefore.count(thread.first))
+			cpu -= threadsAfter[thread.first] - threadsBefore[thread.first];
+
+	std::ostringstream json;
+	json << "{\"played_per_second\": " << Number(played / elapsed)
+		 << ", \"underruns\": " << underruns << ", \"framing_errors\": " << framingErrors
+		 << ", \"library_cpu_percent\": " << Number(100 * cpu / elapsed);
+	if (uring)
+	{
+		double enterCalls = (double)(uringAfter.EnterCalls - uringBefore.EnterCalls);
+		json << ", \"enter_calls_per_second\": " << Number(enterCalls / elapsed)
+			 << ", \"submissions_per_enter\": "
+			 << Number((uringAfter.Submissions - uringBefore.Submissions) /
+					   std::max(1.0, enterCalls))
+			 << ", \"registered_buffers\": "
+			 << (uringAfter.RegisteredBuffers ? "true" : "false");
+	}
+	json << "}";
+	return json.str();
+}
+
+/**
+ * \brief Many devices streaming at once, with the built-in transports and with io_uring.
+ *
+ * Always on pseudo terminals, io_uring needs file descriptors. The io_uring run is skipped if
+ * the library was built without it.
+ */
+std::string RackSuite(unsigned int baudRate)
+{
+	std::vector<std::unique_ptr<PlayzerXSimulatorPort>> devices;
+	for (unsigned int d = 0; d < numDevices; d++)
+	{
+		devices.emplace_back(new PlayzerXSimulatorPort());
+		if (!devices.back()->Start(false, baudRate)) return std::string();
+	}
+	std::map<int, double> emulatorThreads = ThreadCpuTimes();
+
+	std::string posix = RackRun(devices, emulatorThreads, nullptr);
+	std::string uringResult = "null";
+	PlayzerXUring uring(numDevices);
+	if (uring.IsAvailable()) uringResult = RackRun(devices, emulatorThreads, &uring);
+	if (posix.empty() || uringResult.empty()) return std::string();
+
+	std::ostringstream json;
+	json << "{\"devices\": " << numDevices << ", \"sample_rate\": 8000, \"posix\": " << posix
+		 << ", \"io_uring\": " << uringResult << "}";
+	return json.str();
+}
+
+/**
+ * \brief Streams the same pattern to all devices of a group, whose clocks differ by up to
+ * 2 * \p drift ppm.
+ *
+ * The phase spread is the largest difference between the positions of the devices in their
+ * queues, from the samples the emulators played less the corrections of the group, so it is
+ * exact to the corrections still in the device buffers.
+ */
+std::string GroupRun(std::vector<std::unique_ptr<PlayzerXSimulatorPort>>& devices, double drift,
+					 bool correct)
+{
+	const unsigned int sampleRate = 8000;
+	// Corrections start once the buffers are filled, which takes a few seconds at this rate
+	const double duration = quickRun ? 8.0 : 15.0;
+	std::vector<std::unique_ptr<PlayzerX>> playzers;
+	PlayzerXGroup group;
+	for (size_t d = 0; d < devices.size(); d++)
+	{
+		double ppm = (devices.size() > 1) ? drift * (2.0 * d / (devices.size() - 1) - 1.0) : 0;
+		devices[d]->SetClockDrift(ppm);
+		playzers.emplace_back(new PlayzerX());
+		PlayzerX& playzer = *playzers.back();
+		playzer.ConnectDevice(devices[d]->GetPortName());
+		if (playzer.HasError()) return std::string();
+		playzer.SetSampleRate(sampleRate);
+		group.AddDevice(&playzer);
+	}
+
+	const unsigned int blockSize = 1000;
+	std::vector<float> x(blockSize), y(blockSize);
+	std::vector<unsigned char> m(blockSize, 255);
+	for (unsigned int i = 0; i < blockSize; i++)
+	{
+		x[i] = 0.5f * cosf((float)(2 * M_PI * i / blockSize));
+		y[i] = 0.5f * sinf((float)(2 * M_PI * i / blockSize));
+	}
+	std::vector<unsigned int> offsets(devices.size(), 0);
+	std::vector<unsigned long long> played(devices.size());
+	for (size_t d = 0; d < devices.size(); d++) played[d] = devices[d]->GetStats().SamplesPlayed;
+	group.SetPhaseCorrection(correct);
+	if (!group.Start(8000)) return std::string();
+
+	auto spread = [&]() {
+		double low = 0, high = 0;
+		for (size_t d = 0; d < devices.size(); d++)
+		{
+			double position = (double)(devices[d]->GetStats().SamplesPlayed - played[d]) -
+							  (double)group.GetPhaseCorrection((unsigned int)d);
+			low = (d == 0) ? position : std::min(low, position);
+			high = (d == 0) ? position : std::max(high, position);
+		}
+		return high - low;
+	};
+
+	// The first spread is taken once the first writes have surely arrived
+	double start = NowSeconds(), released = 0, nextSample = 0;
+	double startSpread = -1, maxSpread = 0, lastSpread = 0;
+	unsigned long long underruns = 0;
+	std::vector<unsigned long long> underrunsBefore(devices.size());
+	while (released == 0 || NowSeconds() - released < duration)
+	{
+		for (size_t d = 0; d < playzers.size(); d++)
+		{
+			while (playzers[d]->GetStreamQueuedSamples() < 20000)
+			{
+				unsigned int& offset = offsets[d];
+				unsigned int n = playzers[d]->PushDataXYM(&x[offset], &y[offset], &m[offset],
+														  blockSize - offset);
+				offset = (offset + n) % blockSize;
+				if (n == 0) break;
+			}
+		}
+		if (released == 0 && group.IsReleased())
+		{
+			released = NowSeconds();
+			nextSample = released + 0.5;
+			for (size_t d = 0; d < devices.size(); d++)
+				underrunsBefore[d] = devices[d]->GetStats().Underruns;
+		}
+		else if (released == 0 && NowSeconds() - start > 5.0)
+			return std::string();
+		else if (released > 0 && NowSeconds() >= nextSample)
+		{
+			lastSpread = spread();
+			if (startSpread < 0) startSpread = lastSpread;
+			maxSpread = std::max(maxSpread, lastSpread);
+			nextSample += 0.1;
+		}
+		Sleep(2);
+	}
+	for (size_t d = 0; d < devices.size(); d++)
+		underruns += devices[d]->GetStats().Underruns - underrunsBefore[d];
+	long long corrections = 0;
+	for (size_t d = 0; d < devices.size(); d++)
+		corrections += std::llabs(group.GetPhaseCorrection((unsigned int)d));
+	group.Stop();
+	for (auto& playzer : playzers) playzer->DisconnectDevice();
+	for (auto& device : devices) device->SetClockDrift(0);
+
+	std::ostringstream json;
+	json << "{\"start_spread\": " << Number(startSpread) << ", \"max_spread\": "
+		 << Number(maxSpread) << ", \"final_spread\": " << Number(lastSpread)
+		 << ", \"corrections\": " << corrections << ", \"underruns\": " << underruns << "}";
+	return json.str();
+}
+
+/** \brief Phase spread of a group of devices that drift apart, with and without correction. */
+std::string GroupSuite(unsigned int baudRate)
+{
+	const double drift = 100.0;
+	std::vector<std::unique_ptr<PlayzerXSimulatorPort>> devices;
+	for (unsigned int d = 0; d < numDevices; d++)
+	{
+		devices.emplace_back(new PlayzerXSimulatorPort());
+		if (!devices.back()->Start(false, baudRate)) return std::string();
+	}
+
+	std::string uncorrected = GroupRun(devices, drift, false);
+	std::string corrected = GroupRun(devices, drift, true);
+	if (uncorrected.empty() || corrected.empty()) return std::string();
+
+	std::ostringstream json;
+	json << "{\"devices\": " << numDevices << ", \"sample_rate\": 8000, \"drift_ppm\": "
+		 << Number(drift) << ", \"uncorrected\": " << uncorrected
+		 << ", \"corrected\": " << corrected << "}";
+	return json.str();
+}
+
+void PrintUsage()
+{
+	printf("Usage: playzerx-bench [options]\n"
+		   "  --suite NAME   Run only this suite (encoder, latency, streaming, wait, connect,\n"
+		   "                 rack, group, ports); may be repeated, all suites run by default\n"
+		   "  --output FILE  Write the JSON results to FILE instead of the standard output\n"
+		   "  --baud N       Baud rate of the emulated wire (default 921600, 0 for no limit)\n"
+		   "  --transport T  pty (default) or loopback, an in-memory device without wire\n"
+		   "  --devices N    Number of emulated devices of the rack and group suites (default 4)\n"
+		   "  --quick        Fewer iterations, for smoke tests\n");
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> suites;
+	std::string outputFile;
+	unsigned int baudRate = 921600;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--suite") && i + 1 < argc)
+			suites.push_back(argv[++i]);
+		else if (!strcmp(argv[i], "--output") && i + 1 < argc)
+			outputFile = argv[++i];
+		else if (!strcmp(argv[i], "--baud") && i + 1 < argc)
+			baudRate = (unsigned int)strtoul(argv[++i], 0, 10);
+		else if (!strcmp(argv[i], "--transport") && i + 1 < argc &&
+				 (!strcmp(argv[i + 1], "pty") || !strcmp(argv[i + 1], "loopback")))
+			useLoopback = !strcmp(argv[++i], "loopback");
+		else if (!strcmp(argv[i], "--devices") && i + 1 < argc)
+			numDevices = (unsigned int)strtoul(argv[++i], 0, 10);
+		else if (!strcmp(argv[i], "--quick"))
+			quickRun = true;
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (suites.empty()) suites = {"encoder", "latency", "streaming", "wait", "connect", "rack",
+										  "group", "ports"};
+
+#ifdef __OPTIMIZE__
+	const bool optimized = true;
+#else
+	const bool optimized = false;
+	fprintf(stderr, "Warning: not an optimized build, configure with -DCMAKE_BUILD_TYPE=Release\n");
+#endif
+
+	bool passed = true;
+	std::ostringstream json;
+	PlayzerX playzer;
+	json << "{\n  \"version\": \"" << playzer.GetAPIVersion() << "\",\n  \"timestamp\": "
+		 << (long long)time(0) << ",\n  \"optimized_build\": " << (optimized ? "true" : "false")
+		 << ",\n  \"baud_rate\": " << baudRate << ",\n  \"transport\": \""
+		 << (useLoopback ? "loopback" : "pty") << "\"";
+
+	for (const std::string& suite : suites)
+	{
+		fprintf(stderr, "Running %s...\n", suite.c_str());
+		std::string result;
+		if (suite == "encoder")
+		{
+			bool identical;
+			result = EncoderSuite(identical);
+			passed = passed && identical;
+		}
+		else if (suite == "ports")
+		{
+			bool expected;
+			result = PortsSuite(expected);
+			passed = passed && expected;
+		}
+		else if (suite == "connect")
+		{
+			BenchDevice port;
+			if (port.Start(baudRate)) result = ConnectSuite(port);
+		}
+		else if (suite == "rack")
+			result = RackSuite(baudRate);
+		else if (suite == "group")
+			result = GroupSuite(baudRate);
+		else if (suite == "latency" || suite == "streaming" || suite == "wait")
+		{
+			// The wait suite fills the buffer without wire limit to keep the trials short
+			BenchDevice port;
+			if (port.Start((suite == "wait") ? 0 : baudRate))
+			{
+				port.Connect(playzer);
+				if (!playzer.HasError())
+					result = (suite == "latency")	 ? LatencySuite(playzer)
+							 : (suite == "streaming") ? StreamingSuite(playzer, port)
+													  : WaitSuite(playzer, port);
+				playzer.DisconnectDevice();
+			}
+		}
+		else
+		{
+			fprintf(stderr, "Unknown suite %s\n", suite.c_str());
+			PrintUsage();
+			return 1;
+		}
+		if (result.empty())
+		{
+			fprintf(stderr, "Suite %s could not run\n", suite.c_str());
+			passed = false;
+			result = "null";
+		}
+		json << ",\n  \"" << suite << "\": " << result;
+	}
+	json << "\n}\n";
+
+	if (outputFile.empty())
+		fputs(json.str().c_str(), stdout);
+	else
+		std::ofstream(outputFile.c_str()) << json.str();
+
+	return passed ? 0 : 2;
+}
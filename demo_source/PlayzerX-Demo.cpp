@@ -346,14 +346,17 @@ void ScanningDemo()
 		printf(TXT_YEL
 			   "Cycle: %d. Press any key to change waveform or ESC to exit demo...\n" TXT_RST,
 			   ++j);
+		// Encode the frame once, it is repeated until the next key press
+		EncodedFrame frame;
+		if (!rgbCapable)
+			frame.SetDataXYM(x, y, m, npts);
+		else
+			frame.SetDataXYRGB(x, y, r, g, b, npts);
 		do
 		{
 			// This call will download the buffer of data to the
 			// controller and run it when existing frame ends
-			if (!rgbCapable)
-				playzer->SendDataXYM(x, y, m, npts, 10000);
-			else
-				playzer->SendDataXYRGB(x, y, r, g, b, npts, 10000);
+			playzer->SendFrame(frame, 10000);
 		} while (!_kbhit());
 	}
 
@@ -473,11 +476,13 @@ void ImportFileDemo()
 
 	printf(TXT_YEL "Press any key to stop the waveform and device scanning...\n" TXT_RST);
 
+	// The frame is repeated unchanged, so encode it for the controller only once
+	EncodedFrame frame(x, y, m, npts);
 	do
 	{
 		// This call will download the buffer of data to the
 		// controller and run it when existing frame ends
-		playzer->SendDataXYM(x, y, m, npts, 10000);
+		playzer->SendFrame(frame, 10000);
 
 	} while (!_kbhit());  // wait for a keypress in console
 	_getch();			  // consume the pressed key
@@ -625,8 +630,8 @@ void BasicCircle()
 	unsigned char m;
 
 	printf("\nThis demo tests speed of sending a single sample with each SendData call.\n");
-	printf("There are two options tested here, XYM sample with 9 bytes/sample load\n");
-	printf("And XY sample with 8 bytes/sample load\n");
+	printf("There are three options tested here, XYM sample with 9 bytes/sample load,\n");
+	printf("XY sample with 8 bytes/sample load and XYM samples with write coalescing\n");
 	printf("Press any key to EXIT the loop earlier\n\n");
 
 	// setting sample rate here but it is not critical since effective
@@ -665,6 +670,24 @@ void BasicCircle()
 		}
 	}
 
+	printf("Loop for XYM samples with write coalescing to form 12 circles running...\n");
+	// Single samples are now gathered into writes of up to 64 samples, each sample
+	// held back for 1 ms at most
+	playzer->SetWriteCoalescing(64, 1000);
+	for (int i = 0; i < 12 * 720; i++)
+	{
+		x = cos((float)i * 2.f * M_PI / 720);
+		y = sin((float)i * 2.f * M_PI / 720);
+		m = (0.5f + 0.5f * sin(((float)i / 3) * 2.f * M_PI / 720)) * 255u;
+		playzer->SendDataXYM(x, y, m);  // returns right away, the sample is written later
+		if (_kbhit())
+		{
+			_getch();
+			break;
+		}
+	}
+	playzer->SetWriteCoalescing(0);  // writes what is left and restores single sample writes
+
 	// let's shut off the beam and point to origin now
 	playzer->ClearData();
 }
@@ -20,15 +20,33 @@
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 /**
  * \brief Global buffer for text debug/log messages.
- * \note This global buffer is shared across the application.
+ * \note This global buffer is shared across the application, it is defined in PlayzerX.cpp.
  */
-char scvtext[100];
+extern char scvtext[100];
 
 #include "MTISerial.h"
 #include "PlayzerXDefinitions.h"
+#include "PlayzerXRing.h"
+#include "PlayzerXMailbox.h"
+#include "PlayzerXTelemetry.h"
+#include "PlayzerXEncoder.h"
+#include "PlayzerXEstimator.h"
+#include "PlayzerXPorts.h"
+#include "PlayzerXStats.h"
+#include "PlayzerXTransaction.h"
+#include "PlayzerXTcpPort.h"
+#include "PlayzerXTransport.h"
+#include "PlayzerXUring.h"
 
 namespace playzerx
 {
@@ -37,27 +55,52 @@ namespace playzerx
  * \brief Holds details for all discovered PlayzerX devices on the system.
  *
  * Objects of this class store metadata for each detected device, including the
- * device's name, firmware name, data format, and COM port information.
+ * device's name, firmware name, data format, and COM port information. Entry \c i of every
+ * list describes the same device; the lists hold \c NumDevices entries each.
  */
 class PlayzerXAvailableDevices
 {
    public:
-	/** \brief Read-only array of device names. */
-	std::string DeviceName[MTI_MAXDEVICES];
-	/** \brief Read-only array of firmware names. */
-	std::string FirmwareName[MTI_MAXDEVICES];
-	/** \brief Read-only array of data formats (e.g., "XYM" or "XYRGB"). */
-	std::string DataFormat[MTI_MAXDEVICES];
-	/** \brief Read-only array of UART baud rates for each device. */
-	unsigned int USARTBaudRate[MTI_MAXDEVICES];
-	/** \brief Read-only array of COM port numbers. */
-	unsigned int CommPortNumber[MTI_MAXDEVICES];
-	/** \brief Read-only array of COM port names (e.g., "COM3", "/dev/ttyUSB0"). */
-	std::string CommPortName[MTI_MAXDEVICES];
+	/** \brief Read-only list of device names. */
+	std::vector<std::string> DeviceName;
+	/** \brief Read-only list of firmware names. */
+	std::vector<std::string> FirmwareName;
+	/** \brief Read-only list of data formats (e.g., "XYM" or "XYRGB"). */
+	std::vector<std::string> DataFormat;
+	/** \brief Read-only list of UART baud rates for each device. */
+	std::vector<unsigned int> USARTBaudRate;
+	/** \brief Read-only list of COM port numbers. */
+	std::vector<unsigned int> CommPortNumber;
+	/** \brief Read-only list of COM port names (e.g., "COM3", "/dev/ttyUSB0"). */
+	std::vector<std::string> CommPortName;
 	/** \brief Number of devices detected. */
 	unsigned int NumDevices;
 };
 
+/**
+ * \struct PlayzerXSample
+ * \brief A single sample queued to the streaming engine.
+ *
+ * Only the fields used by \c format are sent: \c m for XYM, \c r, \c g, \c b for XYRGB.
+ */
+struct PlayzerXSample
+{
+	/** \brief Normalized X coordinate in the range [-1.0, 1.0]. */
+	float x;
+	/** \brief Normalized Y coordinate in the range [-1.0, 1.0]. */
+	float y;
+	/** \brief Modulation value [0..255] (XYM format). */
+	unsigned char m;
+	/** \brief Red color component [0..255] (XYRGB format). */
+	unsigned char r;
+	/** \brief Green color component [0..255] (XYRGB format). */
+	unsigned char g;
+	/** \brief Blue color component [0..255] (XYRGB format). */
+	unsigned char b;
+	/** \brief Wire format used to send this sample. */
+	PlayzerXDataFormat format;
+};
+
 /**
  * \class PlayzerX
  * \brief Main interface to connect and control PlayzerX devices.
@@ -123,6 +166,46 @@ class DLLEXPORT PlayzerX
 	 */
 	int GetSamplesRemaining();
 
+	/**
+	 * \brief Predicts the number of samples not yet output without any serial I/O.
+	 *
+	 * The prediction covers the device buffer and the bytes still queued in the host driver,
+	 * based on the data written, the sample rate and the latest buffer level updates.
+	 * \return Predicted number of samples pending, or \c -1 if no level was observed yet.
+	 */
+	int GetEstimatedSamplesRemaining();
+
+	/**
+	 * \brief Gets the sequence number the next sample written will receive.
+	 *
+	 * Samples are numbered in the order they are written to the serial port, starting at 0 when
+	 * the PlayzerX object is created, whichever function or thread writes them.
+	 */
+	unsigned long long GetSampleSequence() const { return m_SampleSequence.load(); }
+
+	/**
+	 * \brief Predicts when a sample starts leaving the DAC, without any serial I/O.
+	 *
+	 * The prediction is based on the estimated buffer level, the bytes still queued in the host
+	 * driver, the serial link rate and the sample rate, like GetEstimatedSamplesRemaining().
+	 * Samples not written yet are assumed to be written right now.
+	 * \param sampleSequence Sequence number of the sample, see GetSampleSequence().
+	 * \return Monotonic time in nanoseconds (see PlayzerXTelemetry::Now()), in the past for
+	 * samples already played, or \c -1 if no level was observed yet or the sample was cleared.
+	 */
+	long long GetEstimatedEmissionTime(unsigned long long sampleSequence);
+
+	/**
+	 * \brief Gets the measured deviation of the device sample clock from the host clock.
+	 *
+	 * The deviation is regressed from the buffer level readings of about the last hour and
+	 * used by all buffer level predictions, so that waits and streaming keep a constant buffer
+	 * depth over long runs. A measurement takes five minutes of readings with a non-empty buffer.
+	 * \return Parts per million, positive if the device plays faster than the sample rate set,
+	 * or \c 0 until measured.
+	 */
+	double GetClockDrift();
+
 	/**
 	 * \brief Sets the timer interval (in milliseconds) to update buffer levels.
 	 * \param bufferUpdateTimer A value greater than zero enables periodic buffering updates.
@@ -131,6 +214,9 @@ class DLLEXPORT PlayzerX
 
 	/**
 	 * \brief Blocks execution until the buffer level is below a specified threshold.
+	 *
+	 * Sleeps until the deadline predicted by the buffer model, re-checking whenever a buffer
+	 * level update corrects the prediction.
 	 * \param bufferLevelToSend Desired buffer threshold, default is \c 25000.
 	 */
 	void WaitForBufferLevel(int bufferLevelToSend = 25000);
@@ -144,8 +230,39 @@ class DLLEXPORT PlayzerX
 	 */
 	void SendDataXYM(float x, float y, unsigned char m, int bufferLevelToSend = -1);
 
+	/**
+	 * \brief Sends the commands and samples of a transaction in a single write.
+	 *
+	 * Nothing else is written in between, so e.g. a clear, a new sample rate and the first
+	 * samples of new content reach the device back to back. Returns once the data has been
+	 * transmitted, like the SendData functions.
+	 * \param transaction Commands and samples to send; it is not modified.
+	 */
+	void Commit(const PlayzerXTransaction& transaction);
+
+	/**
+	 * \brief Gathers consecutive single sample SendData calls into one write.
+	 *
+	 * While enabled, SendDataXYM(), SendDataXY() and SendDataXYRGB() called with one sample and
+	 * no \p bufferLevelToSend return right away; the samples are written together once
+	 * \p maxSamples are pending or the oldest has waited \p maxDelayUs, whichever comes first.
+	 * Any other call that talks to the device writes the pending samples first, so the order of
+	 * the output is kept. A background thread enforces the deadline.
+	 * \param maxSamples Samples per write, \c 0 or \c 1 to disable (the default).
+	 * \param maxDelayUs Longest time a sample is held back, in microseconds.
+	 */
+	void SetWriteCoalescing(unsigned int maxSamples, unsigned int maxDelayUs = 1000);
+
+	/**
+	 * \brief Writes the samples held back by write coalescing and waits for their transmission.
+	 */
+	void FlushCoalescedSamples();
+
 	/**
 	 * \brief Sends multiple XYM samples in array form.
+	 *
+	 * Any number of samples can be sent. Long sequences are encoded and written in chunks, each
+	 * waiting for room in the device buffer, so that they play without gaps.
 	 * \param x Pointer to array of normalized X coordinates.
 	 * \param y Pointer to array of normalized Y coordinates.
 	 * \param m Pointer to array of modulation values.
@@ -228,8 +345,38 @@ class DLLEXPORT PlayzerX
 					   std::vector<unsigned char>& g, std::vector<unsigned char>& b,
 					   int bufferLevelToSend = -1);
 
+	/**
+	 * \brief Sends a frame encoded beforehand, without any encoding work.
+	 *
+	 * Like SendDataXYM(), long frames are written in chunks that each wait for room in the
+	 * device buffer.
+	 * \param frame Samples encoded by EncodedFrame.
+	 * \param bufferLevelToSend Desired buffer threshold to wait for before sending.
+	 */
+	void SendFrame(const EncodedFrame& frame, int bufferLevelToSend = -1);
+
+	/**
+	 * \brief Sends a frame so that its first sample starts playing at a given time.
+	 *
+	 * The time between the samples already queued and \p time is filled with padding samples,
+	 * so the accuracy is one sample period plus the error of the buffer level estimate. Like
+	 * SendFrame(), long frames are written in chunks and the function returns once they are
+	 * transmitted. Nothing is sent if the time cannot be met.
+	 * \param time Monotonic time in nanoseconds, see PlayzerXTelemetry::Now().
+	 * \param frame Samples encoded by EncodedFrame.
+	 * \param padding Samples played until \p time.
+	 * \return \c true if the frame was sent, \c false with \c ERROR_FUNCTION_TIMEOUT if
+	 * \p time is earlier than the samples already queued allow.
+	 */
+	bool ScheduleAt(long long time, const EncodedFrame& frame,
+					PlayzerXPadding padding = PlayzerXPadding::BLANK);
+
 	/**
 	 * \brief Clears any queued data on the device and sends it to the origin.
+	 *
+	 * Also brings the device back in step if a transport error stopped the streaming engine in
+	 * pump mode in the middle of a sample. Until then the other calls that use the serial port
+	 * fail with \c ERROR_CONNECTION.
 	 */
 	void ClearData();
 
@@ -275,12 +422,71 @@ class DLLEXPORT PlayzerX
 	 */
 	bool HasError() { return m_LastError != PlayzerXError::SUCCESS; }
 
+	/**
+	 * \brief Gets a snapshot of the performance counters of this device.
+	 *
+	 * The counters are kept since construction or the last ResetStats(), across connections.
+	 */
+	PlayzerXStats GetStats() { return m_Counters.GetStats(); }
+
+	/** \brief Sets all performance counters to zero. */
+	void ResetStats() { m_Counters.Reset(); }
+
+	/**
+	 * \brief Registers a function called when the device buffer runs low or empty.
+	 *
+	 * Events are detected in the buffer level readings: the periodic updates enabled by
+	 * SetBufferUpdateTimer(), and the levels requested by GetSamplesRemaining() and the streaming
+	 * engine. A \c LOW_WATER event is raised when the level falls to \p lowWaterLevel or below,
+	 * an \c UNDERRUN event when the device reports an empty buffer after a non-empty one. Both
+	 * are also counted in GetStats(). An underrun shorter than the update interval may be missed.
+	 * \param callback Function to call, empty to stop the calls. It is called on the thread that
+	 * received the reading, usually the telemetry reader thread, so it must return quickly and
+	 * must not call functions of this object that use the serial port.
+	 * \param lowWaterLevel Low-water level in samples, \c 0 to report underruns only.
+	 */
+	void SetBufferEventCallback(const PlayzerXBufferCallback& callback,
+								unsigned int lowWaterLevel = 0)
+	{
+		m_BufferMonitor.SetCallback(callback, lowWaterLevel);
+	}
+
 	/**
 	 * \brief Discovers all available PlayzerX devices connected to the system.
+	 *
+	 * All candidate ports are probed at the same time, so the search takes about one probe
+	 * timeout however many ports exist. Devices are listed in port order. On Linux only USB
+	 * serial ports accepted by the port filter are opened (see SetPortFilter()).
 	 * \param plad A reference to \c PlayzerXAvailableDevices for storing the results.
 	 */
 	void GetAvailableDevices(PlayzerXAvailableDevices& plad);
 
+	/**
+	 * \brief Restricts device discovery to USB adapters with the given vendor/product IDs.
+	 * \param filter Accepted IDs; an empty list (the default) accepts every USB serial port.
+	 * \note Only applies where ports are enumerated with their USB attributes (Linux).
+	 */
+	void SetPortFilter(const std::vector<PlayzerXUsbId>& filter) { m_PortFilter = filter; }
+
+	/** \brief Gets the USB IDs accepted by device discovery. */
+	std::vector<PlayzerXUsbId> GetPortFilter() { return m_PortFilter; }
+
+	/**
+	 * \brief Sets the function that creates the transport for a port name.
+	 *
+	 * Applies to ConnectDevice() and to the ports probed by GetAvailableDevices(). Names the
+	 * factory returns \c nullptr for use the built-in transports: TCP for "tcp://host:port",
+	 * otherwise the serial port.
+	 * \param factory Transport factory, empty (the default) for the built-in transports only.
+	 */
+	void SetTransportFactory(const PlayzerXTransportFactory& factory)
+	{
+		m_TransportFactory = factory;
+	}
+
+	/** \brief Gets the transport factory, empty if none is set. */
+	PlayzerXTransportFactory GetTransportFactory() { return m_TransportFactory; }
+
 	/**
 	 * \brief Prints a summary of all discovered devices to the standard output.
 	 * \param plad A \c PlayzerXAvailableDevices object containing the discovery results.
@@ -293,15 +499,204 @@ class DLLEXPORT PlayzerX
 	/** \brief Switches between PlayzerX-AIN and PlayzerX-USB modes. */
 	void SwitchPlayzerXMode(bool enableAINMode, bool flashBoot);
 
+	/**
+	 * \brief Starts the background streaming engine.
+	 *
+	 * A dedicated transmit thread takes ownership of the serial port and keeps the device
+	 * buffer filled up to \p targetBufferLevel with samples queued by the Push functions. In pump
+	 * mode Pump() does the work of the thread instead, see SetPumpMode().
+	 * While streaming, SendData, ClearData and configuration calls fail with
+	 * \c ERROR_PLAYZERX_RUNNING_STATE.
+	 * \param targetBufferLevel Device buffer level (in samples) the engine maintains, at least 1.
+	 * \param ringCapacity Number of samples the host-side queue can hold, at least 1.
+	 * \return \c true if the engine is running, \c false with \c ERROR_INVALID_PARAM if either
+	 * parameter is 0.
+	 */
+	bool StartStreaming(unsigned int targetBufferLevel = 10000, unsigned int ringCapacity = 65536);
+
+	/**
+	 * \brief Stops the streaming engine and discards samples not yet sent.
+	 */
+	void StopStreaming();
+
+	/**
+	 * \brief Checks if the streaming engine is running.
+	 * \return \c true while the streaming engine owns the serial port.
+	 */
+	bool IsStreaming() { return m_Streaming.load(std::memory_order_acquire); }
+
+	/**
+	 * \brief Lets the application drive the streaming engine from its own event loop.
+	 *
+	 * Applies from the next start of the engine (StartStreaming(), StartSteering() or
+	 * SetLoopFrame()). In pump mode no transmit thread is created and the buffer level updates
+	 * are parsed by Pump() instead of the reader thread, so one thread can serve many devices
+	 * next to other sockets. The engine runs on the updates alone and never queries the
+	 * device, so SetBufferUpdateTimer() must be enabled before it is started.
+	 * \note Not available on Windows, where the serial port cannot report how much of a write
+	 * that did not complete was sent. Enabling it fails with ERROR_CONNECTION there.
+	 * \return \c false while the engine is running, or on Windows when enabling it.
+	 */
+	bool SetPumpMode(bool enable);
+
+	/** \brief Checks if the streaming engine is driven by Pump(). */
+	bool IsPumpMode() { return m_PumpMode; }
+
+	/**
+	 * \brief Gets the descriptor an event loop waits on for this device.
+	 *
+	 * Readable when buffer level updates arrived, writable when the transport has room for a
+	 * write left pending by Pump(). Pass it to poll(), epoll or select() only; reading or writing
+	 * it directly corrupts the protocol.
+	 * \return \c -1 if not connected or the transport has no descriptor (Windows, loopback).
+	 */
+	int GetFileDescriptor() { return m_SerialDevice ? m_SerialDevice->GetFileDescriptor() : -1; }
+
+	/**
+	 * \brief Does the work of the streaming engine that is due now, without ever blocking.
+	 *
+	 * Parses the buffer level updates received, continues a write the transport did not take
+	 * completely, and sends new samples up to the target level. Call it from one thread,
+	 * whenever GetFileDescriptor() is readable (or writable while HasPendingWrite()), after
+	 * pushing samples or posting a target, and at the latest at the time it returns.
+	 * \return Host time (see PlayzerXTelemetry::Now()) to call it again at, \c -1 if the engine
+	 * is not running in pump mode.
+	 */
+	long long Pump();
+
+	/**
+	 * \brief Checks if encoded samples wait for room in the transport, see Pump().
+	 *
+	 * New samples are held back until they are out, so the device never gets part of a sample.
+	 * The rest of a write that failed is retried the same way.
+	 */
+	bool HasPendingWrite() { return !m_PumpBytes.empty(); }
+
+	/**
+	 * \brief Queues samples to the streaming engine without blocking.
+	 * \param samples Pointer to an array of samples.
+	 * \param numSamples Number of samples to queue.
+	 * \return Number of samples accepted; less than \p numSamples if the queue is full.
+	 */
+	unsigned int PushSamples(const PlayzerXSample* samples, unsigned int numSamples);
+
+	/**
+	 * \brief Queues XYM samples to the streaming engine without blocking.
+	 * \return Number of samples accepted; less than \p numSamples if the queue is full.
+	 */
+	unsigned int PushDataXYM(const float* x, const float* y, const unsigned char* m,
+							 unsigned int numSamples);
+
+	/**
+	 * \brief Queues XY samples to the streaming engine without blocking.
+	 * \return Number of samples accepted; less than \p numSamples if the queue is full.
+	 */
+	unsigned int PushDataXY(const float* x, const float* y, unsigned int numSamples);
+
+	/**
+	 * \brief Queues XYRGB samples to the streaming engine without blocking.
+	 * \return Number of samples accepted; less than \p numSamples if the queue is full.
+	 */
+	unsigned int PushDataXYRGB(const float* x, const float* y, const unsigned char* r,
+							   const unsigned char* g, const unsigned char* b,
+							   unsigned int numSamples);
+
+	/**
+	 * \brief Number of samples queued on the host that the engine has not sent yet.
+	 */
+	unsigned int GetStreamQueuedSamples() { return (unsigned int)m_StreamRing.Size(); }
+
+	/**
+	 * \brief Holds back the samples of the streaming engine until released.
+	 *
+	 * While held the engine keeps its buffer model up to date but sends nothing, so that the
+	 * first samples of several devices can be released together (see PlayzerXGroup).
+	 * StopStreaming() releases the hold.
+	 */
+	void SetStreamHold(bool hold) { m_StreamHold.store(hold, std::memory_order_release); }
+
+	/**
+	 * \brief Moves the output of the streaming engine in time by repeating or skipping samples.
+	 *
+	 * The engine repeats (\p samples > 0) or drops (\p samples < 0) at most one queued sample
+	 * per write until the shift is done, which delays or advances the samples behind it by as
+	 * many sample periods. Queue mode only. May be called from any thread.
+	 */
+	void ShiftStreamPhase(int samples);
+
+	/**
+	 * \brief Estimates how far the device got through the samples queued since StartStreaming().
+	 *
+	 * Samples played, less the shifts requested with ShiftStreamPhase(), which count at once.
+	 * Devices fed the same samples play in phase while their positions are equal. Based on the
+	 * buffer model like GetEstimatedSamplesRemaining(), so it moves between level updates.
+	 * \return Position in samples, \c -1 if not streaming or no level was observed yet.
+	 */
+	double GetStreamPhase();
+
+	/**
+	 * \brief Starts the streaming engine in steering mode, for interactive control of the beam.
+	 *
+	 * Instead of a queue, the transmit thread plays the latest target posted with the
+	 * PostTarget functions. It lets the device buffer run down to half of \p targetBufferLevel
+	 * and then tops it up with copies of the newest target; targets replaced before that are
+	 * dropped. A new target thus reaches the output after at most about \p targetBufferLevel
+	 * samples plus its transmission time. Stop the engine with StopStreaming().
+	 * \param targetBufferLevel Device buffer level (in samples) the engine maintains. Lower
+	 * levels give less latency and more, smaller writes; \c 0 (the default) picks about 5 ms
+	 * of output at the current sample rate.
+	 * \return \c true if the engine is running in steering mode.
+	 */
+	bool StartSteering(unsigned int targetBufferLevel = 0);
+
+	/** \brief Checks if the streaming engine runs in steering mode. */
+	bool IsSteering() { return IsStreaming() && m_StreamMode == PlayzerXStreamMode::STEERING; }
+
+	/** \brief Gets the source the streaming engine plays, meaningful while IsStreaming(). */
+	PlayzerXStreamMode GetStreamMode() { return m_StreamMode; }
+
+	/**
+	 * \brief Posts the XYM target played in steering mode, replacing the previous one.
+	 *
+	 * May be called from any thread and never blocks.
+	 */
+	void PostTargetXYM(float x, float y, unsigned char m);
+
+	/** \brief Posts the XY target played in steering mode, replacing the previous one. */
+	void PostTargetXY(float x, float y);
+
+	/** \brief Posts the XYRGB target played in steering mode, replacing the previous one. */
+	void PostTargetXYRGB(float x, float y, unsigned char r, unsigned char g, unsigned char b);
+
+	/**
+	 * \brief Plays a frame over and over in the background until it is replaced.
+	 *
+	 * The first call starts the streaming engine in loop mode, which repeats the frame into the
+	 * device buffer with no work for the application. Later calls replace the frame: the engine
+	 * finishes sending the current repetition of the old frame and continues with the new one,
+	 * so the output never holds part of each. The frame is copied. Stop the engine with
+	 * StopStreaming().
+	 * \param frame Frame to play; an empty frame stops the output at the next frame boundary.
+	 * \param targetBufferLevel Device buffer level (in samples) the engine maintains, at least 1,
+	 * only used when the engine is started. A new frame reaches the output after about this many
+	 * samples.
+	 * \return \c false if the engine runs in another mode or could not be started, with
+	 * \c ERROR_INVALID_PARAM if it is started with a \p targetBufferLevel of 0.
+	 */
+	bool SetLoopFrame(const EncodedFrame& frame, unsigned int targetBufferLevel = 10000);
+
    protected:
 	/** \brief Pointer to the underlying serial communication object. */
 	MTISerialIO* m_SerialDevice;
 
-	/** \brief Maximum number of samples that can be sent at once. */
-	const unsigned int kMaxSendSamples = 100000u;
+	/** \brief Number of samples encoded and written at once by the SendData functions. */
+	const unsigned int kSendChunkSamples = 4096u;
+
+	/** \brief Size of the device buffer in samples (Monochrome devices). */
+	const unsigned int kBufferSize = 125000u;
 
-	/** \brief Maximum number of bytes that can be sent at once (11 bytes/sample in RGB mode). */
-	const unsigned int kMaxSendBytes = kMaxSendSamples * 11;
+	/** \brief Size of the device buffer in samples (RGB devices). */
+	const unsigned int kBufferSizeRGB = 83333u;
 
 	/** \brief Nominal baud rate used for the device (921600 baud). */
 	const unsigned int kBaudRate = 921600;
@@ -312,6 +707,34 @@ class DLLEXPORT PlayzerX
 	/** \brief Tracks whether streaming of samples remaining is active. */
 	bool m_StreamingSamplesRemaining = false;
 
+	/** \brief Interval (in milliseconds) of the samples remaining updates, 0 if disabled. */
+	unsigned int m_BufferUpdateTimer;
+
+	/** \brief Background reader of the samples remaining updates. */
+	PlayzerXTelemetry m_Telemetry;
+
+	/** \brief Host-side model of the device buffer occupancy. */
+	PlayzerXFifoEstimator m_Estimator;
+
+	/** \brief Performance counters, see GetStats(). */
+	PlayzerXCounters m_Counters;
+
+	/** \brief Low-water and underrun detection, see SetBufferEventCallback(). */
+	PlayzerXBufferMonitor m_BufferMonitor;
+
+	/** \brief Telemetry update count last applied to \c m_Estimator. */
+	std::atomic<unsigned long long> m_EstimatorUpdateCount;
+
+	/** \brief Sequence number of the next sample written, see GetSampleSequence(). */
+	std::atomic<unsigned long long> m_SampleSequence;
+
+	/** \brief Sequence number of the first sample written after the last clear. */
+	std::atomic<unsigned long long> m_ClearSequence;
+
+	/** \brief Number of WriteData() calls started and finished, equal if none is in progress. */
+	std::atomic<unsigned long long> m_WritesStarted;
+	std::atomic<unsigned long long> m_WritesFinished;
+
 	/** \brief Tracks how many samples remain in the device buffer. */
 	unsigned int m_SamplesRemaining;
 
@@ -325,7 +748,16 @@ class DLLEXPORT PlayzerX
 	PlayzerXError m_LastError = PlayzerXError::SUCCESS;
 
    private:
-	/** \brief Outgoing command buffer used for sending data. */
+	/**
+	 * \brief Writes samples chunk by chunk; a chunk is encoded while the previous one is sent.
+	 * \param encode Encodes \p count samples starting at \p first into the buffer passed and
+	 * returns the bytes to write (which need not be in that buffer).
+	 */
+	void SendChunks(unsigned int numSamples, unsigned int bytesPerSample, int bufferLevelToSend,
+					const std::function<const unsigned char*(unsigned int first, unsigned int count,
+															 unsigned char* buffer)>& encode);
+
+	/** \brief Outgoing command buffer used for sending data, one chunk at most. */
 	std::vector<unsigned char> m_CommandBytes;
 
 	/** \brief Cached string for the device name. */
@@ -343,8 +775,252 @@ class DLLEXPORT PlayzerX
 	 */
 	bool GetDeviceInfo();
 
+	/**
+	 * \brief Opens a port and asks for a PlayzerX device, then closes the port again.
+	 *
+	 * Called on a temporary object per port by GetAvailableDevices().
+	 * \return \c true if a device answered; its details are then cached in this object.
+	 */
+	bool ProbePort(const std::string& portPath);
+
+	/** \brief USB IDs accepted by GetAvailableDevices(), empty for any. */
+	std::vector<PlayzerXUsbId> m_PortFilter;
+
+	/** \brief Creates transports for port names, empty for serial ports only. */
+	PlayzerXTransportFactory m_TransportFactory;
+
+	/** \brief Creates the transport for a name, \c nullptr for the serial port. */
+	MTISerialIO* CreateTransport(const std::string& portName);
+
+	/**
+	 * \brief Opens a transport and sets up the device on it.
+	 * \param socket New transport, owned by this object from now on.
+	 * \return The transport if it could be opened, otherwise the previous one.
+	 */
+	MTISerialIO* OpenTransport(MTISerialIO* socket, const char* portName);
+
 	/** \brief Purges any pending data in the serial I/O buffers. */
 	void PurgeSerialBuffers();
+
+	/**
+	 * \brief Requests the remaining samples from the device (or its periodic updates).
+	 * \return Number of samples left in the device buffer, or \c -1 on failure.
+	 */
+	int QuerySamplesRemaining();
+
+	/** \brief Number of bytes queued in the host driver, \c 0 if unknown. */
+	unsigned int GetOutputQueue();
+
+	/** \brief Applies buffer level updates received since the last call to the estimator. */
+	void UpdateEstimator();
+
+	/** \brief Accounts for a buffer level reading received at \p timestamp. */
+	void OnBufferLevel(int level, long long timestamp);
+
+	/** \brief Accounts for samples just written in the estimator. */
+	void OnDataWritten(unsigned int numSamples, unsigned int numBytes);
+
+	/** \brief Writes a command to the device and waits for its transmission (200 ms at most). */
+	long WriteCommand(unsigned char* command, unsigned int numBytes);
+
+	/**
+	 * \brief Queues encoded samples for transmission and accounts for them.
+	 * \param updateEstimator \c false if the caller accounts for the samples in the estimator.
+	 */
+	long WriteData(const unsigned char* bytes, unsigned int numBytes, unsigned int numSamples,
+				   bool updateEstimator = true);
+
+	/** \brief Completes a "pl u" command: drops stale updates and restarts the reader. */
+	void OnBufferUpdateTimerSent(unsigned int bufferUpdateTimer, long serialError);
+
+	/** \brief Waits until the data written has been transmitted (2 s at most). */
+	long DrainData();
+
+	/** \brief Holds back one encoded sample for a coalesced write. */
+	void CoalesceSample(const unsigned char* bytes, unsigned int numBytes);
+
+	/** \brief Writes the samples held back, if any, ahead of any other write. */
+	long FlushCoalesced();
+
+	/** \brief Writes held back samples once their deadline passes. */
+	void CoalesceThread();
+
+	/** \brief Stops the coalescing thread after writing what it holds. */
+	void StopCoalescing();
+
+	/** \brief Samples per coalesced write, \c 0 while coalescing is disabled. */
+	unsigned int m_CoalesceMaxSamples;
+
+	/** \brief Longest time a sample is held back, in nanoseconds. */
+	long long m_CoalesceMaxDelay;
+
+	/** \brief Encoded samples held back, guarded by \c m_CoalesceMutex. */
+	std::vector<unsigned char> m_CoalesceBytes;
+
+	/** \brief Bytes being written by FlushCoalesced(), guarded by \c m_CoalesceWriteMutex. */
+	std::vector<unsigned char> m_CoalesceWriteBytes;
+
+	/** \brief Number of samples held back. */
+	unsigned int m_CoalesceSamples;
+
+	/** \brief Host time (see PlayzerXTelemetry::Now()) the oldest sample held back is due. */
+	long long m_CoalesceDeadline;
+
+	/** \brief Serial error of a write by the coalescing thread, reported by the next call. */
+	std::atomic<long> m_CoalesceError;
+
+	/** \brief Set while the coalescing thread runs. */
+	bool m_CoalesceRunning;
+
+	/** \brief Guards the held back samples and the coalescing settings. */
+	std::mutex m_CoalesceMutex;
+
+	/** \brief Keeps coalesced writes in order with the other writes. */
+	std::mutex m_CoalesceWriteMutex;
+
+	/** \brief Wakes the coalescing thread when samples are held back or it must stop. */
+	std::condition_variable m_CoalesceCondition;
+
+	/** \brief Thread writing held back samples at their deadline. */
+	std::thread m_CoalesceThread;
+
+	/** \brief WaitForBufferLevel() without the accounting. */
+	void SleepUntilBufferLevel(int bufferLevel);
+
+	/**
+	 * \brief Anchors the buffer model with one device reading if nothing has been observed yet.
+	 * \return \c true if the model is valid.
+	 */
+	bool AnchorEstimator();
+
+	/**
+	 * \brief Checks that the serial port may be used by the calling application thread.
+	 * \param resync \c true for ClearData(), which may also be used while \c m_ResyncBytes wait.
+	 * \return \c false and sets \c m_LastError if not connected, the engine owns the port or the
+	 * device is out of step.
+	 */
+	bool IsSerialAccessible(bool resync = false);
+
+	/**
+	 * \brief Encodes samples of any format into wire bytes.
+	 * \return Number of bytes written to \p bytes (at most 11 per sample).
+	 */
+	static unsigned int EncodeSamples(const PlayzerXSample* samples, unsigned int numSamples,
+									  unsigned char* bytes);
+
+	/** \brief Starts the streaming engine in any mode, on its thread unless in pump mode. */
+	bool StartTransmitThread(unsigned int targetBufferLevel, PlayzerXStreamMode mode);
+
+	/** \brief Main loop of the streaming engine transmit thread. */
+	void TransmitThread();
+
+	/**
+	 * \brief One pass of the streaming engine: tops up the device buffer if it is low.
+	 * \return Host time the next pass is due, not later than the current time to run it now.
+	 */
+	long long TransmitStep();
+
+	/**
+	 * \brief Writes a batch of the streaming engine, without blocking in pump mode.
+	 * \return \c false on errors and if part of the batch is left for HasPendingWrite().
+	 */
+	bool WriteStream(const unsigned char* bytes, unsigned int numBytes, unsigned int numSamples);
+
+	/**
+	 * \brief Writes the batch of \c m_PumpSamples from byte \c m_PumpWritten on; accounts for
+	 * its samples as they are out.
+	 * \param timeout \c 0 to keep what the transport does not take in \c m_PumpBytes. What a
+	 * failed write leaves is kept as well.
+	 * \return \c true if the batch has been written completely.
+	 */
+	bool WritePumped(const unsigned char* bytes, unsigned int numBytes, unsigned int timeout);
+
+	/** \brief Ends pump mode streaming: completes the pending write, restarts the reader thread. */
+	void StopPumping();
+
+	/** \brief Maximum number of samples the transmit thread sends per write. */
+	const unsigned int kStreamBatchSamples = 4096u;
+
+	/** \brief Transmit thread of the streaming engine. */
+	std::thread m_TransmitThread;
+
+	/** \brief Set while the streaming engine owns the serial port. */
+	std::atomic<bool> m_Streaming;
+
+	/** \brief Drive the next streaming engine started by Pump(), see SetPumpMode(). */
+	bool m_PumpMode;
+
+	/** \brief Bytes of a batch the transport has not taken yet, in pump mode. */
+	std::vector<unsigned char> m_PumpBytes;
+
+	/** \brief Samples and total bytes of the batch being written in pump mode. */
+	unsigned int m_PumpSamples;
+	unsigned int m_PumpBatchBytes;
+
+	/** \brief Bytes of \c m_PumpBytes already written, part of its first sample. */
+	unsigned int m_PumpWritten;
+
+	/**
+	 * \brief Rest of a sample the engine could not finish when it was stopped.
+	 *
+	 * The device reads the next bytes it receives as part of that sample, so the port only takes
+	 * ClearData() until this went out.
+	 */
+	std::vector<unsigned char> m_ResyncBytes;
+
+	/** \brief Queue of samples handed from the application to the transmit thread. */
+	SpscRing<PlayzerXSample> m_StreamRing;
+
+	/** \brief Source the transmit thread plays, set before the thread starts. */
+	PlayzerXStreamMode m_StreamMode;
+
+	/** \brief Latest target posted for steering mode. */
+	PlayzerXMailbox m_SteerMailbox;
+
+	/** \brief Wire bytes of the frame played in loop mode, repeated to a minimum length. */
+	struct LoopFrame
+	{
+		std::vector<unsigned char> bytes;
+		unsigned int numSamples;
+		unsigned int bytesPerSample;
+	};
+
+	/** \brief Frame the loop mode continues with, accessed with \c std::atomic_load/store. */
+	std::shared_ptr<const LoopFrame> m_LoopFrame;
+
+	/** \brief Loop mode frame being sent by the engine and the next sample of it. */
+	std::shared_ptr<const LoopFrame> m_TransmitFrame;
+	unsigned int m_TransmitFrameOffset;
+
+	/** \brief Host time the engine last queried the device buffer level. */
+	long long m_TransmitLastQuery;
+
+	/** \brief Loop mode frames shorter than this are repeated, so that writes are not tiny. */
+	const unsigned int kMinLoopSamples = 256u;
+
+	/** \brief Device buffer level (in samples) the transmit thread maintains. */
+	unsigned int m_StreamTargetLevel;
+
+	/** \brief Latest device buffer level seen by the transmit thread. */
+	std::atomic<int> m_StreamSamplesRemaining;
+
+	/** \brief Samples popped from the ring by the transmit thread. */
+	std::vector<PlayzerXSample> m_StreamBatch;
+
+	/** \brief Wire bytes written by the transmit thread. */
+	std::vector<unsigned char> m_StreamBytes;
+
+	/** \brief Set while the engine may not send, see SetStreamHold(). */
+	std::atomic<bool> m_StreamHold;
+
+	/** \brief Samples still to repeat (positive) or drop (negative), see ShiftStreamPhase(). */
+	std::atomic<int> m_StreamPhaseShift;
+
+	/** \brief Sum of the shifts requested since the engine was started. */
+	std::atomic<long long> m_StreamPhaseShifted;
+
+	/** \brief Sample sequence number when the engine was started. */
+	std::atomic<unsigned long long> m_StreamStartSequence;
 };
 
 }  // namespace playzerx
@@ -81,6 +81,68 @@ enum struct PlayzerXError
 	ERROR_SCAN_NOT_SET
 };
 
+/**
+ * \enum PlayzerXDataFormat
+ * \brief Enumerates the wire formats of a single sample sent to the controller.
+ *
+ */
+enum struct PlayzerXDataFormat : unsigned char
+{
+	/**
+	 * \brief 12 bit X, 12 bit Y ("pl D", 8 bytes per sample, M defaults to 255).
+	 */
+	XY = 0,
+
+	/**
+	 * \brief 12 bit X, 12 bit Y, 8 bit M ("pl d", 9 bytes per sample).
+	 */
+	XYM,
+
+	/**
+	 * \brief 12 bit X, 12 bit Y, 8 bit R, G and B ("pl d", 11 bytes per sample).
+	 */
+	XYRGB
+};
+
+/**
+ * \enum PlayzerXPadding
+ * \brief Enumerates the samples PlayzerX::ScheduleAt() fills the time before a frame with.
+ */
+enum struct PlayzerXPadding : unsigned char
+{
+	/**
+	 * \brief The first sample of the frame with the laser off (XY data cannot be blanked).
+	 */
+	BLANK = 0,
+
+	/**
+	 * \brief The first sample of the frame as it is, the beam waits at the start of the frame.
+	 */
+	HOLD
+};
+
+/**
+ * \enum PlayzerXStreamMode
+ * \brief Enumerates the sources the streaming engine keeps the device buffer filled from.
+ */
+enum struct PlayzerXStreamMode : unsigned char
+{
+	/**
+	 * \brief Samples queued with the Push functions, see PlayzerX::StartStreaming().
+	 */
+	QUEUE = 0,
+
+	/**
+	 * \brief The latest target posted, see PlayzerX::StartSteering().
+	 */
+	STEERING,
+
+	/**
+	 * \brief A frame repeated until it is replaced, see PlayzerX::SetLoopFrame().
+	 */
+	LOOP
+};
+
 }  // namespace playzerx
 
 #endif	// PLAYZERX_DEFINITIONS_H
@@ -0,0 +1,164 @@
+/**
+ * \file PlayzerXEncoder.h
+ * \brief Defines the wire format encoders and the pre-encoded frame class.
+ * \version 2.1.0.0
+ *
+ * Every sample travels as its own "pl D" (XY) or "pl d" (XYM, XYRGB) command. The encoders
+ * quantize normalized coordinates to 12 bits and lay out complete commands, ready to be written
+ * to the serial port as they are. On x86 processors, SSE2, AVX2 or AVX-512 kernels are selected
+ * at run time; all kernels produce identical bytes.
+ */
+
+#ifndef PLAYZERX_ENCODER_H
+#define PLAYZERX_ENCODER_H
+
+#include <vector>
+
+#include "PlayzerXDefinitions.h"
+
+namespace playzerx
+{
+/** \brief Wire bytes per XY sample: 'p' 'l' 'D' len X[7:0] {X[11:8],Y[3:0]} Y[11:4] '\\n'. */
+const unsigned int kBytesPerSampleXY = 8;
+
+/** \brief Wire bytes per XYM sample: XY layout with 'd' and M[7:0] before the suffix. */
+const unsigned int kBytesPerSampleXYM = 9;
+
+/** \brief Wire bytes per XYRGB sample: XY layout with 'd' and R, G, B before the suffix. */
+const unsigned int kBytesPerSampleXYRGB = 11;
+
+/**
+ * \brief Gets the number of wire bytes per sample of a data format.
+ */
+inline unsigned int GetBytesPerSample(PlayzerXDataFormat format)
+{
+	return (format == PlayzerXDataFormat::XY)	 ? kBytesPerSampleXY
+		   : (format == PlayzerXDataFormat::XYM) ? kBytesPerSampleXYM
+												 : kBytesPerSampleXYRGB;
+}
+
+/**
+ * \enum PlayzerXEncoderKernel
+ * \brief Instruction set used by the encoders.
+ */
+enum struct PlayzerXEncoderKernel : unsigned char
+{
+	/** \brief Portable implementation, one sample at a time. */
+	SCALAR = 0,
+
+	/** \brief 4 samples per iteration, available on every x86-64 processor. */
+	SSE2,
+
+	/** \brief 8 samples per iteration. */
+	AVX2,
+
+	/** \brief 16 samples per iteration (AVX-512F). */
+	AVX512
+};
+
+/**
+ * \brief Checks if the processor and operating system support a kernel.
+ */
+bool IsEncoderKernelSupported(PlayzerXEncoderKernel kernel);
+
+/**
+ * \brief Gets the kernel used by the encoders, by default the fastest one supported.
+ */
+PlayzerXEncoderKernel GetEncoderKernel();
+
+/**
+ * \brief Forces the encoders to use a specific kernel, e.g. for benchmarking.
+ * \return \c false if \p kernel is not supported; the current kernel is kept.
+ */
+bool SetEncoderKernel(PlayzerXEncoderKernel kernel);
+
+/**
+ * \brief Encodes XY samples into "pl D" commands.
+ *
+ * Coordinates are normalized to [-1, 1]; values outside the range are clamped (NaN maps to -1).
+ * \param bytes Output buffer of at least \p numSamples * kBytesPerSampleXY bytes.
+ * \return Number of bytes written to \p bytes.
+ */
+unsigned int EncodeDataXY(const float* x, const float* y, unsigned int numSamples,
+						  unsigned char* bytes);
+
+/**
+ * \brief Encodes XYM samples into "pl d" commands.
+ * \param bytes Output buffer of at least \p numSamples * kBytesPerSampleXYM bytes.
+ * \return Number of bytes written to \p bytes.
+ */
+unsigned int EncodeDataXYM(const float* x, const float* y, const unsigned char* m,
+						   unsigned int numSamples, unsigned char* bytes);
+
+/**
+ * \brief Encodes XYRGB samples into "pl d" commands.
+ * \param bytes Output buffer of at least \p numSamples * kBytesPerSampleXYRGB bytes.
+ * \return Number of bytes written to \p bytes.
+ */
+unsigned int EncodeDataXYRGB(const float* x, const float* y, const unsigned char* r,
+							 const unsigned char* g, const unsigned char* b,
+							 unsigned int numSamples, unsigned char* bytes);
+
+/**
+ * \class EncodedFrame
+ * \brief Holds samples already encoded to wire bytes.
+ *
+ * Build a frame once and pass it to PlayzerX::SendFrame() as often as needed; repeated sends
+ * cost no encoding work on the host.
+ */
+class DLLEXPORT EncodedFrame
+{
+   public:
+	EncodedFrame();
+
+	/** \brief Builds a frame from XY samples. */
+	EncodedFrame(const float* x, const float* y, unsigned int numSamples);
+
+	/** \brief Builds a frame from XYM samples. */
+	EncodedFrame(const float* x, const float* y, const unsigned char* m, unsigned int numSamples);
+
+	/** \brief Builds a frame from XYRGB samples. */
+	EncodedFrame(const float* x, const float* y, const unsigned char* r, const unsigned char* g,
+				 const unsigned char* b, unsigned int numSamples);
+
+	/** \brief Replaces the content with XY samples. */
+	void SetDataXY(const float* x, const float* y, unsigned int numSamples);
+
+	/** \brief Replaces the content with XYM samples. */
+	void SetDataXYM(const float* x, const float* y, const unsigned char* m,
+					unsigned int numSamples);
+
+	/** \brief Replaces the content with XYRGB samples. */
+	void SetDataXYRGB(const float* x, const float* y, const unsigned char* r,
+					  const unsigned char* g, const unsigned char* b, unsigned int numSamples);
+
+	/** \brief Removes all samples. */
+	void Clear();
+
+	/** \brief Gets the data format of the samples. */
+	PlayzerXDataFormat GetFormat() const { return m_Format; }
+
+	/** \brief Gets the number of samples in the frame. */
+	unsigned int GetNumSamples() const { return m_NumSamples; }
+
+	/** \brief Gets the number of wire bytes per sample. */
+	unsigned int GetBytesPerSample() const { return playzerx::GetBytesPerSample(m_Format); }
+
+	/** \brief Gets the total number of wire bytes. */
+	unsigned int GetNumBytes() const { return (unsigned int)m_Bytes.size(); }
+
+	/** \brief Gets the wire bytes, \c nullptr if the frame is empty. */
+	const unsigned char* GetData() const { return m_Bytes.empty() ? nullptr : &m_Bytes[0]; }
+
+   private:
+	/** \brief Sizes the byte buffer for \p numSamples samples of \p format. */
+	unsigned char* Allocate(PlayzerXDataFormat format, unsigned int numSamples);
+
+	PlayzerXDataFormat m_Format;
+	unsigned int m_NumSamples;
+	std::vector<unsigned char> m_Bytes;
+};
+
+}  // namespace playzerx
+
+#endif  // PLAYZERX_ENCODER_H
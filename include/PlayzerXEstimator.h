@@ -0,0 +1,215 @@
+/**
+ * \file PlayzerXEstimator.h
+ * \brief Defines the host-side model of the controller FIFO occupancy.
+ * \version 2.1.0.0
+ *
+ * The estimator predicts how many samples are still pending (in the kernel transmit queue and in
+ * the controller FIFO) from what the host wrote, what the kernel has drained and the sample rate.
+ * Device telemetry only corrects the prediction, so waits can be scheduled to an exact deadline.
+ *
+ * The device sample clock runs off its own crystal, so over hours its rate differs measurably
+ * from the nominal one. PlayzerXDriftEstimator measures the difference from the same telemetry.
+ */
+
+#ifndef PLAYZERX_ESTIMATOR_H
+#define PLAYZERX_ESTIMATOR_H
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace playzerx
+{
+/**
+ * \class PlayzerXDriftEstimator
+ * \brief Measures the device sample clock against the host monotonic clock.
+ *
+ * The samples the device has played (written minus queued minus buffered) are regressed against
+ * the host time of the buffer level readings. A reading often misses samples written shortly
+ * before it was received, which makes the count too high, and is rarely delayed, which makes it
+ * too low, so only the lowest tenth of each interval is used. Readings of an empty buffer, clears
+ * and sample rate changes break the count, so they start a new segment; segments share the slope
+ * but not the offset, and the first interval of a segment is skipped while the buffers settle.
+ * Readings are forgotten with a time constant of an hour, so that the estimate follows slow
+ * changes such as the crystal temperature. Not thread safe, PlayzerXFifoEstimator calls it under
+ * its lock.
+ */
+class PlayzerXDriftEstimator
+{
+   public:
+	PlayzerXDriftEstimator() { Reset(); }
+
+	/** \brief Forgets all readings. */
+	void Reset();
+
+	/** \brief Makes the next reading start a new segment. */
+	void Break();
+
+	/**
+	 * \brief Adds a reading.
+	 * \param played Samples played since an origin that is fixed within a segment.
+	 * \param sampleRate Nominal sample rate the samples were played at.
+	 * \param timestamp Host time of the reading in nanoseconds.
+	 */
+	void OnReading(double played, double sampleRate, long long timestamp);
+
+	/** \brief Checks if enough readings were seen for GetPpm() to be meaningful. */
+	bool IsValid() const { return m_Duration >= kMinDuration; }
+
+	/**
+	 * \brief Gets the deviation of the device rate from the nominal rate.
+	 * \return Parts per million, positive if the device plays faster; \c 0 if not valid.
+	 */
+	double GetPpm() const;
+
+	/** \brief Gets the ratio of the device rate to the nominal rate. */
+	double GetRateFactor() const { return 1.0 + 1e-6 * GetPpm(); }
+
+   private:
+	/** \brief Adds the low reading of the current interval to the regression. */
+	void Flush();
+
+	/** \brief Time constant of the forgetting, in seconds. */
+	const double kTimeConstant = 3600.0;
+
+	/** \brief Length of the intervals a low reading is taken from, in seconds. */
+	const double kInterval = 10.0;
+
+	/** \brief Seconds of readings needed before the estimate is used. */
+	const double kMinDuration = 300.0;
+
+	/** \brief Estimates beyond this many ppm are limited, crystals stay well within it. */
+	const double kMaxPpm = 1000.0;
+
+	bool m_Segment;
+	bool m_Settled;
+	long long m_Origin;
+	double m_IntervalStart;
+	/** \brief Readings of the current interval, position minus time and time. */
+	std::vector<std::pair<double, double>> m_Interval;
+	double m_LastTime;
+	double m_Weight;
+	double m_MeanTime;
+	double m_MeanPlayed;
+	double m_Covariance;
+	double m_Variance;
+	double m_Duration;
+};
+
+/**
+ * \class PlayzerXFifoEstimator
+ * \brief Predicts controller FIFO occupancy between telemetry updates.
+ *
+ * All times are host monotonic times in nanoseconds supplied by the caller. Kernel queue sizes
+ * are in bytes as reported by MTISerialIO::GetOutputQueue(). All methods are thread safe.
+ */
+class PlayzerXFifoEstimator
+{
+   public:
+	PlayzerXFifoEstimator();
+
+	/** \brief Forgets the current state; IsValid() returns \c false until the next observation. */
+	void Reset();
+
+	/** \brief Sets the rate (samples per second) at which the controller drains its FIFO. */
+	void SetSampleRate(double sampleRate);
+
+	/** \brief Gets the drain rate used by the model in samples per second, drift included. */
+	double GetSampleRate() const;
+
+	/**
+	 * \brief Measures the device clock with a level reported by the controller.
+	 *
+	 * Unlike OnTelemetry(), which may be applied late, this must be called as soon as the
+	 * report is received.
+	 * \param written Total number of samples written to the kernel so far.
+	 */
+	void OnDriftReading(int level, long long timestamp, unsigned long long written,
+						unsigned int outputQueue);
+
+	/** \brief Gets the measured device clock deviation in ppm, see PlayzerXDriftEstimator. */
+	double GetDriftPpm() const;
+
+	/** \brief Checks if the model has been anchored to an observed level. */
+	bool IsValid() const;
+
+	/**
+	 * \brief Accounts for samples just handed to the kernel.
+	 * \param numSamples Number of samples written.
+	 * \param numBytes Number of wire bytes written for those samples.
+	 * \param outputQueue Kernel transmit queue size right after the write.
+	 * \param now Host time of the measurement.
+	 */
+	void OnWrite(unsigned int numSamples, unsigned int numBytes, unsigned int outputQueue,
+				 long long now);
+
+	/**
+	 * \brief Accounts for a "pl c" command; the FIFO is empty once it arrives.
+	 */
+	void OnClear(unsigned int outputQueue, long long now);
+
+	/**
+	 * \brief Corrects the model with a level reported by the controller.
+	 * \param level Samples remaining reported by the device.
+	 * \param timestamp Host time the report was received.
+	 * \param outputQueue Kernel transmit queue size at \p now.
+	 * \param now Current host time.
+	 */
+	void OnTelemetry(int level, long long timestamp, unsigned int outputQueue, long long now);
+
+	/**
+	 * \brief Predicts the number of samples in the controller FIFO.
+	 */
+	double GetDeviceLevel(unsigned int outputQueue, long long now) const;
+
+	/**
+	 * \brief Predicts the number of samples not yet output (controller FIFO plus kernel queue).
+	 */
+	double GetPendingLevel(unsigned int outputQueue, long long now) const;
+
+	/**
+	 * \brief Predicts when the pending level drops to \p level.
+	 * \return Host time of the deadline; \p now or earlier if already reached.
+	 */
+	long long GetDeadline(double level, unsigned int outputQueue, long long now) const;
+
+	/**
+	 * \brief Predicts when a sample starts playing.
+	 *
+	 * Samples play back to back at the sample rate, but a sample still queued in the kernel
+	 * cannot play before the link has delivered it; the device idles meanwhile.
+	 * \param index Position of the sample among those pending, 0 is the next to play. Values
+	 * beyond the pending level stand for samples written right now, negative ones for samples
+	 * already played.
+	 * \param byteRate Bytes per second the link delivers, \c 0 if it is never the bottleneck.
+	 * \return Host time at which the sample starts playing.
+	 */
+	long long GetEmissionTime(double index, double byteRate, unsigned int outputQueue,
+							  long long now) const;
+
+   private:
+	/** \brief Device level at \p now, caller holds the lock. */
+	double Advance(unsigned int outputQueue, long long now) const;
+
+	/** \brief Moves the anchor to \p now, caller holds the lock. */
+	void Anchor(double deviceLevel, unsigned int outputQueue, long long now);
+
+	/** \brief Samples per second actually drained, caller holds the lock. */
+	double GetDrainRate() const { return m_SampleRate * m_Drift.GetRateFactor(); }
+
+	/** \brief Weight of a telemetry observation against the prediction. */
+	const double kCorrectionGain = 0.5;
+
+	mutable std::mutex m_Mutex;
+	bool m_Valid;
+	double m_SampleRate;
+	double m_BytesPerSample;
+	long long m_AnchorTime;
+	double m_AnchorLevel;
+	double m_AnchorQueue;
+	PlayzerXDriftEstimator m_Drift;
+};
+
+}  // namespace playzerx
+
+#endif  // PLAYZERX_ESTIMATOR_H
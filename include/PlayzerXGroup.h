@@ -0,0 +1,162 @@
+/**
+ * \file PlayzerXGroup.h
+ * \brief Defines the group that streams to many controllers in phase from one thread.
+ * \version 2.1.0.0
+ *
+ * Tiled and multi-angle projection runs several controllers on the same timeline. Started one by
+ * one, their outputs begin milliseconds apart, and since every controller plays on its own clock
+ * they drift further apart by up to a few samples per second. PlayzerXGroup runs the streaming
+ * engines of all devices in pump mode on a single I/O thread, starts their output together and
+ * keeps it together: it compares the positions of the devices in their queues, estimated from the
+ * buffer level updates, and repeats or drops single samples on the devices that run ahead or lag.
+ */
+
+#ifndef PLAYZERX_GROUP_H
+#define PLAYZERX_GROUP_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PlayzerX.h"
+
+namespace playzerx
+{
+/**
+ * \class PlayzerXGroup
+ * \brief Streams the queues of several PlayzerX objects with aligned frame starts.
+ *
+ * \code
+ * PlayzerXGroup group;
+ * for (PlayzerX& playzer : playzers)
+ *     group.AddDevice(&playzer);     // connected, with SetBufferUpdateTimer() enabled
+ * group.Start(8000);
+ * for (...)
+ *     for (size_t i = 0; i < playzers.size(); i++)
+ *         playzers[i].PushSamples(tile[i], numSamples);
+ * group.Stop();
+ * \endcode
+ * Start() clears the device buffers and holds the output back until every queue holds the target
+ * level (or is full); the first samples of all devices are then written right after each other.
+ * The application pushes the samples of each device with its Push functions, the same number
+ * of samples per frame to every device. The devices are not owned; Stop() the group before they
+ * are disconnected or destroyed. Start(), Stop() and AddDevice() are called from one thread.
+ */
+class DLLEXPORT PlayzerXGroup
+{
+   public:
+	PlayzerXGroup();
+	~PlayzerXGroup();
+
+	/**
+	 * \brief Adds a connected device to the group.
+	 * \return \c false while the group is running or if \p device is \c nullptr or already added.
+	 */
+	bool AddDevice(PlayzerX* device);
+
+	/** \brief Gets the number of devices in the group. */
+	unsigned int GetNumDevices() { return (unsigned int)m_Devices.size(); }
+
+	/** \brief Gets a device of the group, \c nullptr if \p index is out of range. */
+	PlayzerX* GetDevice(unsigned int index);
+
+	/**
+	 * \brief Starts the streaming engines of all devices on the I/O thread of the group.
+	 *
+	 * Switches the devices to pump mode, clears their buffers with "pl c" one right after the
+	 * other and starts their engines held back; see PlayzerX::StartStreaming() for the
+	 * parameters. Pump mode stays enabled on the devices until Stop().
+	 * \return \c false if a device is not connected, has no buffer level updates enabled or
+	 * could not be started, and always on Windows (see PlayzerX::SetPumpMode()); the devices
+	 * started are stopped again.
+	 */
+	bool Start(unsigned int targetBufferLevel = 10000, unsigned int ringCapacity = 65536);
+
+	/** \brief Stops the I/O thread and the engines, discarding samples not yet sent. */
+	void Stop();
+
+	/** \brief Checks if the group is running. */
+	bool IsRunning() { return m_Running.load(std::memory_order_acquire); }
+
+	/** \brief Checks if the held output of the devices was released, see Start(). */
+	bool IsReleased() { return m_Released.load(std::memory_order_acquire); }
+
+	/**
+	 * \brief Gets how far a device is ahead of the group, in samples.
+	 *
+	 * Smoothed difference between the position of the device (PlayzerX::GetStreamPhase()) and
+	 * the mean position of all devices, as of the last comparison. Negative if it lags behind.
+	 */
+	double GetPhaseError(unsigned int index);
+
+	/**
+	 * \brief Gets the net number of samples repeated on a device to keep it in phase.
+	 *
+	 * Negative if more samples were dropped than repeated. Counts from Start().
+	 */
+	long long GetPhaseCorrection(unsigned int index);
+
+	/** \brief Enables or disables the phase correction, for tests; enabled by default. */
+	void SetPhaseCorrection(bool enable) { m_Correcting.store(enable); }
+
+	/** \brief Gets the last error that occurred. */
+	PlayzerXError GetLastError() { return m_LastError; }
+
+	/** \brief Checks if an error occurred. */
+	bool HasError() { return m_LastError != PlayzerXError::SUCCESS; }
+
+   private:
+	/** \brief Interval between comparisons of the device positions, in ns. */
+	const long long kPhasePeriod = 100000000LL;
+	/** \brief Longest wait of the I/O thread, in ns. */
+	const long long kMaxWait = 20000000LL;
+	/** \brief Interval between checks of the queues before the release, in ns. */
+	const long long kReleaseCheck = 1000000LL;
+	/** \brief Smoothing of the position differences, weight of the newest comparison. */
+	const double kPhaseSmoothing = 0.25;
+	/** \brief Differences up to this many samples are left alone. */
+	const double kPhaseTolerance = 1.5;
+	/** \brief Largest correction requested per comparison, in samples. */
+	const int kMaxPhaseStep = 16;
+	/** \brief Comparisons with full buffers and no pending writes before the positions count. */
+	const unsigned int kSettleComparisons = 10;
+
+	/** \brief Stops the engines of all devices and switches them back from pump mode. */
+	void StopDevices();
+
+	/** \brief Main loop of the I/O thread. */
+	void IoThread();
+
+	/** \brief Releases the held devices once all queues are filled, \c true when released. */
+	bool TryRelease();
+
+	/** \brief Compares the device positions and shifts those off the mean. */
+	void CorrectPhase();
+
+	/** \brief Waits until a device needs attention or \p wakeUp, whichever comes first. */
+	void Wait(long long wakeUp);
+
+	std::vector<PlayzerX*> m_Devices;
+	/** \brief Smoothed phase error and net correction per device, guarded by the mutex. */
+	std::vector<double> m_PhaseErrors;
+	std::vector<long long> m_PhaseCorrections;
+	std::mutex m_PhaseMutex;
+	/** \brief Devices whose connection was closed, no longer waited on. I/O thread only. */
+	std::vector<char> m_HungUp;
+	/** \brief Device buffer level the engines maintain. */
+	unsigned int m_TargetLevel;
+	/** \brief Queue level every device needs before the output is released. */
+	unsigned int m_ReleaseLevel;
+	/** \brief Comparisons in a row without pending writes, used by the I/O thread only. */
+	unsigned int m_SteadyComparisons;
+	std::thread m_Thread;
+	std::atomic<bool> m_Running;
+	std::atomic<bool> m_Released;
+	std::atomic<bool> m_Correcting;
+	PlayzerXError m_LastError;
+};
+
+}  // namespace playzerx
+
+#endif  // PLAYZERX_GROUP_H
@@ -0,0 +1,85 @@
+/**
+ * \file PlayzerXMailbox.h
+ * \brief Defines a lock-free single sample mailbox where the latest value wins.
+ * \version 2.1.0.0
+ *
+ * Used by the PlayzerX steering mode to hand the newest beam target from any application
+ * thread to the transmit thread. A target fits in one 64 bit word, so posting and reading
+ * are a single atomic store and load; targets not read before the next post are dropped.
+ */
+
+#ifndef PLAYZERX_MAILBOX_H
+#define PLAYZERX_MAILBOX_H
+
+#include <atomic>
+
+#include "PlayzerXDefinitions.h"
+#include "PlayzerXEncoder.h"
+
+namespace playzerx
+{
+/**
+ * \class PlayzerXMailbox
+ * \brief Holds one encoded sample, replaced by every post.
+ *
+ * Bit layout of the word: 0-23 the X/Y payload bytes, 24-47 the M or R, G, B bytes, 48-49 the
+ * data format and 50 a flag set once a sample has been posted. All methods are thread safe.
+ */
+class PlayzerXMailbox
+{
+   public:
+	PlayzerXMailbox() : m_Word(0) {}
+
+	/**
+	 * \brief Replaces the content with a sample.
+	 * \param bytes One command as laid out by the encoders for \p format.
+	 */
+	void Post(PlayzerXDataFormat format, const unsigned char* bytes)
+	{
+		unsigned long long word = (unsigned long long)bytes[4] |
+								  ((unsigned long long)bytes[5] << 8) |
+								  ((unsigned long long)bytes[6] << 16);
+		if (format != PlayzerXDataFormat::XY) word |= (unsigned long long)bytes[7] << 24;
+		if (format == PlayzerXDataFormat::XYRGB)
+			word |= ((unsigned long long)bytes[8] << 32) | ((unsigned long long)bytes[9] << 40);
+		word |= ((unsigned long long)format << 48) | kPosted;
+		m_Word.store(word, std::memory_order_release);
+	}
+
+	/** \brief Empties the mailbox. */
+	void Clear() { m_Word.store(0, std::memory_order_release); }
+
+	/** \brief Checks if a sample has been posted since construction or Clear(). */
+	bool IsEmpty() const { return (m_Word.load(std::memory_order_acquire) & kPosted) == 0; }
+
+	/**
+	 * \brief Gets the latest sample.
+	 * \param bytes Receives the sample as one command, at most kBytesPerSampleXYRGB bytes.
+	 * \return Number of bytes written to \p bytes, \c 0 if the mailbox is empty.
+	 */
+	unsigned int Read(unsigned char* bytes) const
+	{
+		unsigned long long word = m_Word.load(std::memory_order_acquire);
+		if ((word & kPosted) == 0) return 0;
+
+		PlayzerXDataFormat format = (PlayzerXDataFormat)((word >> 48) & 3);
+		unsigned int numBytes = GetBytesPerSample(format);
+		bytes[0] = 'p';
+		bytes[1] = 'l';
+		bytes[2] = (format == PlayzerXDataFormat::XY) ? 'D' : 'd';
+		bytes[3] = (unsigned char)numBytes;
+		for (unsigned int i = 4; i < numBytes - 1; i++)
+			bytes[i] = (unsigned char)(word >> (8 * (i - 4)));
+		bytes[numBytes - 1] = '\n';
+		return numBytes;
+	}
+
+   private:
+	static const unsigned long long kPosted = 1ULL << 50;
+
+	std::atomic<unsigned long long> m_Word;
+};
+
+}  // namespace playzerx
+
+#endif  // PLAYZERX_MAILBOX_H
@@ -0,0 +1,83 @@
+/**
+ * \file PlayzerXPorts.h
+ * \brief Defines the serial port enumerator used for device discovery.
+ * \version 2.1.0.0
+ *
+ * On Linux the serial devices are listed from sysfs (\c /sys/class/tty) together with the USB
+ * attributes of the adapter they belong to. Nothing is opened, so enumeration has no side effects
+ * on the ports; only the ports that pass the USB filter are probed for a PlayzerX controller.
+ */
+
+#ifndef PLAYZERX_PORTS_H
+#define PLAYZERX_PORTS_H
+
+#include <string>
+#include <vector>
+
+#include "PlayzerXDefinitions.h"
+
+namespace playzerx
+{
+/**
+ * \struct PlayzerXPortInfo
+ * \brief Describes a serial port found by EnumerateSerialPorts().
+ */
+struct PlayzerXPortInfo
+{
+	/** \brief Port name (e.g., "ttyUSB0", "ttyACM1"). */
+	std::string PortName;
+	/** \brief Path of the device node (e.g., "/dev/ttyUSB0"). */
+	std::string DevicePath;
+	/** \brief Name of the kernel driver (e.g., "ftdi_sio", "cdc_acm"), empty if unknown. */
+	std::string Driver;
+	/** \brief Indicates if the port belongs to a USB device; the USB fields are only valid then. */
+	bool IsUSB;
+	/** \brief USB vendor ID. */
+	unsigned short VendorId;
+	/** \brief USB product ID. */
+	unsigned short ProductId;
+	/** \brief USB serial number string, empty if the device has none. */
+	std::string SerialNumber;
+	/** \brief USB manufacturer string. */
+	std::string Manufacturer;
+	/** \brief USB product string. */
+	std::string Product;
+};
+
+/**
+ * \struct PlayzerXUsbId
+ * \brief A USB vendor/product pair accepted by the port filter.
+ */
+struct PlayzerXUsbId
+{
+	/** \brief USB vendor ID. */
+	unsigned short VendorId;
+	/** \brief USB product ID, \c 0 to accept any product of the vendor. */
+	unsigned short ProductId;
+};
+
+/**
+ * \brief Lists the serial ports backed by real hardware, sorted by name.
+ *
+ * Virtual terminals and pseudo terminals are skipped. Ports are not opened.
+ * \param ports Receives the ports found.
+ * \param sysfsRoot Root of the sysfs tree, another directory can hold a fake tree for testing.
+ * \param devRoot Directory of the device nodes used to build PlayzerXPortInfo::DevicePath.
+ * \return \c false if the platform has no sysfs tty class (e.g., Windows, macOS); the caller
+ * then has to fall back to trying port names.
+ */
+bool EnumerateSerialPorts(std::vector<PlayzerXPortInfo>& ports,
+						  const std::string& sysfsRoot = "/sys",
+						  const std::string& devRoot = "/dev");
+
+/**
+ * \brief Checks if a port could be a PlayzerX controller.
+ *
+ * Only USB ports qualify. If \p filter is empty any USB vendor is accepted, otherwise the port
+ * must match one of its entries.
+ */
+bool IsCandidatePort(const PlayzerXPortInfo& port, const std::vector<PlayzerXUsbId>& filter);
+
+}  // namespace playzerx
+
+#endif  // PLAYZERX_PORTS_H
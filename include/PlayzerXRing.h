@@ -0,0 +1,114 @@
+/**
+ * \file PlayzerXRing.h
+ * \brief Defines a lock-free single-producer / single-consumer ring buffer.
+ * \version 2.1.0.0
+ *
+ * Used by the PlayzerX streaming engine to hand samples from the application thread
+ * to the transmit thread without locks or blocking calls on either side.
+ */
+
+#ifndef PLAYZERX_RING_H
+#define PLAYZERX_RING_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace playzerx
+{
+/**
+ * \class SpscRing
+ * \brief Fixed capacity ring buffer for exactly one producer and one consumer thread.
+ *
+ * The capacity is rounded up to a power of two. Push() may only be called from the producer
+ * thread and Pop() only from the consumer thread; both return immediately and transfer as
+ * many items as currently fit (or are available).
+ */
+template <typename T>
+class SpscRing
+{
+   public:
+	/**
+	 * \brief Constructor.
+	 * \param capacity Minimum number of items the ring can hold.
+	 */
+	explicit SpscRing(size_t capacity = 0) { Resize(capacity); }
+
+	/**
+	 * \brief Reallocates the ring and discards its content.
+	 * \note Not thread safe, only call while neither producer nor consumer is active.
+	 */
+	void Resize(size_t capacity)
+	{
+		size_t size = (capacity > 0) ? 1 : 0;
+		while (size < capacity) size <<= 1;
+		m_Buffer.assign(size, T());
+		m_Mask = (size > 0) ? size - 1 : 0;
+		m_Head.store(0, std::memory_order_relaxed);
+		m_Tail.store(0, std::memory_order_relaxed);
+	}
+
+	/** \brief Returns the number of items the ring can hold. */
+	size_t Capacity() const { return m_Buffer.size(); }
+
+	/** \brief Returns the number of items currently queued. */
+	size_t Size() const
+	{
+		return m_Head.load(std::memory_order_acquire) - m_Tail.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * \brief Appends up to \p count items (producer thread only).
+	 * \return Number of items actually queued.
+	 */
+	size_t Push(const T* items, size_t count)
+	{
+		const size_t head = m_Head.load(std::memory_order_relaxed);
+		const size_t tail = m_Tail.load(std::memory_order_acquire);
+		const size_t space = Capacity() - (head - tail);
+		const size_t n = (count < space) ? count : space;
+		for (size_t i = 0; i < n; i++) m_Buffer[(head + i) & m_Mask] = items[i];
+		m_Head.store(head + n, std::memory_order_release);
+		return n;
+	}
+
+	/**
+	 * \brief Removes up to \p count items (consumer thread only).
+	 * \return Number of items actually copied to \p items.
+	 */
+	size_t Pop(T* items, size_t count)
+	{
+		const size_t tail = m_Tail.load(std::memory_order_relaxed);
+		const size_t head = m_Head.load(std::memory_order_acquire);
+		const size_t available = head - tail;
+		const size_t n = (count < available) ? count : available;
+		for (size_t i = 0; i < n; i++) items[i] = m_Buffer[(tail + i) & m_Mask];
+		m_Tail.store(tail + n, std::memory_order_release);
+		return n;
+	}
+
+	/** \brief Drops all queued items (consumer thread only). */
+	void Clear()
+	{
+		m_Tail.store(m_Head.load(std::memory_order_acquire), std::memory_order_release);
+	}
+
+   private:
+	/** \brief Cache line size the indices are kept apart by. */
+	static const size_t kCacheLine = 64;
+
+	std::vector<T> m_Buffer;
+	size_t m_Mask;
+	// Producer and consumer indices live on separate cache lines to avoid false sharing. Padding
+	// instead of alignas() keeps the owners of the ring at the default alignment, which plain
+	// new and std::vector honour before C++17.
+	char m_HeadPad[kCacheLine];
+	std::atomic<size_t> m_Head;
+	char m_TailPad[kCacheLine - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> m_Tail;
+	char m_EndPad[kCacheLine - sizeof(std::atomic<size_t>)];
+};
+
+}  // namespace playzerx
+
+#endif  // PLAYZERX_RING_H
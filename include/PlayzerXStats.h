@@ -0,0 +1,287 @@
+/**
+ * \file PlayzerXStats.h
+ * \brief Defines the performance counters kept for each device.
+ * \version 2.1.0.0
+ *
+ * The counters are updated with relaxed atomic operations on every write, wait and buffer level
+ * reading, so they are always on and cost a few nanoseconds per operation. Host starvation shows
+ * as low buffer levels and underruns while little time is spent waiting; link saturation shows as
+ * partial writes and time blocked in writes.
+ *
+ * PlayzerXBufferMonitor turns the same buffer level readings into low-water and underrun events.
+ */
+
+#ifndef PLAYZERX_STATS_H
+#define PLAYZERX_STATS_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+namespace playzerx
+{
+/**
+ * \struct PlayzerXStats
+ * \brief Snapshot of the performance counters of a device. Times are in nanoseconds.
+ */
+struct PlayzerXStats
+{
+	/** \brief Bytes written to the serial port, sample data and commands. */
+	unsigned long long BytesWritten;
+	/** \brief Samples written to the serial port. */
+	unsigned long long SamplesWritten;
+	/** \brief Write calls to the serial port, sample data and commands. */
+	unsigned long long WriteCalls;
+	/** \brief Writes the serial driver could not take at once because its buffer was full. */
+	unsigned long long PartialWrites;
+	/** \brief Time spent blocked in serial port writes and waiting for their transmission. */
+	unsigned long long WriteTime;
+	/** \brief Calls to WaitForBufferLevel() with a level to wait for. */
+	unsigned long long Waits;
+	/** \brief Time spent blocked in WaitForBufferLevel(). */
+	unsigned long long WaitTime;
+	/** \brief Buffer level requests answered by the device. */
+	unsigned long long TelemetryRoundTrips;
+	/** \brief Buffer level readings received, requested or periodic. */
+	unsigned long long TelemetryUpdates;
+	/** \brief Lowest buffer level reported by the device, \c -1 if none was received. */
+	int MinBufferLevel;
+	/** \brief Times the device reported an empty buffer after a non-empty one. */
+	unsigned long long Underruns;
+	/** \brief Times the buffer level fell to the low-water level, see PlayzerXBufferMonitor. */
+	unsigned long long LowWaterEvents;
+	/** \brief Serial port operations that failed or timed out. */
+	unsigned long long SerialErrors;
+};
+
+/**
+ * \class PlayzerXCounters
+ * \brief Lock-free accumulators behind PlayzerXStats. All methods are thread safe.
+ */
+class PlayzerXCounters
+{
+   public:
+	PlayzerXCounters() { Reset(); }
+
+	/** \brief Sets all counters to zero and forgets the minimum buffer level. */
+	void Reset()
+	{
+		m_BytesWritten.store(0, std::memory_order_relaxed);
+		m_SamplesWritten.store(0, std::memory_order_relaxed);
+		m_WriteCalls.store(0, std::memory_order_relaxed);
+		m_PartialWrites.store(0, std::memory_order_relaxed);
+		m_WriteTime.store(0, std::memory_order_relaxed);
+		m_Waits.store(0, std::memory_order_relaxed);
+		m_WaitTime.store(0, std::memory_order_relaxed);
+		m_TelemetryRoundTrips.store(0, std::memory_order_relaxed);
+		m_TelemetryUpdates.store(0, std::memory_order_relaxed);
+		m_MinBufferLevel.store(-1, std::memory_order_relaxed);
+		m_Underruns.store(0, std::memory_order_relaxed);
+		m_LowWaterEvents.store(0, std::memory_order_relaxed);
+		m_SerialErrors.store(0, std::memory_order_relaxed);
+	}
+
+	/** \brief Accounts for one write call of \p numBytes bytes holding \p numSamples samples. */
+	void OnWrite(unsigned int numBytes, unsigned int numSamples, long long time,
+				 unsigned int partialWrites, bool failed)
+	{
+		m_WriteCalls.fetch_add(1, std::memory_order_relaxed);
+		m_BytesWritten.fetch_add(numBytes, std::memory_order_relaxed);
+		m_SamplesWritten.fetch_add(numSamples, std::memory_order_relaxed);
+		m_WriteTime.fetch_add(time, std::memory_order_relaxed);
+		if (partialWrites) m_PartialWrites.fetch_add(partialWrites, std::memory_order_relaxed);
+		if (failed) OnSerialError();
+	}
+
+	/** \brief Accounts for time spent waiting for a transmission to complete. */
+	void OnDrain(long long time, bool failed)
+	{
+		m_WriteTime.fetch_add(time, std::memory_order_relaxed);
+		if (failed) OnSerialError();
+	}
+
+	/** \brief Accounts for a WaitForBufferLevel() call that blocked for \p time. */
+	void OnWait(long long time)
+	{
+		m_Waits.fetch_add(1, std::memory_order_relaxed);
+		m_WaitTime.fetch_add(time, std::memory_order_relaxed);
+	}
+
+	/** \brief Accounts for a buffer level request answered by the device. */
+	void OnRoundTrip() { m_TelemetryRoundTrips.fetch_add(1, std::memory_order_relaxed); }
+
+	/** \brief Accounts for a buffer level reading, tracking the minimum. */
+	void OnBufferLevel(int level)
+	{
+		m_TelemetryUpdates.fetch_add(1, std::memory_order_relaxed);
+		int minimum = m_MinBufferLevel.load(std::memory_order_relaxed);
+		while ((minimum < 0 || level < minimum) &&
+			   !m_MinBufferLevel.compare_exchange_weak(minimum, level, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	/** \brief Accounts for an underrun detected by PlayzerXBufferMonitor. */
+	void OnUnderrun() { m_Underruns.fetch_add(1, std::memory_order_relaxed); }
+
+	/** \brief Accounts for a low-water event detected by PlayzerXBufferMonitor. */
+	void OnLowWater() { m_LowWaterEvents.fetch_add(1, std::memory_order_relaxed); }
+
+	/** \brief Accounts for a failed or timed out serial port operation. */
+	void OnSerialError() { m_SerialErrors.fetch_add(1, std::memory_order_relaxed); }
+
+	/** \brief Gets the current values. Counters updated concurrently may be one update apart. */
+	PlayzerXStats GetStats() const
+	{
+		PlayzerXStats stats;
+		stats.BytesWritten = m_BytesWritten.load(std::memory_order_relaxed);
+		stats.SamplesWritten = m_SamplesWritten.load(std::memory_order_relaxed);
+		stats.WriteCalls = m_WriteCalls.load(std::memory_order_relaxed);
+		stats.PartialWrites = m_PartialWrites.load(std::memory_order_relaxed);
+		stats.WriteTime = m_WriteTime.load(std::memory_order_relaxed);
+		stats.Waits = m_Waits.load(std::memory_order_relaxed);
+		stats.WaitTime = m_WaitTime.load(std::memory_order_relaxed);
+		stats.TelemetryRoundTrips = m_TelemetryRoundTrips.load(std::memory_order_relaxed);
+		stats.TelemetryUpdates = m_TelemetryUpdates.load(std::memory_order_relaxed);
+		stats.MinBufferLevel = m_MinBufferLevel.load(std::memory_order_relaxed);
+		stats.Underruns = m_Underruns.load(std::memory_order_relaxed);
+		stats.LowWaterEvents = m_LowWaterEvents.load(std::memory_order_relaxed);
+		stats.SerialErrors = m_SerialErrors.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+   private:
+	std::atomic<unsigned long long> m_BytesWritten;
+	std::atomic<unsigned long long> m_SamplesWritten;
+	std::atomic<unsigned long long> m_WriteCalls;
+	std::atomic<unsigned long long> m_PartialWrites;
+	std::atomic<unsigned long long> m_WriteTime;
+	std::atomic<unsigned long long> m_Waits;
+	std::atomic<unsigned long long> m_WaitTime;
+	std::atomic<unsigned long long> m_TelemetryRoundTrips;
+	std::atomic<unsigned long long> m_TelemetryUpdates;
+	std::atomic<int> m_MinBufferLevel;
+	std::atomic<unsigned long long> m_Underruns;
+	std::atomic<unsigned long long> m_LowWaterEvents;
+	std::atomic<unsigned long long> m_SerialErrors;
+};
+
+/**
+ * \brief Kinds of device buffer events reported by PlayzerXBufferMonitor.
+ */
+enum struct PlayzerXBufferEvent : unsigned char
+{
+	/**
+	 * \brief The buffer level fell to or below the low-water level.
+	 */
+	LOW_WATER = 0,
+
+	/**
+	 * \brief The device reported an empty buffer after a non-empty one; output has stopped.
+	 */
+	UNDERRUN
+};
+
+/**
+ * \struct PlayzerXBufferEventInfo
+ * \brief Details of a device buffer event.
+ */
+struct PlayzerXBufferEventInfo
+{
+	/** \brief Kind of event. */
+	PlayzerXBufferEvent Event;
+	/** \brief Buffer level reading that raised the event, in samples. */
+	int Level;
+	/** \brief Host time the reading was received, see PlayzerXTelemetry::Now(). */
+	long long Timestamp;
+	/** \brief Number of events of this kind so far, including this one. */
+	unsigned long long Count;
+};
+
+/** \brief Function called on device buffer events. */
+typedef std::function<void(const PlayzerXBufferEventInfo& info)> PlayzerXBufferCallback;
+
+/**
+ * \class PlayzerXBufferMonitor
+ * \brief Detects low-water and underrun events in the buffer level readings of a device.
+ *
+ * Events are edge triggered: a low-water event is raised when a reading at or below the
+ * low-water level follows one above it, an underrun when an empty reading follows a non-empty
+ * one. Only readings are seen, so an underrun shorter than the update interval may be missed.
+ * All methods are thread safe.
+ */
+class PlayzerXBufferMonitor
+{
+   public:
+	PlayzerXBufferMonitor()
+	{
+		m_LowWaterLevel = 0;
+		m_LastLevel = -1;
+		m_Underruns = 0;
+		m_LowWaterEvents = 0;
+	}
+
+	/**
+	 * \brief Sets the function called on events and the low-water level.
+	 * \param callback Called on the thread that received the reading, empty for none.
+	 * \param lowWaterLevel Low-water level in samples, \c 0 to report underruns only.
+	 */
+	void SetCallback(const PlayzerXBufferCallback& callback, unsigned int lowWaterLevel)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Callback = callback;
+		m_LowWaterLevel = (int)lowWaterLevel;
+	}
+
+	/** \brief Forgets the last reading, so that the next one cannot raise an event. */
+	void Reset()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_LastLevel = -1;
+	}
+
+	/**
+	 * \brief Checks a buffer level reading for events and reports them.
+	 * \param counters Counters the events are accounted in.
+	 */
+	void OnBufferLevel(int level, long long timestamp, PlayzerXCounters& counters)
+	{
+		PlayzerXBufferEventInfo events[2];
+		int numEvents = 0;
+		PlayzerXBufferCallback callback;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			int last = m_LastLevel;
+			m_LastLevel = level;
+			if (m_LowWaterLevel > 0 && level <= m_LowWaterLevel && last > m_LowWaterLevel)
+			{
+				counters.OnLowWater();
+				events[numEvents++] = {PlayzerXBufferEvent::LOW_WATER, level, timestamp,
+									   ++m_LowWaterEvents};
+			}
+			if (level == 0 && last > 0)
+			{
+				counters.OnUnderrun();
+				events[numEvents++] = {PlayzerXBufferEvent::UNDERRUN, level, timestamp,
+									   ++m_Underruns};
+			}
+			if (numEvents == 0 || !m_Callback) return;
+			callback = m_Callback;
+		}
+
+		// Called without the lock so that the callback may change the settings
+		for (int i = 0; i < numEvents; i++) callback(events[i]);
+	}
+
+   private:
+	std::mutex m_Mutex;
+	PlayzerXBufferCallback m_Callback;
+	int m_LowWaterLevel;
+	int m_LastLevel;
+	unsigned long long m_Underruns;
+	unsigned long long m_LowWaterEvents;
+};
+
+}  // namespace playzerx
+
+#endif  // PLAYZERX_STATS_H
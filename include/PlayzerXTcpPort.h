@@ -0,0 +1,82 @@
+/**
+ * \file PlayzerXTcpPort.h
+ * \brief Defines the transport to controllers behind serial-to-Ethernet bridges.
+ * \version 2.1.0.0
+ *
+ * Bridges such as ser2net forward a TCP connection to the serial port of a controller. PlayzerX
+ * uses this transport for port names of the form "tcp://host:port" (IPv6 hosts in brackets,
+ * e.g. "tcp://[fe80::1]:4001"); the protocol, framing and flow control stay the same. Linux only.
+ */
+
+#ifndef PLAYZERX_TCP_PORT_H
+#define PLAYZERX_TCP_PORT_H
+
+#include <string>
+
+#include "MTISerial.h"
+
+namespace playzerx
+{
+/**
+ * \class PlayzerXTcpPort
+ * \brief MTISerialIO on a non-blocking TCP socket.
+ *
+ * Nagle's algorithm is disabled, so that commands leave at once. The send buffer holds two XYM
+ * chunks of SendData() (4096 samples each), so a chunk goes to the kernel in one call instead of
+ * the many partial writes a serial driver needs; the output queue reports the bytes the bridge
+ * has not acknowledged yet.
+ * The receive buffer holds many seconds of "pl-" records, so a busy host never stalls the
+ * bridge. Raw TCP only: RFC 2217 option negotiation is not done, configure the bridge for
+ * 921600 baud, 8N1 and no flow control.
+ */
+class PlayzerXTcpPort : public MTISerialIO
+{
+   public:
+	/** \brief Checks if \p portName is a "tcp://" name handled by this transport. */
+	static bool IsTcpPortName(const std::string& portName);
+
+	/**
+	 * \brief Connects to the bridge at "tcp://host:port".
+	 * \return \c MTI_ERR_INVALID_DEVICEID if the name is invalid or no connection could be made.
+	 */
+	long Open(const char* port, unsigned int baudRate = MTI_BAUDRATE_DEFAULT,
+			  unsigned int inQueue = MTI_SERIAL_QUEUE_SIZE,
+			  unsigned int outQueue = MTI_SERIAL_QUEUE_SIZE) override;
+
+	/** \brief Drops the bytes received but not read yet. Bytes already sent cannot be recalled. */
+	long Purge() override;
+
+	/** \brief Does nothing, the baud rate is a setting of the bridge. */
+	long SetSerialParams(unsigned int baudRate = MTI_BAUDRATE_DEFAULT) override;
+
+	/**
+	 * \brief Reads like the serial port, but a closed connection fails instead of returning
+	 * nothing over and over.
+	 */
+	long Read(unsigned char* pData, size_t lData, unsigned int* lRead = 0,
+			  unsigned int timeout = INFINITE, int blockingMode = MTI_BLOCKING_MODE_ON) override;
+
+	/**
+	 * \brief Sends without raising SIGPIPE; a closed or reset connection returns
+	 * \c MTI_ERR_SERIALCOMM.
+	 */
+	long WriteQueued(unsigned char* pData, size_t lData, unsigned int* lWritten = 0,
+					 unsigned int timeout = INFINITE) override;
+
+   protected:
+	/** \brief Receives from the socket; end of stream and errors return \c MTI_ERR_SERIALCOMM. */
+	long ReadRaw(unsigned char* pData, size_t lData, unsigned int* lRead,
+				 unsigned int timeout) override;
+
+   private:
+	/** \brief Time allowed to establish the connection, in milliseconds. */
+	const int kConnectTimeout = 3000;
+	/** \brief Socket send buffer, two 4096 sample chunks of XYM samples (9 bytes each). */
+	const int kSendBuffer = 72 * 1024;
+	/** \brief Socket receive buffer. */
+	const int kReceiveBuffer = 256 * 1024;
+};
+
+}  // namespace playzerx
+
+#endif  // PLAYZERX_TCP_PORT_H
@@ -0,0 +1,190 @@
+/**
+ * \file PlayzerXTelemetry.h
+ * \brief Defines the reader for the "samples remaining" updates streamed by the controller.
+ * \version 2.1.0.0
+ *
+ * After SetBufferUpdateTimer() the controller sends a 6 byte "pl-" record with its buffer level
+ * every few milliseconds. PlayzerXTelemetry consumes that stream on its own thread, or in Poll()
+ * calls from an event loop, and publishes the latest level so that readers never touch the serial
+ * port.
+ */
+
+#ifndef PLAYZERX_TELEMETRY_H
+#define PLAYZERX_TELEMETRY_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "MTISerial.h"
+
+namespace playzerx
+{
+/**
+ * \class PlayzerXTelemetryParser
+ * \brief Resynchronizing parser for "pl-" + 24 bit little endian buffer level records.
+ *
+ * Bytes are fed one at a time; garbage or partial records before a preamble are skipped.
+ */
+class PlayzerXTelemetryParser
+{
+   public:
+	PlayzerXTelemetryParser() { Reset(); }
+
+	/** \brief Drops any partially received record. */
+	void Reset()
+	{
+		m_State = 0;
+		m_Value = 0;
+	}
+
+	/**
+	 * \brief Feeds one received byte.
+	 * \param byte The received byte.
+	 * \param level Receives the buffer level when a record completes.
+	 * \return \c true if \p byte completed a record.
+	 */
+	bool Feed(unsigned char byte, int& level)
+	{
+		switch (m_State)
+		{
+		case 0: m_State = (byte == 'p') ? 1 : 0; return false;
+		case 1: m_State = (byte == 'l') ? 2 : (byte == 'p') ? 1 : 0; return false;
+		case 2:
+			m_State = (byte == '-') ? 3 : (byte == 'p') ? 1 : 0;
+			m_Value = 0;
+			return false;
+		default:
+			// Payload bytes are binary and taken unconditionally
+			m_Value += byte << (8 * (m_State - 3));
+			if (++m_State < 6) return false;
+			level = m_Value;
+			Reset();
+			return true;
+		}
+	}
+
+   private:
+	int m_State;
+	int m_Value;
+};
+
+/**
+ * \class PlayzerXTelemetry
+ * \brief Background reader publishing the latest device buffer level and its timestamp.
+ *
+ * The level and timestamp are published through a sequence lock, so GetLatest() costs a few
+ * atomic loads and no system calls.
+ */
+class PlayzerXTelemetry
+{
+   public:
+	PlayzerXTelemetry();
+	~PlayzerXTelemetry();
+
+	/**
+	 * \brief Starts the reader thread on an open serial port.
+	 * \return \c true if the reader is running.
+	 */
+	bool Start(MTISerialIO* serial);
+
+	/**
+	 * \brief Consumes the updates on an open serial port in Poll() calls instead of a thread.
+	 * \return \c true if the reader is running.
+	 */
+	bool Attach(MTISerialIO* serial);
+
+	/**
+	 * \brief Parses the bytes received since the last call without waiting, after Attach().
+	 * \return \c true if a new level was published.
+	 */
+	bool Poll();
+
+	/**
+	 * \brief Sets the function every received buffer level is reported to, with its timestamp.
+	 *
+	 * Called on the reader thread, or in Poll(); set it before Start() or Attach().
+	 */
+	void SetLevelListener(const std::function<void(int level, long long timestamp)>& listener)
+	{
+		m_LevelListener = listener;
+	}
+
+	/** \brief Stops the reader thread or detaches from Poll(). Unparsed bytes are dropped. */
+	void Stop();
+
+	/** \brief Checks if the updates are consumed, by the reader thread or by Poll(). */
+	bool IsRunning() const { return m_Running.load(std::memory_order_acquire); }
+
+	/**
+	 * \brief Gets the latest published buffer level.
+	 * \param level Receives the number of samples remaining in the device buffer.
+	 * \param timestamp Receives the host time (see Now()) the record was received.
+	 * \return \c false if no record has been received since Start().
+	 */
+	bool GetLatest(int& level, long long& timestamp) const;
+
+	/** \brief Number of level updates published since Start(). */
+	unsigned long long GetUpdateCount() const
+	{
+		return m_Generation.load(std::memory_order_acquire) / 2;
+	}
+
+	/**
+	 * \brief Blocks until more than \p count level updates have been published.
+	 * \param count Update count previously returned by GetUpdateCount().
+	 * \param timeout Timeout in milliseconds.
+	 * \return \c false on timeout or if the reader is not running.
+	 */
+	bool WaitForUpdate(unsigned long long count, unsigned int timeout);
+
+	/** \brief Monotonic host time in nanoseconds used for all telemetry timestamps. */
+	static long long Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+				   std::chrono::steady_clock::now().time_since_epoch())
+			.count();
+	}
+
+	/** \brief Sleeps until the host time \p time (see Now()). */
+	static void SleepUntil(long long time)
+	{
+		std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::nanoseconds(time))));
+	}
+
+   private:
+	/** \brief Reader thread main loop. */
+	void ReaderThread();
+
+	/**
+	 * \brief Parses received bytes and publishes the newest record among them.
+	 * \return \c true if a record was published.
+	 */
+	bool Consume(const unsigned char* data, unsigned int numRead, long long timestamp);
+
+	/** \brief Publishes a new record to readers and wakes up waiters. */
+	void Publish(int level, long long timestamp);
+
+	PlayzerXTelemetryParser m_Parser;
+	std::function<void(int level, long long timestamp)> m_LevelListener;
+	MTISerialIO* m_Serial;
+	std::thread m_Thread;
+	std::atomic<bool> m_Running;
+
+	// Sequence lock: odd while the reader thread updates level and timestamp
+	std::atomic<unsigned long long> m_Generation;
+	std::atomic<int> m_Level;
+	std::atomic<long long> m_Timestamp;
+
+	std::mutex m_WaitMutex;
+	std::condition_variable m_WaitCondition;
+};
+
+}  // namespace playzerx
+
+#endif  // PLAYZERX_TELEMETRY_H
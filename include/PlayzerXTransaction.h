@@ -0,0 +1,109 @@
+/**
+ * \file PlayzerXTransaction.h
+ * \brief Defines a batch of commands and samples sent to the device in a single write.
+ * \version 2.1.0.0
+ *
+ * Separate calls reach the controller with gaps between them. A transaction lays out commands
+ * such as "pl c" (clear) and "pl r" (sample rate) and the samples that follow them back to back,
+ * so that PlayzerX::Commit() can hand them to the serial port at once.
+ */
+
+#ifndef PLAYZERX_TRANSACTION_H
+#define PLAYZERX_TRANSACTION_H
+
+#include <vector>
+
+#include "PlayzerXDefinitions.h"
+#include "PlayzerXEncoder.h"
+
+namespace playzerx
+{
+/**
+ * \class PlayzerXTransaction
+ * \brief Commands and samples queued in order for PlayzerX::Commit().
+ *
+ * The functions mirror those of PlayzerX and return the transaction, so that calls can be
+ * chained. For example, an instant cut to new content:
+ * \code
+ * PlayzerXTransaction cut;
+ * cut.ClearData().SetSampleRate(20000).SendDataXYM(x, y, m, 4096);
+ * playzer->Commit(cut);
+ * \endcode
+ * The samples of a transaction should fit into the free space of the device buffer. To cut to
+ * long content, put its first chunk in the transaction and send the rest with SendData.
+ */
+class DLLEXPORT PlayzerXTransaction
+{
+   public:
+	PlayzerXTransaction();
+
+	/** \brief Adds a "pl c" command, which empties the device buffer when it arrives. */
+	PlayzerXTransaction& ClearData();
+
+	/** \brief Adds a "pl r" command; \p sampleRate is limited to 200 - 50000 samples/s. */
+	PlayzerXTransaction& SetSampleRate(unsigned int sampleRate);
+
+	/** \brief Adds a "pl u" command; \p bufferUpdateTimer is limited to 1000 ms, 0 disables. */
+	PlayzerXTransaction& SetBufferUpdateTimer(unsigned int bufferUpdateTimer);
+
+	/** \brief Adds XYM samples. */
+	PlayzerXTransaction& SendDataXYM(const float* x, const float* y, const unsigned char* m,
+									 unsigned int numSamples);
+
+	/** \brief Adds XY samples. */
+	PlayzerXTransaction& SendDataXY(const float* x, const float* y, unsigned int numSamples);
+
+	/** \brief Adds XYRGB samples. */
+	PlayzerXTransaction& SendDataXYRGB(const float* x, const float* y, const unsigned char* r,
+									   const unsigned char* g, const unsigned char* b,
+									   unsigned int numSamples);
+
+	/** \brief Adds the samples of an encoded frame. */
+	PlayzerXTransaction& SendFrame(const EncodedFrame& frame);
+
+	/** \brief Removes all commands and samples, keeping the memory for reuse. */
+	void Clear();
+
+	/** \brief Checks if nothing has been added. */
+	bool IsEmpty() const { return m_Bytes.empty(); }
+
+	/** \brief Gets the wire bytes, \c nullptr if the transaction is empty. */
+	const unsigned char* GetData() const { return m_Bytes.empty() ? nullptr : &m_Bytes[0]; }
+
+	/** \brief Gets the total number of wire bytes. */
+	unsigned int GetNumBytes() const { return (unsigned int)m_Bytes.size(); }
+
+	/** \brief Gets the number of samples added. */
+	unsigned int GetNumSamples() const { return m_NumSamples; }
+
+	/** \brief Checks if the transaction clears the device buffer. */
+	bool HasClear() const { return m_HasClear; }
+
+	/** \brief Gets the number of samples added after the last clear, i.e. those that play. */
+	unsigned int GetNumSamplesAfterClear() const { return m_SamplesAfterClear; }
+
+	/** \brief Gets the wire bytes of the samples added after the last clear. */
+	unsigned int GetSampleBytesAfterClear() const { return m_SampleBytesAfterClear; }
+
+	/** \brief Gets the last sample rate set, \c -1 if none. */
+	int GetSampleRate() const { return m_SampleRate; }
+
+	/** \brief Gets the last buffer update interval set, \c -1 if none. */
+	int GetBufferUpdateTimer() const { return m_BufferUpdateTimer; }
+
+   private:
+	/** \brief Appends room for \p numSamples samples of \p bytesPerSample bytes. */
+	unsigned char* AddSamples(unsigned int numSamples, unsigned int bytesPerSample);
+
+	std::vector<unsigned char> m_Bytes;
+	unsigned int m_NumSamples;
+	bool m_HasClear;
+	unsigned int m_SamplesAfterClear;
+	unsigned int m_SampleBytesAfterClear;
+	int m_SampleRate;
+	int m_BufferUpdateTimer;
+};
+
+}  // namespace playzerx
+
+#endif  // PLAYZERX_TRANSACTION_H
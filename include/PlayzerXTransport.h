@@ -0,0 +1,38 @@
+/**
+ * \file PlayzerXTransport.h
+ * \brief Defines how PlayzerX creates the byte stream it talks to a device over.
+ * \version 2.1.0.0
+ *
+ * By default PlayzerX opens an MTISerialIO for every port it connects to or probes. A transport
+ * factory replaces that step: it gets the port name and returns any MTISerialIO subclass, e.g. a
+ * network connection or an in-memory device model (see PlayzerXLoopback in the simulator).
+ *
+ * Built-in transports, used for the names no factory takes:
+ * - TCP: PlayzerXTcpPort, for names of the form "tcp://host:port".
+ * - Serial: MTISerialIO, for every other name.
+ * - Pseudo terminal: also MTISerialIO; pass the full path (e.g. "/dev/pts/3") as port name.
+ */
+
+#ifndef PLAYZERX_TRANSPORT_H
+#define PLAYZERX_TRANSPORT_H
+
+#include <functional>
+#include <string>
+
+#include "MTISerial.h"
+
+namespace playzerx
+{
+/**
+ * \brief Creates the transport for a port name.
+ *
+ * Returns a new, not yet opened object, which PlayzerX opens with the port name, owns and deletes,
+ * or \c nullptr to leave the name to the built-in transports. A name taken by a factory is
+ * passed to MTISerialIO::Open() as given. Called from the threads of
+ * PlayzerX::GetAvailableDevices() as well, so it has to be thread safe.
+ */
+typedef std::function<MTISerialIO*(const std::string& portName)> PlayzerXTransportFactory;
+
+}  // namespace playzerx
+
+#endif  // PLAYZERX_TRANSPORT_H
@@ -0,0 +1,140 @@
+/**
+ * \file PlayzerXUring.h
+ * \brief Defines an io_uring I/O engine serving the ports of many controllers.
+ * \version 2.1.0.0
+ *
+ * With the built-in transports every write, every wait for room and every read of "pl-" records
+ * is a system call on the thread doing it, for every device. PlayzerXUring serves all ports of a
+ * process from one Linux io_uring instead: sample data is copied into per-port buffers registered
+ * with the kernel and written with fixed-buffer requests, a read stays outstanding on every port
+ * for the device replies, and one completion thread collects finished requests. While data is
+ * streamed, that thread submits the writes of all ports together once per millisecond, in the
+ * same system call that waits for the completions.
+ *
+ * Only built when configured with -DPLAYZERX_IO_URING=ON (Linux 5.6 or later). Otherwise, or if
+ * the kernel refuses to create the ring, IsAvailable() is \c false and the transport factory
+ * leaves every port to the built-in poll/read/write transports.
+ */
+
+#ifndef PLAYZERX_URING_H
+#define PLAYZERX_URING_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PlayzerXTransport.h"
+
+namespace playzerx
+{
+class PlayzerXUringPort;
+
+/** \brief Activity of a PlayzerXUring since it was created. */
+struct PlayzerXUringStats
+{
+	/** \brief Requests handed to the kernel: reads, writes and cancellations. */
+	unsigned long long Submissions;
+	/** \brief io_uring_enter() calls, for submitting and for waiting. */
+	unsigned long long EnterCalls;
+	/** \brief Requests completed. */
+	unsigned long long Completions;
+	/** \brief Bytes written to all ports. */
+	unsigned long long BytesWritten;
+	/** \brief Bytes received from all ports. */
+	unsigned long long BytesRead;
+	/** \brief Whether the port buffers are registered, i.e. fixed-buffer requests are used. */
+	bool RegisteredBuffers;
+};
+
+/**
+ * \class PlayzerXUring
+ * \brief One io_uring and its completion thread, shared by the ports of many PlayzerX objects.
+ *
+ * \code
+ * PlayzerXUring uring;
+ * for (PlayzerX& playzer : playzers)
+ *     playzer.SetTransportFactory(uring.GetTransportFactory());
+ * \endcode
+ * Ports behave like the serial port, including WriteQueued() with a timeout of 0 for pump mode,
+ * but have no file descriptor to wait on; Pump() users sleep until the time it returns.
+ * All methods are thread safe. All ports have to be closed before the object is destroyed.
+ */
+class PlayzerXUring
+{
+   public:
+	/** \param maxPorts Number of ports that can be open at the same time. */
+	explicit PlayzerXUring(unsigned int maxPorts = 16);
+	~PlayzerXUring();
+
+	/** \brief Checks if io_uring is compiled in and the ring was created. */
+	bool IsAvailable() const { return m_RingFd >= 0; }
+
+	/**
+	 * \brief Gets a factory that opens serial ports and pseudo terminals through this ring.
+	 *
+	 * Returns \c nullptr for "tcp://" names, when all ports are in use and when IsAvailable() is
+	 * \c false, so the built-in transports take over.
+	 */
+	PlayzerXTransportFactory GetTransportFactory();
+
+	/** \brief Gets a snapshot of the counters. */
+	PlayzerXUringStats GetStats();
+
+   private:
+	friend class PlayzerXUringPort;
+
+	/** \brief Registered write buffer per port, two chunks of 4096 XYM samples of 9 bytes. */
+	const unsigned int kWriteBufferSize = 72 * 1024;
+	/** \brief Registered read buffer per port. */
+	const unsigned int kReadBufferSize = 4096;
+	/** \brief Writes are submitted in batches this often by the completion thread, in ns. */
+	const long long kSubmitPeriod = 1000000LL;
+	/** \brief Time without writes after which the completion thread stops batching, in ns. */
+	const long long kIdleDelay = 20000000LL;
+
+	bool Attach(PlayzerXUringPort* port);
+	void Detach(PlayzerXUringPort* port);
+	bool Queue(unsigned char opcode, int fd, unsigned long long address, unsigned int length,
+			   int bufferIndex, unsigned long long userData);
+	void Submit(std::unique_lock<std::mutex>& lock);
+	void SubmitLater(std::unique_lock<std::mutex>& lock);
+	void StartRead(PlayzerXUringPort* port);
+	void StartWrite(PlayzerXUringPort* port);
+	void Complete(unsigned long long userData, int result);
+	void CompletionThread();
+
+	unsigned int m_MaxPorts;
+	int m_RingFd;
+	/** \brief Ring memory shared with the kernel. */
+	void* m_RingMemory;
+	size_t m_RingSize;
+	void* m_EntryMemory;
+	size_t m_EntrySize;
+	unsigned int* m_SqHead;
+	unsigned int* m_SqTail;
+	unsigned int* m_SqMask;
+	unsigned int* m_SqArray;
+	unsigned int* m_CqHead;
+	unsigned int* m_CqTail;
+	unsigned int* m_CqMask;
+	void* m_Completions;
+	/** \brief Whether the kernel can wait with a timeout (Linux 5.11), needed for batching. */
+	bool m_TimedWait;
+	/** \brief The completion thread waits without timeout, new entries have to be submitted. */
+	bool m_Sleeping;
+	/** \brief Time of the last write queued. */
+	long long m_LastWrite;
+	/** \brief Write and read buffers of all ports, registered with the kernel if possible. */
+	std::vector<unsigned char> m_Buffers;
+	std::vector<PlayzerXUringPort*> m_Ports;
+	/** \brief Guards everything above and the state of the ports. */
+	std::mutex m_Mutex;
+	std::thread m_Thread;
+	bool m_Stopping;
+	PlayzerXUringStats m_Stats;
+};
+
+}  // namespace playzerx
+
+#endif  // PLAYZERX_URING_H
@@ -9,6 +9,7 @@
 #define MTI_SERIAL_MAXPORTS			64
 #define MTI_BAUDRATE_DEFAULT		921600
 #define MTI_SERIAL_QUEUE_SIZE		8192*16
+#define MTI_SERIAL_RX_BUFFER_SIZE	4096
 #define SERIAL_HARDWARE_FLOW_CONTROL 0
 
 #define STRICT
@@ -49,30 +50,68 @@ public:
 	// Close the serial port.
 	virtual long Close (void);
 	// Purge all buffers
-	long Purge (void);
+	virtual long Purge (void);
 
 	// Set serial port params
 	virtual long SetSerialParams (unsigned int baudRate = MTI_BAUDRATE_DEFAULT);
 	// Read operations can be blocking or non-blocking.
 	virtual long SetBlockingMode (int blockingMode = MTI_BLOCKING_MODE_ON);
 
-	// Write data to the serial port.
+	// Write data to the serial port and wait until it has been transmitted. On Unix, a timeout of 0 returns once queued.
 	virtual long Write (unsigned char* pData, size_t lData, unsigned int* lWritten = 0, unsigned int timeout = INFINITE);
 
 	// Read data from the serial port
 	virtual long Read (unsigned char* pData, size_t lData, unsigned int* lRead = 0, unsigned int timeout = INFINITE, int blockingMode = MTI_BLOCKING_MODE_ON);
 	// read text from serial port.  wait for characters until a \n is received, then return char*.  otherwise time out
 	virtual long ReadText (char* text, unsigned char delineationCharacter, unsigned int timeout = INFINITE);
+	// Read one line without the delimiter into text (lText bytes including the terminating 0). Input is read in bulk
+	// into an internal buffer; bytes after the delimiter stay there for the next call. The timeout covers the whole line.
+	virtual long ReadLine (char* text, size_t lText, unsigned char delineationCharacter = '\n', unsigned int timeout = INFINITE);
+	// Read exactly lData bytes through the internal buffer. The timeout covers the whole transfer.
+	virtual long ReadExact (unsigned char* pData, size_t lData, unsigned int timeout = INFINITE);
+	// Get the number of bytes written but not yet transmitted by the driver
+	virtual long GetOutputQueue (unsigned int* lQueued);
+	// Write data and return as soon as the driver accepted all of it, without waiting for the transmission.
+	// Short writes are continued once the driver has room; the timeout is measured in wall time.
+	virtual long WriteQueued (unsigned char* pData, size_t lData, unsigned int* lWritten = 0, unsigned int timeout = INFINITE);
+	// Wait until all data written has been transmitted by the driver
+	virtual long Drain (unsigned int timeout = INFINITE);
+	// Number of WriteQueued calls that found the driver buffer full and had to wait for room
+	unsigned long GetPartialWrites (void) const { return m_PartialWrites; }
+	// Descriptor for poll/select: readable when data arrived, writable when WriteQueued has room. -1 if there is none.
+	// Only for waiting, reads and writes still go through this object.
+	virtual int GetFileDescriptor (void) const;
+	// Read whatever is available (up to lData bytes) without changing the blocking mode. Waits up to timeout for the first byte.
+	// Bytes left in the internal buffer by ReadLine/ReadExact are returned first.
+	// Safe to call from a reader thread while another thread writes.
+	virtual long ReadAvailable (unsigned char* pData, size_t lData, unsigned int* lRead, unsigned int timeout);
+
+protected:
+	// Read whatever the driver has, bypassing the internal buffer. Transports other than a serial port
+	// override it, ReadLine/ReadExact/ReadAvailable all go through it.
+	virtual long ReadRaw (unsigned char* pData, size_t lData, unsigned int* lRead, unsigned int timeout);
+	// Move up to lData buffered bytes to pData, returns the number of bytes moved
+	size_t TakeRxBuffer (unsigned char* pData, size_t lData);
+	// Append whatever the driver has to the internal buffer, waiting up to timeout for the first byte
+	long FillRxBuffer (unsigned int timeout);
 
 // Attributes
 protected:
 #ifdef MTI_WINDOWS
 	HANDLE	m_hFile;			// File handle
 	HANDLE	m_hevtOverlapped;	// Event handle for internal overlapped operations
+	HANDLE	m_hevtReadAvailable;	// Event handle for ReadAvailable, which may run concurrently with Write
 #endif
 #ifdef MTI_UNIX
-	int m_hFile;
+	int m_hFile;				// File descriptor, always in non-blocking mode
+	int m_BlockingMode;			// Blocking mode emulated by Read
 #endif
+	// Received bytes not consumed yet, between m_RxStart and m_RxEnd. Only one thread may read at a time.
+	unsigned char m_RxBuffer[MTI_SERIAL_RX_BUFFER_SIZE];
+	size_t m_RxStart;
+	size_t m_RxEnd;
+	// Written by the writing thread only
+	unsigned long m_PartialWrites;
 
 };
 
@@ -0,0 +1,119 @@
+//////////////////////////////////////////////////////////////////////
+// PlayzerX-Sim.cpp
+// Version: 2.1.0.0
+//
+// Emulates a PlayzerX controller on a pseudo terminal, so that the
+// PlayzerX library can be tested and benchmarked without hardware.
+// The device path is printed on startup; connect to it with
+// PlayzerX::ConnectDevice("/dev/pts/N") or to the --link path.
+//////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "PlayzerXSimulatorPort.h"
+
+using namespace playzerx;
+
+volatile sig_atomic_t exitRequest = 0;
+
+void OnSignal(int) { exitRequest = 1; }
+
+void PrintStats(const PlayzerXSimulatorStats& stats)
+{
+	printf("level %6u  rate %5u  received %llu  played %llu  dropped %llu  underruns %llu  "
+		   "errors %llu\n",
+		   stats.SamplesRemaining, stats.SampleRate, stats.SamplesReceived, stats.SamplesPlayed,
+		   stats.SamplesDropped, stats.Underruns, stats.FramingErrors);
+	fflush(stdout);
+}
+
+void PrintUsage()
+{
+	printf("Usage: playzerx-sim [options]\n"
+		   "  --rgb          Emulate an RGB device (XYRGB, 83333 samples buffer)\n"
+		   "  --link PATH    Create a symbolic link PATH to the emulated port\n"
+		   "  --baud N       Limit the host to device throughput to N baud, 0 for no limit\n"
+		   "                 (default 921600)\n"
+		   "  --name NAME    Device name reported to the host\n"
+		   "  --drift PPM    Run the sample clock PPM parts per million fast\n"
+		   "  --verbose      Print the device state every second\n");
+}
+
+int main(int argc, char* argv[])
+{
+	bool rgb = false;
+	bool verbose = false;
+	unsigned int baudRate = 921600;
+	double clockDrift = 0;
+	std::string linkPath, deviceName;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--rgb"))
+			rgb = true;
+		else if (!strcmp(argv[i], "--verbose"))
+			verbose = true;
+		else if (!strcmp(argv[i], "--link") && i + 1 < argc)
+			linkPath = argv[++i];
+		else if (!strcmp(argv[i], "--baud") && i + 1 < argc)
+			baudRate = (unsigned int)strtoul(argv[++i], 0, 10);
+		else if (!strcmp(argv[i], "--name") && i + 1 < argc)
+			deviceName = argv[++i];
+		else if (!strcmp(argv[i], "--drift") && i + 1 < argc)
+			clockDrift = strtod(argv[++i], 0);
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	PlayzerXSimulatorPort port;
+	port.SetClockDrift(clockDrift);
+	if (!port.Start(rgb, baudRate, deviceName))
+	{
+		perror("playzerx-sim: cannot create pseudo terminal");
+		return 1;
+	}
+
+	if (!linkPath.empty())
+	{
+		unlink(linkPath.c_str());
+		if (symlink(port.GetPortName().c_str(), linkPath.c_str()) != 0)
+		{
+			perror("playzerx-sim: cannot create link");
+			return 1;
+		}
+	}
+
+	signal(SIGINT, OnSignal);
+	signal(SIGTERM, OnSignal);
+
+	printf("PlayzerX simulator (%s) at %s\n", rgb ? "XYRGB" : "XYM",
+		   linkPath.empty() ? port.GetPortName().c_str() : linkPath.c_str());
+	fflush(stdout);
+
+	long long nextReport = PlayzerXSimulatorPort::Now() + 1000000000LL;
+	while (!exitRequest)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		if (verbose && PlayzerXSimulatorPort::Now() >= nextReport)
+		{
+			PrintStats(port.GetStats());
+			nextReport += 1000000000LL;
+		}
+	}
+
+	PrintStats(port.GetStats());
+	port.Stop();
+	if (!linkPath.empty()) unlink(linkPath.c_str());
+	return 0;
+}
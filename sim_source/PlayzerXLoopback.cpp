@@ -0,0 +1,208 @@
+//////////////////////////////////////////////////////////////////////
+// PlayzerXLoopback.cpp
+// Version: 2.1.0.0
+//////////////////////////////////////////////////////////////////////
+
+#include "PlayzerXLoopback.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+namespace playzerx
+{
+PlayzerXLoopback::PlayzerXLoopback()
+{
+	static std::atomic<unsigned int> instances(0);
+	m_PortName = "loopback" + std::to_string(instances++);
+	m_ClockDrift = 0;
+	Start();
+}
+
+void PlayzerXLoopback::Start(bool rgb, const std::string& deviceName)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Device = PlayzerXSimulator(rgb);
+	if (!deviceName.empty()) m_Device.SetDeviceName(deviceName);
+	m_Device.SetClockDrift(m_ClockDrift);
+	m_Device.Reset(PlayzerXSimulatorPort::Now());
+}
+
+void PlayzerXLoopback::SetClockDrift(double ppm)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_ClockDrift = ppm;
+	m_Device.SetClockDrift(ppm);
+}
+
+PlayzerXSimulatorStats PlayzerXLoopback::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Device.Advance(PlayzerXSimulatorPort::Now());
+	PlayzerXSimulatorStats stats;
+	stats.SamplesRemaining = m_Device.GetSamplesRemaining();
+	stats.SampleRate = m_Device.GetSampleRate();
+	stats.SamplesReceived = m_Device.GetSamplesReceived();
+	stats.SamplesPlayed = m_Device.GetSamplesPlayed();
+	stats.SamplesDropped = m_Device.GetSamplesDropped();
+	stats.Underruns = m_Device.GetUnderruns();
+	stats.FramingErrors = m_Device.GetFramingErrors();
+	return stats;
+}
+
+PlayzerXTransportFactory PlayzerXLoopback::GetTransportFactory()
+{
+	return [this](const std::string& portName) -> MTISerialIO*
+	{
+		if (portName != m_PortName) return nullptr;
+		return new PlayzerXLoopbackPort(*this);
+	};
+}
+
+PlayzerXLoopbackPort::PlayzerXLoopbackPort(PlayzerXLoopback& loopback) : m_Loopback(loopback) {}
+
+PlayzerXLoopbackPort::~PlayzerXLoopbackPort()
+{
+	// Closed here, the base class would close m_hFile as a file descriptor
+	Close();
+}
+
+long PlayzerXLoopbackPort::Open(const char* port, unsigned int baudRate, unsigned int inQueue,
+								unsigned int outQueue)
+{
+	// The port name was matched by the factory; there is no line and no driver queue
+	(void)port;
+	(void)baudRate;
+	(void)inQueue;
+	(void)outQueue;
+	std::lock_guard<std::mutex> lock(m_Loopback.m_Mutex);
+	// There is no descriptor, any non-zero value marks the port open for the base class
+	m_hFile = -1;
+	m_RxStart = m_RxEnd = 0;
+	return MTI_SUCCESS;
+}
+
+long PlayzerXLoopbackPort::Close()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Loopback.m_Mutex);
+		m_hFile = 0;
+	}
+	// Readers waiting for output give up
+	m_Loopback.m_OutputReady.notify_all();
+	return MTI_SUCCESS;
+}
+
+long PlayzerXLoopbackPort::Purge()
+{
+	std::lock_guard<std::mutex> lock(m_Loopback.m_Mutex);
+	if (m_hFile == 0) return MTI_ERR_INVALID_HANDLE;
+	m_RxStart = m_RxEnd = 0;
+	m_Loopback.m_Device.ConsumeOutput(m_Loopback.m_Device.GetOutput().size());
+	return MTI_SUCCESS;
+}
+
+long PlayzerXLoopbackPort::SetSerialParams(unsigned int baudRate)
+{
+	(void)baudRate;
+	return MTI_SUCCESS;
+}
+
+long PlayzerXLoopbackPort::SetBlockingMode(int blockingMode)
+{
+	m_BlockingMode = blockingMode;
+	return MTI_SUCCESS;
+}
+
+long PlayzerXLoopbackPort::Write(unsigned char* pData, size_t lData, unsigned int* lWritten,
+								 unsigned int timeout)
+{
+	// Writes complete at once
+	(void)timeout;
+	if (lWritten != 0) *lWritten = 0;
+	bool replied;
+	{
+		std::lock_guard<std::mutex> lock(m_Loopback.m_Mutex);
+		if (m_hFile == 0) return MTI_ERR_INVALID_HANDLE;
+		m_Loopback.m_Device.Receive(pData, lData, PlayzerXSimulatorPort::Now());
+		replied = !m_Loopback.m_Device.GetOutput().empty();
+	}
+	// Sample data has no reply, only commands wake the reader
+	if (replied) m_Loopback.m_OutputReady.notify_all();
+	if (lWritten != 0) *lWritten = (unsigned int)lData;
+	return MTI_SUCCESS;
+}
+
+long PlayzerXLoopbackPort::Read(unsigned char* pData, size_t lData, unsigned int* lRead,
+								unsigned int timeout, int blockingMode)
+{
+	if (lRead != 0) *lRead = 0;
+	if (m_hFile == 0) return MTI_ERR_INVALID_HANDLE;
+	if (blockingMode != MTI_BLOCKING_MODE_ERR) SetBlockingMode(blockingMode);
+
+	// Same rules as the serial port: non-blocking reads without a timeout return what is there
+	unsigned int wait = timeout;
+	if (m_BlockingMode == MTI_BLOCKING_MODE_OFF && timeout == INFINITE) wait = 0;
+	size_t lTotal = TakeRxBuffer(pData, lData);
+	while (lTotal < lData)
+	{
+		unsigned int lChunk = 0;
+		long lastError = ReadRaw(pData + lTotal, lData - lTotal, &lChunk, wait);
+		if (lastError == MTI_ERR_SERIALCOMM_READ_TIMEOUT && wait != timeout) break;
+		if (lastError != MTI_SUCCESS) return lastError;
+		lTotal += lChunk;
+	}
+	if (lRead != 0) *lRead = (unsigned int)lTotal;
+	return MTI_SUCCESS;
+}
+
+long PlayzerXLoopbackPort::GetOutputQueue(unsigned int* lQueued)
+{
+	*lQueued = 0;
+	return (m_hFile == 0) ? MTI_ERR_INVALID_HANDLE : MTI_SUCCESS;
+}
+
+long PlayzerXLoopbackPort::WriteQueued(unsigned char* pData, size_t lData, unsigned int* lWritten,
+									   unsigned int timeout)
+{
+	return Write(pData, lData, lWritten, timeout);
+}
+
+long PlayzerXLoopbackPort::Drain(unsigned int timeout)
+{
+	(void)timeout;
+	return (m_hFile == 0) ? MTI_ERR_INVALID_HANDLE : MTI_SUCCESS;
+}
+
+long PlayzerXLoopbackPort::ReadRaw(unsigned char* pData, size_t lData, unsigned int* lRead,
+								   unsigned int timeout)
+{
+	if (lRead != 0) *lRead = 0;
+	std::unique_lock<std::mutex> lock(m_Loopback.m_Mutex);
+	PlayzerXSimulator& device = m_Loopback.m_Device;
+	long long deadline = PlayzerXSimulatorPort::Now() + 1000000LL * timeout;
+	while (true)
+	{
+		if (m_hFile == 0) return MTI_ERR_SERIALCOMM;
+
+		// Buffer level updates fall due while waiting, like on the real device
+		long long now = PlayzerXSimulatorPort::Now();
+		device.Advance(now);
+		const std::vector<unsigned char>& output = device.GetOutput();
+		if (!output.empty())
+		{
+			size_t lTaken = (output.size() < lData) ? output.size() : lData;
+			memcpy(pData, &output[0], lTaken);
+			device.ConsumeOutput(lTaken);
+			if (lRead != 0) *lRead = (unsigned int)lTaken;
+			return MTI_SUCCESS;
+		}
+		if (timeout != INFINITE && now >= deadline) return MTI_ERR_SERIALCOMM_READ_TIMEOUT;
+
+		long long wakeUp = device.GetNextEventTime();
+		if (timeout != INFINITE && deadline < wakeUp) wakeUp = deadline;
+		m_Loopback.m_OutputReady.wait_for(lock, std::chrono::nanoseconds(wakeUp - now));
+	}
+}
+
+}  // namespace playzerx
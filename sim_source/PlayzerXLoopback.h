@@ -0,0 +1,114 @@
+/**
+ * \file PlayzerXLoopback.h
+ * \brief Defines an in-memory transport to a simulated PlayzerX controller.
+ * \version 2.1.0.0
+ *
+ * Unlike PlayzerXSimulatorPort, no pseudo terminal and no thread are involved: bytes written by
+ * the host are parsed by the PlayzerXSimulator right away and replies are read straight from its
+ * output. There is no wire, so throughput is limited by the library alone. This measures the
+ * overhead of the library apart from the UART and lets benchmarks run at memory speed.
+ */
+
+#ifndef PLAYZERX_LOOPBACK_H
+#define PLAYZERX_LOOPBACK_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include "MTISerial.h"
+#include "PlayzerXSimulator.h"
+#include "PlayzerXSimulatorPort.h"
+#include "PlayzerXTransport.h"
+
+namespace playzerx
+{
+/**
+ * \class PlayzerXLoopback
+ * \brief A simulated controller reached through PlayzerXLoopbackPort transports.
+ *
+ * Connect to it by name with the transport factory:
+ * \code
+ * PlayzerXLoopback loopback;
+ * loopback.Start();
+ * playzer.SetTransportFactory(loopback.GetTransportFactory());
+ * playzer.ConnectDevice(loopback.GetPortName());
+ * \endcode
+ * The device keeps its state while transports are opened and closed, like a real controller.
+ * All methods are thread safe.
+ */
+class PlayzerXLoopback
+{
+   public:
+	PlayzerXLoopback();
+
+	/**
+	 * \brief Powers the simulated device on.
+	 * \param rgb Emulates an RGB device instead of a monochrome one.
+	 * \param deviceName Name reported to the host, empty for the default.
+	 */
+	void Start(bool rgb = false, const std::string& deviceName = std::string());
+
+	/** \brief Makes the sample clock deviate by \p ppm, see PlayzerXSimulator::SetClockDrift(). */
+	void SetClockDrift(double ppm);
+
+	/** \brief Name the transport factory answers to, unique per object (e.g., "loopback0"). */
+	const std::string& GetPortName() const { return m_PortName; }
+
+	/** \brief Gets a consistent snapshot of the device state. */
+	PlayzerXSimulatorStats GetStats();
+
+	/** \brief Gets a factory that creates transports for GetPortName() and no other name. */
+	PlayzerXTransportFactory GetTransportFactory();
+
+   private:
+	friend class PlayzerXLoopbackPort;
+
+	std::string m_PortName;
+	PlayzerXSimulator m_Device;
+	double m_ClockDrift;
+	/** \brief Guards the device, waited on by readers for output. */
+	std::mutex m_Mutex;
+	std::condition_variable m_OutputReady;
+};
+
+/**
+ * \class PlayzerXLoopbackPort
+ * \brief MTISerialIO talking to a PlayzerXLoopback instead of a serial port.
+ *
+ * Writes complete at once and nothing is ever queued for transmission. As with a serial port,
+ * one thread may read while another writes.
+ */
+class PlayzerXLoopbackPort : public MTISerialIO
+{
+   public:
+	explicit PlayzerXLoopbackPort(PlayzerXLoopback& loopback);
+	~PlayzerXLoopbackPort();
+
+	long Open(const char* port, unsigned int baudRate = MTI_BAUDRATE_DEFAULT,
+			  unsigned int inQueue = MTI_SERIAL_QUEUE_SIZE,
+			  unsigned int outQueue = MTI_SERIAL_QUEUE_SIZE) override;
+	long Close() override;
+	long Purge() override;
+	long SetSerialParams(unsigned int baudRate = MTI_BAUDRATE_DEFAULT) override;
+	long SetBlockingMode(int blockingMode = MTI_BLOCKING_MODE_ON) override;
+	long Write(unsigned char* pData, size_t lData, unsigned int* lWritten = 0,
+			   unsigned int timeout = INFINITE) override;
+	long Read(unsigned char* pData, size_t lData, unsigned int* lRead = 0,
+			  unsigned int timeout = INFINITE, int blockingMode = MTI_BLOCKING_MODE_ON) override;
+	long GetOutputQueue(unsigned int* lQueued) override;
+	long WriteQueued(unsigned char* pData, size_t lData, unsigned int* lWritten = 0,
+					 unsigned int timeout = INFINITE) override;
+	long Drain(unsigned int timeout = INFINITE) override;
+
+   protected:
+	long ReadRaw(unsigned char* pData, size_t lData, unsigned int* lRead,
+				 unsigned int timeout) override;
+
+   private:
+	PlayzerXLoopback& m_Loopback;
+};
+
+}  // namespace playzerx
+
+#endif  // PLAYZERX_LOOPBACK_H
@@ -0,0 +1,204 @@
+//////////////////////////////////////////////////////////////////////
+// PlayzerXSimulator.cpp
+// Version: 2.1.0.0
+//////////////////////////////////////////////////////////////////////
+
+#include "PlayzerXSimulator.h"
+
+#include <cstring>
+
+namespace playzerx
+{
+PlayzerXSimulator::PlayzerXSimulator(bool rgb)
+{
+	m_RGB = rgb;
+	m_BufferSize = rgb ? 83333u : 125000u;
+	m_DeviceName = rgb ? "PlayzerX-RGB-SIM" : "PlayzerX-SIM";
+	m_ClockFactor = 1.0;
+	m_FirmwareName = "2.1.0.0-sim";
+	m_SamplesReceived = 0;
+	m_SamplesPlayed = 0;
+	m_SamplesDropped = 0;
+	m_Underruns = 0;
+	m_FramingErrors = 0;
+	Reset(0);
+}
+
+void PlayzerXSimulator::Reset(long long now)
+{
+	m_SampleRate = 10000;
+	m_UpdateTimer = 0;
+	m_USBMode = true;
+	m_Level = 0;
+	m_DrainCredit = 0;
+	m_LastAdvance = now;
+	m_NextUpdate = now;
+	m_CommandLength = 0;
+}
+
+void PlayzerXSimulator::Receive(const unsigned char* data, size_t numBytes, long long now)
+{
+	Advance(now);
+	for (size_t i = 0; i < numBytes; i++)
+	{
+		unsigned char byte = data[i];
+		// Synchronize on the "pl" prefix, anything else between commands is ignored
+		if ((m_CommandLength == 0 && byte != 'p') || (m_CommandLength == 1 && byte != 'l'))
+		{
+			m_CommandLength = (byte == 'p') ? 1 : 0;
+			continue;
+		}
+		m_Command[m_CommandLength++] = byte;
+		if (m_CommandLength < 4) continue;
+
+		unsigned int length = m_Command[3];
+		if (length < 5 || length > sizeof(m_Command))
+		{
+			m_FramingErrors++;
+			m_CommandLength = 0;
+			continue;
+		}
+		if (m_CommandLength < length) continue;
+
+		m_CommandLength = 0;
+		if (m_Command[length - 1] != 10)
+		{
+			m_FramingErrors++;
+			continue;
+		}
+		Execute(m_Command, length, now);
+	}
+}
+
+void PlayzerXSimulator::Execute(const unsigned char* command, unsigned int length, long long now)
+{
+	switch (command[2])
+	{
+	case 'D':
+	case 'd':
+	{
+		unsigned int expected = (command[2] == 'D') ? 8u : m_RGB ? 11u : 9u;
+		if (length != expected)
+		{
+			m_FramingErrors++;
+			return;
+		}
+		// Samples only count while the device takes its data from USB
+		if (!m_USBMode) return;
+		if (m_Level >= m_BufferSize)
+		{
+			m_SamplesDropped++;
+			return;
+		}
+		// An idle FIFO starts draining when the first sample arrives
+		if (m_Level == 0) m_DrainCredit = 0;
+		m_Level++;
+		m_SamplesReceived++;
+		return;
+	}
+	case 'c': m_Level = 0; return;
+	case 'r':
+	{
+		if (length != 8) break;
+		unsigned int rate = command[4] | (command[5] << 8) | (command[6] << 16);
+		m_SampleRate = (rate < 50) ? 50 : (rate > 50000) ? 50000 : rate;
+		m_DrainCredit = 0;
+		return;
+	}
+	case 'u':
+		if (length != 7) break;
+		m_UpdateTimer = command[4] | (command[5] << 8);
+		m_NextUpdate = now;
+		Advance(now);
+		return;
+	case 'p': SendText("pl-ok\n"); return;
+	case 'n':
+		SendText("pl-info\n");
+		SendText(m_DeviceName.c_str());
+		SendText("\n");
+		SendText(m_FirmwareName.c_str());
+		SendText("\n");
+		SendText(m_RGB ? "XYRGB\n" : "XYM\n");
+		return;
+	case 'g': SendLevel(); return;
+	case 'i':
+	case 'I':
+		if (length != 8) break;
+		if (!memcmp(command + 4, "usb", 3))
+			m_USBMode = true;
+		else if (!memcmp(command + 4, "ain", 3))
+			m_USBMode = false;
+		else
+			break;
+		return;
+	case 'b':
+		if (length != 6 || command[4] != 0xEE) break;
+		Reset(now);
+		return;
+	default: break;
+	}
+	m_FramingErrors++;
+}
+
+void PlayzerXSimulator::Advance(long long now)
+{
+	if (now > m_LastAdvance)
+	{
+		// Whole samples are played, the remainder carries over to the next call
+		m_DrainCredit += (now - m_LastAdvance) * 1e-9 * m_SampleRate * m_ClockFactor;
+		m_LastAdvance = now;
+		unsigned int played = (unsigned int)m_DrainCredit;
+		m_DrainCredit -= played;
+		if (m_Level > 0 && played >= m_Level)
+		{
+			m_SamplesPlayed += m_Level;
+			m_Level = 0;
+			m_Underruns++;
+		}
+		else if (m_Level > 0)
+		{
+			m_SamplesPlayed += played;
+			m_Level -= played;
+		}
+		if (m_Level == 0) m_DrainCredit = 0;
+	}
+
+	if (m_UpdateTimer == 0 || now < m_NextUpdate) return;
+	SendLevel();
+	long long period = m_UpdateTimer * 1000000LL;
+	m_NextUpdate += period;
+	// Updates missed while nobody called are not sent late
+	if (m_NextUpdate <= now) m_NextUpdate = now + period;
+}
+
+long long PlayzerXSimulator::GetNextEventTime() const
+{
+	// Without updates nothing happens by itself, check back every now and then
+	return m_UpdateTimer ? m_NextUpdate : m_LastAdvance + 100000000LL;
+}
+
+void PlayzerXSimulator::ConsumeOutput(size_t numBytes)
+{
+	if (numBytes >= m_Output.size())
+		m_Output.clear();
+	else
+		m_Output.erase(m_Output.begin(), m_Output.begin() + numBytes);
+}
+
+void PlayzerXSimulator::SendLevel()
+{
+	const unsigned char record[6] = {'p',
+									 'l',
+									 '-',
+									 (unsigned char)(m_Level & 0xFF),
+									 (unsigned char)((m_Level >> 8) & 0xFF),
+									 (unsigned char)((m_Level >> 16) & 0xFF)};
+	m_Output.insert(m_Output.end(), record, record + 6);
+}
+
+void PlayzerXSimulator::SendText(const char* text)
+{
+	m_Output.insert(m_Output.end(), text, text + strlen(text));
+}
+
+}  // namespace playzerx
@@ -0,0 +1,129 @@
+/**
+ * \file PlayzerXSimulator.h
+ * \brief Defines a software model of a PlayzerX controller.
+ * \version 2.1.0.0
+ *
+ * The simulator implements the USB serial protocol on a byte stream: it parses the commands
+ * written by the host, keeps a sample FIFO that drains at the configured sample rate and produces
+ * the replies and periodic "pl-" buffer level records the firmware would send. It does no I/O of
+ * its own; the caller moves bytes between the simulator and a transport (e.g. a pseudo terminal)
+ * and supplies monotonic times in nanoseconds.
+ */
+
+#ifndef PLAYZERX_SIMULATOR_H
+#define PLAYZERX_SIMULATOR_H
+
+#include <string>
+#include <vector>
+
+namespace playzerx
+{
+/**
+ * \class PlayzerXSimulator
+ * \brief Protocol and FIFO model of a PlayzerX controller. Not thread safe.
+ */
+class PlayzerXSimulator
+{
+   public:
+	/**
+	 * \brief Creates a monochrome (XYM, 125000 samples) or RGB (XYRGB, 83333 samples) device.
+	 */
+	explicit PlayzerXSimulator(bool rgb = false);
+
+	/** \brief Restores the power-on state (empty FIFO, 10000 samples/s, no updates, USB mode). */
+	void Reset(long long now);
+
+	/** \brief Parses bytes received from the host at time \p now. */
+	void Receive(const unsigned char* data, size_t numBytes, long long now);
+
+	/** \brief Drains the FIFO up to time \p now and emits buffer level updates that are due. */
+	void Advance(long long now);
+
+	/** \brief Time at which Advance() has to be called for the next buffer level update. */
+	long long GetNextEventTime() const;
+
+	/** \brief Bytes waiting to be sent to the host. */
+	const std::vector<unsigned char>& GetOutput() const { return m_Output; }
+
+	/** \brief Removes the first \p numBytes bytes of the output once they have been sent. */
+	void ConsumeOutput(size_t numBytes);
+
+	/** \brief Sets the device name reported by the info command. */
+	void SetDeviceName(const std::string& name) { m_DeviceName = name; }
+
+	/** \brief Sets the firmware name reported by the info command. */
+	void SetFirmwareName(const std::string& name) { m_FirmwareName = name; }
+
+	/** \brief Makes the sample clock run \p ppm parts per million fast (or slow if negative). */
+	void SetClockDrift(double ppm) { m_ClockFactor = 1.0 + 1e-6 * ppm; }
+
+	/** \brief Gets the number of samples in the FIFO. */
+	unsigned int GetSamplesRemaining() const { return m_Level; }
+
+	/** \brief Gets the FIFO capacity in samples. */
+	unsigned int GetBufferSize() const { return m_BufferSize; }
+
+	/** \brief Gets the sample rate in samples per second. */
+	unsigned int GetSampleRate() const { return m_SampleRate; }
+
+	/** \brief Gets the buffer level update interval in milliseconds, 0 if disabled. */
+	unsigned int GetBufferUpdateTimer() const { return m_UpdateTimer; }
+
+	/** \brief Checks if data input is taken from USB (\c true) or from the analog inputs. */
+	bool IsUSBMode() const { return m_USBMode; }
+
+	/** \brief Total number of samples accepted into the FIFO. */
+	unsigned long long GetSamplesReceived() const { return m_SamplesReceived; }
+
+	/** \brief Total number of samples drained from the FIFO (i.e. output by the device). */
+	unsigned long long GetSamplesPlayed() const { return m_SamplesPlayed; }
+
+	/** \brief Samples lost because the FIFO was full. */
+	unsigned long long GetSamplesDropped() const { return m_SamplesDropped; }
+
+	/** \brief Number of times the FIFO ran empty while playing. */
+	unsigned long long GetUnderruns() const { return m_Underruns; }
+
+	/** \brief Commands discarded because of a bad length, code or suffix. */
+	unsigned long long GetFramingErrors() const { return m_FramingErrors; }
+
+   private:
+	/** \brief Executes one complete command. */
+	void Execute(const unsigned char* command, unsigned int length, long long now);
+
+	/** \brief Appends a "pl-" buffer level record to the output. */
+	void SendLevel();
+
+	/** \brief Appends text to the output. */
+	void SendText(const char* text);
+
+	bool m_RGB;
+	unsigned int m_BufferSize;
+	std::string m_DeviceName;
+	std::string m_FirmwareName;
+
+	unsigned int m_SampleRate;
+	double m_ClockFactor;
+	unsigned int m_UpdateTimer;
+	bool m_USBMode;
+
+	unsigned int m_Level;
+	double m_DrainCredit;
+	long long m_LastAdvance;
+	long long m_NextUpdate;
+
+	unsigned char m_Command[32];
+	unsigned int m_CommandLength;
+
+	std::vector<unsigned char> m_Output;
+
+	unsigned long long m_SamplesReceived;
+	unsigned long long m_SamplesPlayed;
+	unsigned long long m_SamplesDropped;
+	unsigned long long m_Underruns;
+	unsigned long long m_FramingErrors;
+};
+
+}  // namespace playzerx
+
+#endif  // PLAYZERX_SIMULATOR_H
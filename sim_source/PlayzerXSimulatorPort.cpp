@@ -0,0 +1,169 @@
+//////////////////////////////////////////////////////////////////////
+// PlayzerXSimulatorPort.cpp
+// Version: 2.1.0.0
+//////////////////////////////////////////////////////////////////////
+
+#include "PlayzerXSimulatorPort.h"
+
+#include <chrono>
+#include <cstdlib>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace playzerx
+{
+PlayzerXSimulatorPort::PlayzerXSimulatorPort()
+{
+	m_Master = -1;
+	m_Slave = -1;
+	m_ClockDrift = 0;
+	m_StopRequest = false;
+}
+
+PlayzerXSimulatorPort::~PlayzerXSimulatorPort() { Stop(); }
+
+long long PlayzerXSimulatorPort::Now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			   std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+bool PlayzerXSimulatorPort::Start(bool rgb, unsigned int baudRate, const std::string& deviceName)
+{
+	Stop();
+
+	m_Master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (m_Master < 0) return false;
+	if (grantpt(m_Master) != 0 || unlockpt(m_Master) != 0)
+	{
+		Stop();
+		return false;
+	}
+	m_PortName = ptsname(m_Master);
+
+	// Keep the slave side open in raw mode: the terminal settings survive the host closing and
+	// reopening the port, and the master never sees a hang-up
+	m_Slave = open(m_PortName.c_str(), O_RDWR | O_NOCTTY);
+	struct termios options;
+	if (m_Slave < 0 || tcgetattr(m_Slave, &options) != 0)
+	{
+		Stop();
+		return false;
+	}
+	cfmakeraw(&options);
+	tcsetattr(m_Slave, TCSANOW, &options);
+	fcntl(m_Master, F_SETFL, fcntl(m_Master, F_GETFL) | O_NONBLOCK);
+
+	m_Device = PlayzerXSimulator(rgb);
+	if (!deviceName.empty()) m_Device.SetDeviceName(deviceName);
+	m_Device.SetClockDrift(m_ClockDrift);
+	m_Device.Reset(Now());
+
+	m_StopRequest = false;
+	m_Thread = std::thread(&PlayzerXSimulatorPort::Run, this, baudRate);
+	return true;
+}
+
+void PlayzerXSimulatorPort::Stop()
+{
+	m_StopRequest = true;
+	if (m_Thread.joinable()) m_Thread.join();
+	if (m_Slave >= 0) close(m_Slave);
+	if (m_Master >= 0) close(m_Master);
+	m_Slave = -1;
+	m_Master = -1;
+	m_PortName.clear();
+}
+
+void PlayzerXSimulatorPort::SetClockDrift(double ppm)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_ClockDrift = ppm;
+	m_Device.SetClockDrift(ppm);
+}
+
+PlayzerXSimulatorStats PlayzerXSimulatorPort::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Device.Advance(Now());
+	PlayzerXSimulatorStats stats;
+	stats.SamplesRemaining = m_Device.GetSamplesRemaining();
+	stats.SampleRate = m_Device.GetSampleRate();
+	stats.SamplesReceived = m_Device.GetSamplesReceived();
+	stats.SamplesPlayed = m_Device.GetSamplesPlayed();
+	stats.SamplesDropped = m_Device.GetSamplesDropped();
+	stats.Underruns = m_Device.GetUnderruns();
+	stats.FramingErrors = m_Device.GetFramingErrors();
+	return stats;
+}
+
+void PlayzerXSimulatorPort::Run(unsigned int baudRate)
+{
+	// The wire is modeled as a byte budget that grows at baudRate / 10 (8N1) bytes per second.
+	// Bytes beyond the budget stay in the pty, so the host sees the same back-pressure as on
+	// a real serial line. A few milliseconds of burst keep the number of reads reasonable.
+	const double bytesPerNs = baudRate / 10.0 * 1e-9;
+	const double maxBurst = baudRate / 10.0 * 0.004 + 64;
+	double budget = maxBurst;
+	long long lastBudget = Now();
+	unsigned char data[4096];
+
+	while (!m_StopRequest)
+	{
+		long long now = Now();
+		if (baudRate)
+		{
+			budget += (now - lastBudget) * bytesPerNs;
+			if (budget > maxBurst) budget = maxBurst;
+		}
+		lastBudget = now;
+
+		// Wait for input if the wire has room, otherwise until it has room again
+		struct pollfd pfd = {m_Master, 0, 0};
+		long long wakeUp;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			wakeUp = m_Device.GetNextEventTime();
+			if (!m_Device.GetOutput().empty()) pfd.events |= POLLOUT;
+		}
+		if (!baudRate || budget >= 1)
+			pfd.events |= POLLIN;
+		else if (now + (long long)((1 - budget) / bytesPerNs) < wakeUp)
+			wakeUp = now + (long long)((1 - budget) / bytesPerNs);
+		long long timeoutNs = wakeUp - now;
+		int timeoutMs = (timeoutNs <= 0) ? 0 : (int)((timeoutNs + 999999) / 1000000);
+		// Stop requests are noticed within this time
+		if (timeoutMs > 50) timeoutMs = 50;
+
+		if (poll(&pfd, 1, timeoutMs) < 0 && errno != EINTR) break;
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		now = Now();
+		if (pfd.revents & POLLIN)
+		{
+			size_t lRead = sizeof(data);
+			if (baudRate && budget < lRead) lRead = (size_t)budget;
+			ssize_t n = read(m_Master, data, lRead);
+			if (n > 0)
+			{
+				m_Device.Receive(data, (size_t)n, now);
+				if (baudRate) budget -= n;
+			}
+		}
+		m_Device.Advance(now);
+
+		const std::vector<unsigned char>& output = m_Device.GetOutput();
+		if (!output.empty())
+		{
+			ssize_t n = write(m_Master, &output[0], output.size());
+			if (n > 0) m_Device.ConsumeOutput((size_t)n);
+		}
+	}
+}
+
+}  // namespace playzerx
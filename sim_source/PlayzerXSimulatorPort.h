@@ -0,0 +1,96 @@
+/**
+ * \file PlayzerXSimulatorPort.h
+ * \brief Defines a pseudo terminal serving a simulated PlayzerX controller.
+ * \version 2.1.0.0
+ *
+ * The port runs a PlayzerXSimulator on a background thread. The host side of the pseudo terminal
+ * behaves like the USB serial port of a controller and can be opened with
+ * PlayzerX::ConnectDevice(). Linux only.
+ */
+
+#ifndef PLAYZERX_SIMULATOR_PORT_H
+#define PLAYZERX_SIMULATOR_PORT_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "PlayzerXSimulator.h"
+
+namespace playzerx
+{
+/**
+ * \struct PlayzerXSimulatorStats
+ * \brief Snapshot of the simulated device state.
+ */
+struct PlayzerXSimulatorStats
+{
+	/** \brief Samples in the FIFO. */
+	unsigned int SamplesRemaining;
+	/** \brief Sample rate in samples per second. */
+	unsigned int SampleRate;
+	/** \brief Total number of samples accepted into the FIFO. */
+	unsigned long long SamplesReceived;
+	/** \brief Total number of samples played. */
+	unsigned long long SamplesPlayed;
+	/** \brief Samples lost because the FIFO was full. */
+	unsigned long long SamplesDropped;
+	/** \brief Number of times the FIFO ran empty while playing. */
+	unsigned long long Underruns;
+	/** \brief Commands discarded because of a bad length, code or suffix. */
+	unsigned long long FramingErrors;
+};
+
+/**
+ * \class PlayzerXSimulatorPort
+ * \brief Serves a simulated controller on a pseudo terminal from a background thread.
+ */
+class PlayzerXSimulatorPort
+{
+   public:
+	PlayzerXSimulatorPort();
+	~PlayzerXSimulatorPort();
+
+	/**
+	 * \brief Creates the pseudo terminal and starts serving it.
+	 * \param rgb Emulates an RGB device instead of a monochrome one.
+	 * \param baudRate Throughput limit of the host to device direction, \c 0 for none.
+	 * \param deviceName Name reported to the host, empty for the default.
+	 * \return \c false if the pseudo terminal could not be created.
+	 */
+	bool Start(bool rgb = false, unsigned int baudRate = 921600,
+			   const std::string& deviceName = std::string());
+
+	/** \brief Stops serving and closes the pseudo terminal. */
+	void Stop();
+
+	/** \brief Makes the sample clock deviate by \p ppm, see PlayzerXSimulator::SetClockDrift(). */
+	void SetClockDrift(double ppm);
+
+	/** \brief Path of the host side of the pseudo terminal (e.g., "/dev/pts/3"). */
+	const std::string& GetPortName() const { return m_PortName; }
+
+	/** \brief Gets a consistent snapshot of the device state. */
+	PlayzerXSimulatorStats GetStats();
+
+	/** \brief Monotonic time in nanoseconds, the time base of the simulator. */
+	static long long Now();
+
+   private:
+	/** \brief Moves bytes between the pseudo terminal and the simulator until stopped. */
+	void Run(unsigned int baudRate);
+
+	int m_Master;
+	int m_Slave;
+	std::string m_PortName;
+	PlayzerXSimulator m_Device;
+	double m_ClockDrift;
+	std::mutex m_Mutex;
+	std::atomic<bool> m_StopRequest;
+	std::thread m_Thread;
+};
+
+}  // namespace playzerx
+
+#endif  // PLAYZERX_SIMULATOR_PORT_H
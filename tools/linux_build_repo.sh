@@ -64,6 +64,18 @@ else
     fi
 fi
 
+# Copy the controller emulator if it exists
+if [ -f "${BUILD_DIR}/sim_source/playzerx-sim" ]; then
+    cp ${BUILD_DIR}/sim_source/playzerx-sim ${DELIVERY_DIR}/
+    echo "Copied playzerx-sim"
+fi
+
+# Copy the benchmark suites if they exist
+if [ -f "${BUILD_DIR}/bench_source/playzerx-bench" ]; then
+    cp ${BUILD_DIR}/bench_source/playzerx-bench ${DELIVERY_DIR}/
+    echo "Copied playzerx-bench"
+fi
+
 # Print directory structure for verification
 echo "Contents of delivery directory:"
 ls -la ${DELIVERY_DIR}/